@@ -3,20 +3,40 @@
 
 #include <vector>
 #include <string>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
 
 #include "pfm.h"
 #include "rbfm.h" // for some type declarations only, e.g., RID and Attribute
 
 # define IX_EOF (-1)  // end of the index scan
 # define IX_HIDDEN_PAGE_COUNT 1
+# define IX_FORMAT_VERSION 2                // node page layout in the header, bumped when it changes (2: posting lists)
 # define NODE_TYPE_INTERMEDIATE 1
 # define NODE_TYPE_LEAF 2
+# define NODE_CACHE_LEAVES 64                // decoded leaves kept per index, intermediate nodes are all kept
+# define NODE_LATCH_STRIPES 1024             // version latches per index, a page uses the one at pageNum % stripes
+# define BULK_LOAD_FILL_FACTOR 0.9f         // share of a node bulkLoad fills, the rest is left for later inserts
+# define BULK_LOAD_RUN_SIZE (1 << 24)       // bytes of entries bulkLoad sorts in memory before spilling them to disk
+# define POSTING_INLINE_LIMIT (PAGE_SIZE / 8)  // bytes of RIDs a leaf keeps for one key, more go to posting pages
+# define POSTING_RID_MAX 8                  // bytes one more RID can add to a posting list
 
 namespace PeterDB {
     class IX_ScanIterator;
 
     class IXFileHandle;
 
+    class NodeCache;
+
+    class PostingList;
+
+    // Hands bulkLoad the next entry in insertEntry's key format, IX_EOF once there are no more
+    typedef std::function<RC(RID &rid, void *key)> EntrySource;
+
     class InsertionChild{
     public:
         void *leastChildValue;
@@ -31,39 +51,70 @@ namespace PeterDB {
         char type{}; // Intermediate node or leaf node
         int freeSpace{};
         int nextPage{};
+        short prefixLength{};   // key bytes all entries of a varchar leaf share, kept once at the start of keys
+        // A leaf entry is one key and the posting list of its RIDs, a varchar key's length (less the prefix) first
         vector<Slot> directory;
 
         Node();
         explicit Node(char type);
         explicit Node(char *bytes);
+        Node(const Node &other);                                    // copies the keys, to change a cached node
+        Node &operator=(const Node &) = delete;
 
         void reload (char *bytes);
 
         int getOccupiedSpace() const;
-        int findChildNode(const Attribute &keyField, const void *key, long pageId, int slotId, int &index, bool compareRids = true);
-        int findKey(const Attribute &keyField, const void *key, const RID &rid, bool compareRid = true, bool getIndex = false);
-        void insertKey(const Attribute &keyField, int dataSpace, const void *key, const RID &rid);
+        int findChildNode(const Attribute &keyField, const void *key, int &index) const;
+        int findKey(const Attribute &keyField, const void *key, bool getIndex = false) const;
+        // Sets the posting list of key, adding the key if the leaf does not have it yet
+        void putKey(const Attribute &keyField, const void *key, const char *postings, int postingsLength);
         void deleteKey(const Attribute &keyField, int index);
-        void getKeyData(const Attribute &attribute, int index, char *key, RID &rid); // returns false if slotnum was absent
+        void getKey(const Attribute &keyField, int index, char *key) const;     // with the varchar length first
+        int getPostings(const Attribute &keyField, int index, const char *&postings) const;    // returns the length
         int getKeyCount() const;
         void insertChild(const Attribute &attribute, int index, void *key, int keyLength, int childPageId);
-        void split(char *newNode,  InsertionChild *child, int &splitStart, int childIndex);
+        void split(char *newNode,  InsertionChild *child, int &splitStart, int childIndex);    // intermediate nodes
+        // Splits a full leaf with putKey's change made, child gets the right half's least key
+        void splitLeaf(const Attribute &keyField, const void *key, const char *postings, int postingsLength,
+                       char *newNode, InsertionChild *child);
         bool hasSpace(int dataSpace) const;
+        // Room in a leaf for putKey, with the prefix the key may cut
+        bool hasSpaceFor(const Attribute &keyField, const void *key, int postingsLength) const;
         void populateBytes(char *bytes);
-        bool validateIndex(int index);
-
-        std::string toJsonKeys(const Attribute &keyField);
+        bool validateIndex(int index) const;
+        void reset(char nodeType);                                  // empty node, the key buffer is kept
+        void appendEntry(const char *entry, int length);            // after the last one, for nodes built in key order
+        void cleanDirectory();                                      // drops the slots of deleted entries
+        // Refills a leaf with full entries (as stored with no prefix) in order, storing their common key prefix once
+        void packEntries(const Attribute &keyField, const char *entries, const vector<int> &lengths);
+        // Bytes packEntries takes for count entries, slots included
+        static int packedSize(const Attribute &keyField, const char *first, const char *last, int entryBytes, int count);
+        static const char *entryKey(const Attribute &keyField, const char *entry, int &keyLength);  // of a full entry
+
+        std::string toJsonKeys(const Attribute &keyField, IXFileHandle &ixFileHandle);
         std::vector<int> getChildren(const Attribute &keyField);
 
         ~Node();
 
     private:
-        void cleanDirectory();
-        int getKeySize(int index, const Attribute &keyField) const;
         int getFreeSpaceStart();
-        void populateFormattedKey(AttrType type, char *key, RID &rid, int index);
-
-        std::string toJsonKeysLeaf(const Attribute &keyField);
+        // Takes the node's prefix off a raw key, 0 if the key has it. Otherwise the key orders below (-1) or above (1)
+        // every entry.
+        int stripPrefix(const char *&key, int &keyLength) const;
+        int sharedPrefix(const char *key, int keyLength) const;    // how much of the prefix the raw key starts with
+        void shortenPrefix(int length);                             // moves the rest of the prefix into the entries
+        // Index of the first live slot above (upper) or at or above key, directory size if there is none
+        int searchSlots(AttrType keyType, const void *key, bool upper) const;
+        template<AttrType keyType>
+        int searchSlots(const char *key, int keyLength, bool upper) const;
+        // Entry at index against a raw key, negative, zero or positive like memcmp
+        int compareEntry(AttrType keyType, int index, const char *key, int keyLength) const;
+        template<AttrType keyType>
+        int compareEntry(int index, const char *key, int keyLength) const;
+        const char *storedKey(AttrType keyType, int index, int &keyLength) const;  // in place, without the prefix
+        int entryLength(const Attribute &keyField, const void *key, int postingsLength) const;  // stored, as putKey would
+
+        std::string toJsonKeysLeaf(const Attribute &keyField, IXFileHandle &ixFileHandle);
         std::string toJsonKeysIntermediate(const Attribute &keyField);
     };
 
@@ -71,8 +122,6 @@ namespace PeterDB {
 
     public:
         static IndexManager &instance();
-        Node cachedNode;
-        int cachedPage{};
 
         // Create an index file.
         RC createFile(const std::string &fileName);
@@ -108,10 +157,17 @@ namespace PeterDB {
 
         std::string getJson(IXFileHandle &ixFileHandle, const Attribute &attribute, int pageId) const;
 
-        void refreshCache(IXFileHandle &ixFileHandle, int pageId);
-        void refreshCache(char *bytes, int pageId);
+        // Optimistic descent to the leaf holding key (the leftmost leaf for nullptr). Sets the leaf's node and the
+        // latch version it was read at, -1 if the tree is empty or a page could not be read. The caller validates or
+        // upgrades the version before trusting node.
+        int findLeaf(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                     std::shared_ptr<const Node> &node, unsigned long &version);
 
-        bool cached(const string& filename, int pageId) const;
+        // Build the tree of an empty index from every entry of source, in any order. The entries are sorted, in runs
+        // spilled to disk once runSize bytes are reached, then leaves are filled left to right up to fillFactor
+        // and the intermediate levels are built on top of them.
+        RC bulkLoad(IXFileHandle &ixFileHandle, const Attribute &attribute, const EntrySource &source,
+                    float fillFactor = BULK_LOAD_FILL_FACTOR, size_t runSize = BULK_LOAD_RUN_SIZE);
 
     protected:
         IndexManager() = default;                                                   // Prevent construction
@@ -120,21 +176,114 @@ namespace PeterDB {
         IndexManager &operator=(const IndexManager &) = default;                    // Prevent assignment
 
     private:
-        void parseKey(AttrType attrType, InsertionChild *child, char *key, RID &rid);
+        std::unordered_map<std::string, std::weak_ptr<NodeCache>> nodeCaches;  // of the index files open right now
+
+        RC changeLeaf(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid,
+                      bool inserting);                             // 1 if the leaf needs a split
+        RC splitInsert(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid);
+        // pageCount is the one in the header, used when no other handle has the file open
+        std::shared_ptr<NodeCache> shareNodes(const std::string &fileName, unsigned pageCount);
+        static int entryLength(AttrType type, const char *entry);   // a key as insertEntry takes it, then its RID
+        static bool entryLess(AttrType type, const char *lhs, const char *rhs);
+        static RC writeRun(AttrType type, vector<char> &entries, vector<size_t> &offsets, const string &runFile);
+        static RC readEntry(AttrType type, std::ifstream &run, vector<char> &entry);
+    };
+
+    // The RIDs of one leaf key in (pageNum, slotNum) order. Inline in the leaf they are a count, then for each RID
+    // a varint page delta from the RID before and a varint slot. A longer list is in a chain of posting pages, each
+    // starting its deltas over, and the leaf keeps the first page.
+    class PostingList {
+    public:
+        static void encode(const vector<RID> &rids, vector<char> &postings);                   // inline
+        static int overflowPage(const char *postings);                                        // -1 for an inline list
+        static RC read(IXFileHandle &ixFileHandle, const char *postings, vector<RID> &rids);
+        // Adds rid, postings gets what the leaf should keep. 1 if that takes a page append and mayAppend is false.
+        static RC add(IXFileHandle &ixFileHandle, const char *postings, int length, const RID &rid, bool mayAppend,
+                      vector<char> &updated);
+        // Takes rid out, -1 if it is not there. updated comes back empty once no RID is left.
+        static RC remove(IXFileHandle &ixFileHandle, const char *postings, int length, const RID &rid,
+                         vector<char> &updated);
+        // Posting pages holding rids, the first to be appended as page firstPage and the others right after
+        static void paginate(const vector<RID> &rids, int firstPage, vector<vector<char>> &pages);
+        static void encodeOverflow(int firstPage, vector<char> &postings);
+
+    private:
+        struct PageHeader {
+            int nextPage;
+            int count;
+            RID last;                                               // the greatest RID, if count is not 0
+            int codesLength;                                        // bytes of the RIDs after the header
+        };
+
+        static void encodeRids(const RID *rids, int count, vector<char> &codes);
+        static void decodeRids(const char *codes, int count, vector<RID> &rids);       // appends to rids
+        static void pageBytes(int nextPage, const RID *rids, int count, vector<char> &bytes);
+        static RC readPage(IXFileHandle &ixFileHandle, int pageNum, char *bytes, PageHeader &header);
+        static void writeHeader(const PageHeader &header, char *bytes);
+        static bool putRid(char *bytes, PageHeader &header, const RID &rid);   // in place on a page, false if full
+        static bool cutRid(char *bytes, PageHeader &header, const RID &rid);   // in place on a page, false if absent
+        static bool less(const RID &lhs, const RID &rhs);
+    };
+
+    // Decoded nodes of one index file, shared by every open IXFileHandle of it so that lookups and scans do not decode
+    // the same page over and over. Intermediate nodes (few, and on the path of every lookup) stay until their page is
+    // written, at most NODE_CACHE_LEAVES leaves are kept, least recently used first. Handed out nodes stay valid after
+    // they leave the cache. Safe to use from several threads.
+    //
+    // Also holds the latches of the tree's pages, for optimistic lock coupling: a latch is a version that writers make
+    // odd while they hold it and move on when they let go. Readers never block writers, they note the version before
+    // reading a page and start over when it moved. Inserts and deletes that stay in one leaf latch only that leaf,
+    // splits run one at a time under structureLatch and latch every node they change for the whole split.
+    //
+    // The file's page count lives here too, so a page appended through one handle is not appended over through another,
+    // and each handle writes the current count to the header when it closes.
+    class NodeCache {
+    public:
+        std::mutex structureLatch;                                  // held by the one insert splitting nodes
+        std::atomic<unsigned> pageCount;                            // of the file, pages appended through any handle
+
+        explicit NodeCache(unsigned pageCount);
+
+        std::shared_ptr<const Node> getNode(IXFileHandle &ixFileHandle, PageNum pageNum);  // nullptr if unreadable
+        bool getRootPageId(int &rootPageId);                        // false until it is read or written once
+        void setRootPageId(int rootPageId);
+        void pageWritten(PageNum pageNum);                          // drops what was decoded from the page
 
-        string cachedFile;
+        unsigned long readLatch(PageNum pageNum);                   // waits out a writer, returns the version
+        bool validate(PageNum pageNum, unsigned long version);      // no writer latched the page since version
+        bool upgradeLatch(PageNum pageNum, unsigned long version);  // latches for writing unless version moved
+        void writeLatch(PageNum pageNum);                           // waits for the latch to be free
+        void writeUnlatch(PageNum pageNum);
+        static bool sharesLatch(PageNum pageNum, PageNum otherPage);
+
+    private:
+        typedef struct CachedNode {
+            std::shared_ptr<const Node> node;
+            std::list<PageNum>::iterator recentUse;                 // only leaves are in the recently used order
+        } CachedNode;
+
+        std::mutex latch;
+        unsigned long writes;                                       // pages written so far, decodes that raced one are
+                                                                    // not cached
+        int rootPageId;                                             // -1 until known
+        std::unordered_map<PageNum, CachedNode> nodes;
+        std::list<PageNum> leaves;                                  // cached leaves, least recently used first
+        std::atomic<unsigned long> versions[NODE_LATCH_STRIPES];
     };
 
     class IXFileHandle {
     public:
 
         // variables to keep counter for each operation
-        unsigned ixReadPageCounter;
-        unsigned ixWritePageCounter;
-        unsigned ixAppendPageCounter;
+        std::atomic<unsigned> ixReadPageCounter;
+        std::atomic<unsigned> ixWritePageCounter;
+        std::atomic<unsigned> ixAppendPageCounter;
+        std::atomic<unsigned> ixCacheHitCounter;
+        std::atomic<unsigned> ixCacheMissCounter;
 
         std::fstream ixFile;
         std::string filename;
+        std::shared_ptr<NodeCache> nodes;                           // set by IndexManager::openFile, shared per file
 
         // Constructor
         IXFileHandle();
@@ -146,6 +295,7 @@ namespace PeterDB {
         RC readPage(PageNum pageNum, void *data);                           // Get a specific page
         RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
         int appendPage(const void *data);                                   // Append a specific page, returns the new page number
+        std::shared_ptr<const Node> readNode(PageNum pageNum);              // Decoded, from the node cache when it has it
         int getRootPageId();
         void setRootPageId(int rootId, bool create = false);
         RC create(const std::string &fileName);
@@ -160,10 +310,45 @@ namespace PeterDB {
         // Put the current counter values of associated PF FileHandles into variables
         RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount);
 
+        // Buffer pool hits and misses of this handle
+        RC collectCacheCounterValues(unsigned &hitCount, unsigned &missCount);
+
         unsigned getPageCount() const;
 
     };
 
+    // Writes the nodes of a B+ tree level by level from entries in key order, for IndexManager::bulkLoad
+    class TreeBuilder {
+    public:
+        TreeBuilder(IXFileHandle &ixFileHandle, const Attribute &attribute, float fillFactor);
+
+        RC addEntry(const char *entry);                             // as sorted by bulkLoad: key, then RID
+        RC finish();                                                // writes the last leaf, the levels above and the root
+
+    private:
+        IXFileHandle &ixFileHandle;
+        const Attribute &attribute;
+        int emptySpace;                                             // free space of an empty node
+        int nodeCapacity;                                           // of which the fill factor lets entries take this much
+        Node node;
+        vector<char> currentKey;                                    // the key whose RIDs are being collected
+        vector<RID> currentRids;
+        vector<char> leafEntries;                                   // of the leaf being filled, in full until written
+        vector<int> leafLengths;
+        vector<size_t> chainOffsets;                                // where in leafEntries a posting chain's page goes
+        vector<vector<RID>> chains;                                 // the RIDs of each
+        vector<char> separators;                                    // what each node of the level is known by above, in order
+        vector<int> separatorLengths;
+        vector<int> children;                                       // page of each node of the level
+
+        bool fits(int length) const;
+        bool leafFits(const char *entry, int length) const;         // with the prefix it shares with the leaf's first
+        RC addKey();                                                // currentKey and its RIDs go into the leaf
+        RC writeNode(char *bytes);                                  // appends the node, records its page in children
+        RC writeLeaf(char *bytes, bool last);                       // packs leafEntries into node, then its chains
+        RC buildLevel();                                            // one level of intermediate nodes over children
+    };
+
     class IX_ScanIterator {
     public:
 
@@ -182,8 +367,15 @@ namespace PeterDB {
         bool meetsCondition(void *key);
 
         void incrementCursor(int currentKeyCount, int nextPage);
+        RC loadLeaf();                                              // the leaf at pageNum
+        RC readRids(int index);                                     // of the entry at index of node, into rids
 
         IXFileHandle *ixFileHandle;
+        std::shared_ptr<const Node> node;                           // the leaf at nodePage as the scan first saw it
+        int nodePage{-1};
+        vector<RID> rids;                                           // of the key returned last, given out one a call
+        size_t ridIndex{};
+        vector<char> ridsKey;
         int pageNum;
         int slotNum;
         Attribute attribute;
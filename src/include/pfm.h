@@ -1,14 +1,42 @@
 #ifndef _pfm_h_
 #define _pfm_h_
 
-#define PAGE_SIZE 4096
-#define HIDDEN_PAGE_COUNT 10
+#ifndef PAGE_SIZE
+#define PAGE_SIZE 4096                  // One size per build (-DPAGE_SIZE=...), not per file, recorded in every header
+#endif
+#define PAGE_CHECKSUM_SIZE 4
+#define PAGE_DATA_SIZE (PAGE_SIZE - PAGE_CHECKSUM_SIZE)
+#define HIDDEN_PAGE_COUNT 2
+#define FSM_ROOT_PAGE 1
+#define FSM_FANOUT (PAGE_SIZE / (4 * sizeof(short)))
+#define BUFFER_POOL_SIZE 256
+#define LRU_K_HISTORY 2
+#define MMAP_GROWTH_PAGES 256
+#define MMAP_WINDOW_PAGES 16384
+#define ASYNC_IO_THREADS 4
+#define GROUP_COMMIT_PAGES 64
+#define GROUP_COMMIT_MILLIS 50
+#define READ_AHEAD_TRIGGER 2
+#define READ_AHEAD_MIN_PAGES 4
+#define READ_AHEAD_MAX_PAGES 64
+#define LATENCY_SUB_BUCKET_BITS 3
 
 #include <string>
 #include <unordered_map>
+#include <unordered_set>
 #include <vector>
+#include <list>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <chrono>
+#include <memory>
 #include <fstream>
 
+static_assert(PAGE_SIZE >= 4096 && PAGE_SIZE <= 32768 && (PAGE_SIZE & (PAGE_SIZE - 1)) == 0,
+              "PAGE_SIZE must be a power of two from 4 KB to 32 KB, record pages address their bytes with shorts");
+
 namespace PeterDB {
 
     typedef unsigned PageNum;
@@ -16,13 +44,308 @@ namespace PeterDB {
 
     class FileHandle;
 
+    typedef enum {
+        LRU_POLICY = 0, CLOCK_POLICY, LRU_K_POLICY
+    } ReplacementPolicyType;
+
+    typedef enum {
+        BUFFERED_IO = 0, WRITE_BEHIND_IO, MMAP_IO
+    } PageIOMode;
+
+    typedef enum {
+        CHECKSUM_OFF = 0, CHECKSUM_ON_LOAD, CHECKSUM_ALWAYS
+    } ChecksumMode;
+
+    // CRC32C of a page, kept in its last PAGE_CHECKSUM_SIZE bytes. Uses the SSE4.2 / ARMv8 CRC instructions when the
+    // CPU has them and a table otherwise.
+    class PageChecksum {
+    public:
+        static unsigned crc32c(const void *data, size_t length);
+        static void stamp(char *page);                                      // Checksum the data into the trailer
+        static bool verify(const char *page);                               // All-zero pages were never written, valid
+    };
+
+    // Log-linear latency histogram in nanoseconds, in the style of HDR histograms: every power of two is split into
+    // 2^LATENCY_SUB_BUCKET_BITS buckets, so any recorded value is reported within 1/8 of its true value.
+    class LatencyHistogram {
+    public:
+        LatencyHistogram();
+
+        void record(std::chrono::nanoseconds elapsed);
+        void merge(const LatencyHistogram &other);
+        unsigned long long getCount() const;
+        unsigned long long getTotal() const;                                // Sum of all values
+        unsigned long long getMax() const;
+        unsigned long long percentile(double fraction) const;               // Upper bound of the bucket holding it
+        std::string toJson() const;
+
+    private:
+        std::vector<unsigned long long> buckets;
+        unsigned long long count;
+        unsigned long long total;
+        unsigned long long max;
+
+        static unsigned bucketOf(unsigned long long value);
+        static unsigned long long upperBound(unsigned bucket);
+    };
+
+    // Physical I/O done for one file since it was created (or since the process started)
+    class IOStatistics {
+    public:
+        unsigned long long pagesRead;
+        unsigned long long pagesWritten;
+        unsigned long long bytesRead;
+        unsigned long long bytesWritten;
+        unsigned long long cacheHits;
+        unsigned long long cacheMisses;
+        LatencyHistogram readLatency;                                       // One sample per read call
+        LatencyHistogram writeLatency;                                      // One sample per write call
+        LatencyHistogram syncLatency;                                       // fdatasync or msync calls, not stream flushes
+
+        IOStatistics();
+
+        void merge(const IOStatistics &other);                              // Aggregate over several files
+        std::string toJson() const;
+    };
+
+    // Chooses which unpinned frame of the buffer pool gets reused for a new page
+    class ReplacementPolicy {
+    public:
+        static ReplacementPolicy *create(ReplacementPolicyType type, unsigned frameCount);
+
+        virtual void recordAccess(unsigned frameId) = 0;                    // Frame was loaded or pinned again
+        virtual void setEvictable(unsigned frameId, bool evictable) = 0;    // Pinned frames are never evicted
+        virtual bool victim(unsigned &frameId) = 0;                         // Returns false if every frame is pinned
+        virtual void remove(unsigned frameId) = 0;                          // Frame no longer holds a page
+
+        virtual ~ReplacementPolicy() = default;
+    };
+
+    class LRUPolicy : public ReplacementPolicy {
+    public:
+        explicit LRUPolicy(unsigned frameCount);
+
+        void recordAccess(unsigned frameId) override;
+        void setEvictable(unsigned frameId, bool evictable) override;
+        bool victim(unsigned &frameId) override;
+        void remove(unsigned frameId) override;
+
+    private:
+        std::list<unsigned> order;                                          // Least recently used at the front
+        std::vector<std::list<unsigned>::iterator> positions;
+        std::vector<bool> tracked;
+        std::vector<bool> evictable;
+    };
+
+    class ClockPolicy : public ReplacementPolicy {
+    public:
+        explicit ClockPolicy(unsigned frameCount);
+
+        void recordAccess(unsigned frameId) override;
+        void setEvictable(unsigned frameId, bool evictable) override;
+        bool victim(unsigned &frameId) override;
+        void remove(unsigned frameId) override;
+
+    private:
+        std::vector<bool> referenced;
+        std::vector<bool> tracked;
+        std::vector<bool> evictable;
+        unsigned hand;
+    };
+
+    class LRUKPolicy : public ReplacementPolicy {
+    public:
+        LRUKPolicy(unsigned frameCount, unsigned k);
+
+        void recordAccess(unsigned frameId) override;
+        void setEvictable(unsigned frameId, bool evictable) override;
+        bool victim(unsigned &frameId) override;
+        void remove(unsigned frameId) override;
+
+    private:
+        unsigned k;
+        unsigned long long currentTime;
+        std::vector<std::deque<unsigned long long>> history;               // Last k access times, oldest first
+        std::vector<bool> tracked;
+        std::vector<bool> evictable;
+    };
+
+    class Frame {
+    public:
+        std::string fileName;
+        PageNum pageNum;                                                    // Physical page in the file, hidden pages included
+        int pinCount;
+        bool dirty;
+        char *data;
+
+        Frame();
+    };
+
+    // Page cache shared by every FileHandle and IXFileHandle. Frames are keyed by file name and physical page number,
+    // and the pool owns the stream used for the data pages of each file. Header pages stay with the handles.
+    class BufferPool {
+    public:
+        static BufferPool &instance();                                      // Access to the singleton instance
+
+        RC configure(unsigned frameCount, ReplacementPolicyType policyType); // Flush everything and rebuild the frame table
+        char *pinPage(const std::string &fileName, PageNum pageNum, bool &hit); // Returns nullptr if no frame can be used
+        RC unpinPage(const std::string &fileName, PageNum pageNum, bool dirty);
+        RC readPage(const std::string &fileName, PageNum pageNum, void *data, bool &hit);
+        RC writePage(const std::string &fileName, PageNum pageNum, const void *data,
+                     bool deferred = false);                                // Write-through unless deferred to a group commit
+        bool readCached(const std::string &fileName, PageNum pageNum, void *data);      // Copy out a cached page, no disk I/O
+        RC flushFile(const std::string &fileName, unsigned &pagesWritten);   // Sorted, contiguous pages in one write
+        RC syncFile(const std::string &fileName);                           // fdatasync what has been flushed so far
+        unsigned getFlushCount(const std::string &fileName);               // Physical writes issued for the file
+        IOStatistics getStatistics(const std::string &fileName);           // Snapshot, empty for unknown files
+        void recordRead(const std::string &fileName, unsigned pageCount, std::chrono::nanoseconds elapsed);
+        void recordWrite(const std::string &fileName, unsigned pageCount, std::chrono::nanoseconds elapsed);
+        void recordSync(const std::string &fileName, std::chrono::nanoseconds elapsed);
+        unsigned prefetch(const std::string &fileName, PageNum pageNum,
+                          unsigned pageCount);                              // Load missing pages, returns how many were read
+        void discardFile(const std::string &fileName);                      // Drop frames and stream of a removed file
+        void enableChecksums(const std::string &fileName);                 // Stamp on write, verify on load from now on
+        bool checksummed(const std::string &fileName);
+        void setChecksumMode(ChecksumMode mode);                            // When loaded pages are verified
+        bool verifyPage(const std::string &fileName, const char *data);    // Counts the failure
+        unsigned getFrameCount() const;
+
+        unsigned hitCounter;
+        unsigned missCounter;
+        unsigned writeBackCounter;                                          // Dirty frames written out on eviction
+        unsigned prefetchCounter;                                           // Pages loaded ahead of being asked for
+        unsigned checksumFailureCounter;                                    // Torn or corrupted pages refused on load
+
+    protected:
+        BufferPool();                                                       // Prevent construction
+        ~BufferPool();                                                      // Prevent unwanted destruction
+        BufferPool(const BufferPool &);                                     // Prevent construction by copying
+        BufferPool &operator=(const BufferPool &);                          // Prevent assignment
+
+    private:
+        struct PendingWrites {
+            unsigned pageCount;
+            std::chrono::steady_clock::time_point oldest;
+        };
+
+        std::vector<Frame> frames;
+        std::vector<unsigned> freeFrames;
+        std::unordered_map<std::string, std::unordered_map<PageNum, unsigned>> pageTable;
+        std::unordered_map<std::string, std::fstream> streams;
+        std::unordered_map<std::string, PendingWrites> pendingWrites;     // Deferred writes since the last group commit
+        std::unordered_map<std::string, IOStatistics> statistics;
+        std::unordered_set<std::string> checksumFiles;
+        ChecksumMode checksumMode;
+        ReplacementPolicy *policy;
+        std::recursive_mutex latch;
+
+        std::fstream *getStream(const std::string &fileName);
+        RC readPhysical(const std::string &fileName, PageNum pageNum, void *data);
+        RC writePhysical(const std::string &fileName, PageNum pageNum, const void *data);
+        RC deferWrite(const std::string &fileName);                         // Group commit once a threshold is crossed. Age is only
+                                                                            // checked here, an idle file waits for sync() or close()
+        bool allocateFrame(unsigned &frameId);
+        void releaseFrame(unsigned frameId);
+        int lookup(const std::string &fileName, PageNum pageNum);
+    };
+
+    // Shared memory mapping of a whole file. The window is reserved larger than the file and the file grows underneath
+    // it in MMAP_GROWTH_PAGES chunks, so the mapping (and every pointer into it) only moves when the window is outgrown.
+    class MappedFile {
+    public:
+        MappedFile();
+        ~MappedFile();
+
+        RC open(const std::string &fileName);
+        RC close(PageNum pageCount);                                        // Sync, unmap and cut the file to pageCount pages
+        char *page(PageNum pageNum);                                        // Physical page, nullptr past the end of the file
+        RC extend(PageNum pageCount);                                       // Grow the file to hold at least pageCount pages
+        RC sync();                                                          // msync the whole file
+        RC advise(bool sequential);                                         // madvise hint for the access pattern
+
+    private:
+        int fd;
+        char *base;
+        size_t windowSize;
+        size_t fileSize;
+
+        RC map(size_t size);
+    };
+
+    // State shared by every open FileHandle of the same file, so a handle sees the pages appended through another one
+    // without rereading the header. The header is written back when a handle is closed or checkpointed.
+    class FileState {
+    public:
+        unsigned dataPageCount;
+        PageIOMode mode;
+        MappedFile *mapping;                                                // Only set in MMAP_IO mode
+        std::recursive_mutex latch;                                         // Serializes appends and free space map updates
+
+        FileState(unsigned dataPageCount, PageIOMode mode);
+        ~FileState();                                                       // Unmaps the file once the last handle is gone
+    };
+
+    // Completion of a batch of page reads. Pages complete in any order, wait() returns once all of them are done.
+    class PageBatch {
+    public:
+        PageBatch();
+
+        void expect(unsigned pageCount);                                    // Pages about to be submitted
+        void complete(RC rc);                                               // Called once per page by whoever served it
+        bool done();
+        RC wait();                                                          // Blocks until done, -1 if any page failed
+
+    private:
+        unsigned pending;
+        RC status;
+        std::mutex latch;
+        std::condition_variable finished;
+    };
+
+    // Page reads served in the background by ASYNC_IO_THREADS threads doing pread. Every file gets one descriptor,
+    // opened with O_DIRECT where the file system allows it so large scans do not churn the OS page cache.
+    class AsyncPageIO {
+    public:
+        static AsyncPageIO &instance();                                     // Access to the singleton instance
+
+        RC submitRead(const std::string &fileName, PageNum pageNum, void *data, PageBatch &batch);
+        void discardFile(const std::string &fileName);                      // Close the descriptor, no reads may be in flight
+
+    protected:
+        AsyncPageIO();                                                      // Prevent construction
+        ~AsyncPageIO();                                                     // Stops and joins the threads
+        AsyncPageIO(const AsyncPageIO &);                                   // Prevent construction by copying
+        AsyncPageIO &operator=(const AsyncPageIO &);                        // Prevent assignment
+
+    private:
+        struct Request {
+            std::string fileName;                                           // Checksums are verified against it
+            int fd;
+            bool direct;
+            PageNum pageNum;
+            char *data;
+            PageBatch *batch;
+        };
+
+        std::vector<std::thread> workers;
+        std::deque<Request> queue;
+        std::unordered_map<std::string, std::pair<int, bool>> descriptors; // Descriptor and whether it is O_DIRECT
+        std::mutex latch;
+        std::condition_variable available;
+        bool stopping;
+
+        void work();
+        static RC serve(const Request &request);
+    };
+
     class PagedFileManager {
     public:
         static PagedFileManager &instance();                                // Access to the singleton instance
 
         RC createFile(const std::string &fileName);                         // Create a new file
         RC destroyFile(const std::string &fileName);                        // Destroy a file
-        RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a file
+        RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                    PageIOMode mode = BUFFERED_IO);                         // Open a file, one mode per file at a time
         RC closeFile(FileHandle &fileHandle);                               // Close a file
 
     protected:
@@ -31,6 +354,24 @@ namespace PeterDB {
         PagedFileManager(const PagedFileManager &);                         // Prevent construction by copying
         PagedFileManager &operator=(const PagedFileManager &);              // Prevent assignment
 
+    private:
+        std::unordered_map<std::string, std::weak_ptr<FileState>> fileStates;  // Live as long as a handle uses them
+
+        std::shared_ptr<FileState> shareState(const std::string &fileName, unsigned dataPageCount, PageIOMode mode);
+    };
+
+    // Free space map stored in its own pages. The root lives in hidden page FSM_ROOT_PAGE, a level-1 page is placed
+    // before every FSM_FANOUT^2 data pages and a level-0 page before every FSM_FANOUT data pages. Each FSM page is a
+    // max-tree of free bytes over its children, so a lookup or an update touches one page per level.
+    class FreeSpaceMap {
+    public:
+        static PageNum dataPageLocation(PageNum pageNum);                   // Physical page of a data page
+        static PageNum leafPageLocation(PageNum pageNum);                   // Level-0 FSM page covering a data page
+        static PageNum innerPageLocation(PageNum pageNum);                  // Level-1 FSM page covering a data page
+        static PageNum fileEnd(unsigned dataPageCount);                     // Physical page count of a file
+        static short getMaxFreeSpace(const char *page);
+        static bool update(char *page, unsigned slot, short freeBytes);     // Returns false if nothing changed
+        static int find(const char *page, short freeBytes);                 // Last slot with more free bytes, -1 if none
     };
 
     class FileHandle {
@@ -39,8 +380,11 @@ namespace PeterDB {
         unsigned readPageCounter;
         unsigned writePageCounter;
         unsigned appendPageCounter;
-        std::vector<short> pageSpaceMap;
+        unsigned cacheHitCounter;
+        unsigned cacheMissCounter;
+        std::shared_ptr<FileState> state;
         std::fstream file;
+        std::string fileName;
 
         FileHandle();                                                       // Default constructor
         ~FileHandle();                                                      // Destructor
@@ -50,21 +394,48 @@ namespace PeterDB {
         RC readPage(PageNum pageNum, void *data);                           // Get a specific page
         RC writePage(PageNum pageNum, const void *data);                    // Write a specific page
         RC appendPage(const void *data);                                    // Append a specific page
+        RC readPagesAsync(const std::vector<PageNum> &pageNums, void *data,
+                          PageBatch &batch);                                // Start reading pages back to back into data
+        RC readPages(const std::vector<PageNum> &pageNums, void *data);     // Read a batch of pages, many reads in flight
         unsigned getNumberOfPages();                                        // Get the number of pages in the file
         RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount,
                                 unsigned &appendPageCount);                 // Put current counter values into variables
+        RC collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount,
+                                unsigned &flushCount);                      // Also the physical writes of the file
+        RC collectCacheCounterValues(unsigned &hitCount, unsigned &missCount); // Buffer pool hits and misses of this handle
+        char *pinPage(PageNum pageNum);                                     // Pin a page in the buffer pool, nullptr on failure
+                                                                            // (in MMAP_IO mode a pointer into the mapping)
+        RC unpinPage(PageNum pageNum, bool dirty);                          // Release a pinned page, dirty pages are written back later
         RC open();
         RC close();
+        RC sync();                                                          // Write back dirty pages, a durability barrier
+        RC checkpoint();                                                    // Write back, write the header, then one fdatasync
+        RC adviseSequential(bool sequential);                               // Access pattern hint, starts read-ahead right away
         void setFile(std::fstream&& fileToSet);
         bool isOpen() const;
         RC setPageSpace(PageNum num, short freeBytes);
         static bool exists(const std::string &fileName);
         RC init();                                         // Initialize a new file with hidden pages
 
-        short findFreePage(short space);
+        int findFreePage(short space);                                     // Returns -1 if no page has enough space
 
     private:
+        PageNum lastReadPage;                                               // Read-ahead state of this handle
+        unsigned sequentialReads;
+        unsigned readAheadWindow;
+        PageNum readAheadEnd;                                               // First page not prefetched yet
+        bool sequentialHint;
+
         RC persistCounters();
+        RC writeBack();                                                     // Dirty pages to the file, not yet durable
+        void resetReadAhead();
+        void readAhead(PageNum pageNum);                                    // Prefetch past pageNum on sequential access
+        char *pinMapPage(PageNum location);
+        RC unpinMapPage(PageNum location, bool dirty);
+        RC appendMapPage(PageNum location);
+        void stampMapped(char *page);
+        bool mapped() const;
+        bool deferred() const;                                              // WRITE_BEHIND_IO, writes wait for a group commit
     };
 } // namespace PeterDB
 
@@ -100,6 +100,7 @@ namespace PeterDB {
             for (Attribute &attribute : attributes) {
                 attribute.name = tableName + "." + attribute.name;
             }
+            return 0;
         };
 
         ~TableScan() override {
@@ -157,6 +158,7 @@ namespace PeterDB {
             for (Attribute &attribute : attributes) {
                 attribute.name = tableName + "." + attribute.name;
             }
+            return 0;
         };
 
         ~IndexScan() override {
@@ -181,8 +183,15 @@ namespace PeterDB {
     private:
         Iterator *input;
         Condition condition;
-
-        bool conditionSatisfied(void *data, Condition condition);
+        std::vector<Attribute> inputAttributes;
+        int lhsIndex;                   // positions of the compared attributes in the input, -1 if missing
+        int rhsIndex;
+        RawComparator comparator;       // condition.op specialized for the attribute type
+        const char *rhsValue;           // the constant without its varchar length, if rhs is not an attribute
+        int rhsLength;
+
+        void compileCondition();
+        bool conditionSatisfied(const void *data) const;
     };
 
     class Project : public Iterator {
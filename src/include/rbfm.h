@@ -57,27 +57,28 @@ namespace PeterDB {
 
     typedef string (*copy)(const void*, int&, int);
 
-    class Record {
+    // Compares two raw values of one type, varchar values are given as their characters and length
+    typedef bool (*RawComparator)(const char *lhs, int lhsLength, const char *rhs, int rhsLength);
+
+    // A stored record read in place: [attribute count][end offset per attribute, -1 for NULL][values]. A record that
+    // was moved keeps an attribute count of -1 and the RID it moved to as its values.
+    class RecordView {
     public:
-        short attributeCount{};
-        vector<short> offsets;
-        char* values;
-
-        RID rid{};
-        Record();
-        explicit Record(char *);
-        Record(RID id, short countOfAttributes, vector<short> fieldOffsets, char* values);
-        Record & operator= (const Record &other);
-
-        bool readAttribute(int index, void* data);
-        int getAttributeLength(int index);
-        void toBytes(u_short recordLength, char* bytes);
-        void populateMetadata(char *);
-        void populateData(char *);
-        bool absent() const;                                // tells us whether this record's bytes have data
-        RID getNewRid() const;                              // fetches the new RID if this record has been moved
-
-        ~Record();
+        explicit RecordView(const char *bytes);
+
+        short getAttributeCount() const;
+        bool absent() const;                                // the record moved, see getNewRid()
+        RID getNewRid() const;
+        bool isNull(int index) const;                       // attributes the record does not have are NULL too
+        int getAttributeLength(int index) const;            // -1 for NULL
+        const char *getAttribute(int index) const;          // start of the value bytes
+
+    private:
+        const char *bytes;
+        short attributeCount;
+
+        short getEndOffset(int index) const;
+        short getStartOffset(int index) const;
     };
 
     class SlotDirectory {
@@ -99,16 +100,19 @@ namespace PeterDB {
     public:
         SlotDirectory directory;
         char* records;
-        RC addRecord(unsigned short slotNum, Record &record, unsigned short recordLength);
-        RC updateRecord(unsigned short slotNum, Record &record, short newLength);
+        RC addRecord(unsigned short slotNum, const char *recordBytes, unsigned short recordLength);
+        RC updateRecord(unsigned short slotNum, const char *recordBytes, short newLength);
         RC deleteRecord(unsigned short slotNum);
         bool checkValid();
         bool checkRecordDeleted(unsigned short slotNum);
-        void getRecord(unsigned short slotNum, Record &record);
+        RecordView getRecord(unsigned short slotNum) const; // valid until the page changes
         unsigned short getFreeSlot();
+        void reset();                                       // empty page, buffers are kept
 
         Page();
         Page(short recordCount, short freeSpace);
+        Page(Page &&other) noexcept;
+        Page& operator= (Page &&other) noexcept;
         Page& operator= (const Page& other);
         ~Page();
 
@@ -118,6 +122,33 @@ namespace PeterDB {
         Slot findFilledSlotBetween(int startSlot, int endSlot);
     };
 
+    // Read-only access to a record page without copying it: the slot directory and records are read straight from the
+    // page pinned in the buffer pool (or the mapping). Pointers handed out are valid until the page is unpinned.
+    class PageView {
+    public:
+        PageView();
+        ~PageView();                                        // Unpins the page
+
+        RC pin(FileHandle &fileHandle, PageNum pageNum);    // Unpins the page viewed before, if any
+        void unpin();
+        bool pinned() const;
+        PageNum getPageNum() const;
+
+        short getRecordCount() const;
+        short getFreeSpace() const;
+        Slot getSlot(unsigned short slotNum) const;
+        bool recordDeleted(unsigned short slotNum) const;   // deleted, or past the end of the slot directory
+        RecordView getRecord(unsigned short slotNum) const;
+
+    private:
+        FileHandle *fileHandle;
+        PageNum pageNum;
+        const char *data;
+
+        PageView(const PageView &);                         // A pin has exactly one owner
+        PageView &operator=(const PageView &);
+    };
+
     /********************************************************************
     * The scan iterator is NOT required to be implemented for Project 1 *
     ********************************************************************/
@@ -146,7 +177,7 @@ namespace PeterDB {
         // a satisfying record needs to be fetched from the file.
         // "data" follows the same format as RecordBasedFileManager::insertRecord().
 
-//        RBFM_ScanIterator & operator= (const RBFM_ScanIterator &other);
+        RBFM_ScanIterator & operator= (RBFM_ScanIterator &&other);
 
         RC getNextRecord(RID &rid, void *data);
 
@@ -163,14 +194,26 @@ namespace PeterDB {
         CompOp compOp;                  // comparison type such as "<" and "="
         void *value;                    // used in the comparison
         vector<string> attributeNames;  // a list of projected attributes
-
-        bool incrementRid(int recordCount);  // returns true if incrementation was successful
-        bool conditionMet(Record &record);
-
-        // Comparisons
-        static bool checkEqual(AttrType type, const void* value1, const void* value2);
-        static bool checkLessThan(AttrType type, const void* value1, const void* value2);
-        static bool checkGreaterThan(AttrType type, const void* value1, const void* value2);
+        PageView page;                  // page being scanned, pinned until it has no more slots
+
+        struct ProjectedColumn {
+            int column;                 // index in the record descriptor
+            bool varChar;               // gets a length prefix in the output
+            int nullByte;               // where its bit is in the output null bitmap
+            char nullMask;
+        };
+        vector<ProjectedColumn> projection; // resolved once from attributeNames, in output order
+        int projectedNullBytes{};
+
+        int conditionIndex{};           // conditionAttribute in the record descriptor, -1 if it is not there
+        RawComparator comparator{};     // compOp specialized for the attribute's type
+        const char *conditionValue{};   // value without its varchar length
+        int conditionLength{};
+
+        void planProjection();
+        void planCondition();
+        void project(const RecordView &record, void *data);
+        bool conditionMet(const RecordView &record);
 //        static void getStrings(AttrType type, const void* value1, const void* value2, string& s1, string& s2);
     };
 
@@ -182,7 +225,8 @@ namespace PeterDB {
 
         RC destroyFile(const std::string &fileName);                        // Destroy a record-based file
 
-        RC openFile(const std::string &fileName, FileHandle &fileHandle);   // Open a record-based file
+        RC openFile(const std::string &fileName, FileHandle &fileHandle,
+                    PageIOMode mode = BUFFERED_IO);                         // Open a record-based file
 
         RC closeFile(FileHandle &fileHandle);                               // Close a record-based file
 
@@ -205,6 +249,10 @@ namespace PeterDB {
         RC insertRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const void *data,
                         RID &rid);
 
+        // Insert many records, filling a page in memory and writing it once. rids[i] is where records[i] went.
+        RC insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                         const std::vector<const void *> &records, std::vector<RID> &rids);
+
         // Read a record identified by the given rid.
         RC
         readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid, void *data);
@@ -232,7 +280,7 @@ namespace PeterDB {
         RC readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor, const RID &rid,
                          const std::string &attributeName, void *data);
 
-        RC readAttribute(Record &record, const std::vector<Attribute> &recordDescriptor, const RID &rid,
+        RC readAttribute(const RecordView &record, const std::vector<Attribute> &recordDescriptor,
                          const std::string &attributeName, void *data);
 
         // Scan returns an iterator to allow the caller to go through the results one by one.
@@ -246,17 +294,22 @@ namespace PeterDB {
 
         static RC readPage(PageNum pageNum, Page &page, FileHandle &file);
 
+        // Pins the page holding the record, following moved records. rid becomes where the record really is.
+        static RC locateRecord(FileHandle &fileHandle, RID &rid, PageView &page);
+
         static void getRecordProperties(const std::vector<Attribute> &recordDescriptor, const void *data,
-                                      short &recordLength, vector<short> &offsets, int* fieldInfo);
+                                      short &recordLength, short *offsets, int* fieldInfo);
 
-        static Record prepareRecord(RID rid, const vector<Attribute> &recordDescriptor, const void *data, int recordLength,
-                      vector<short> &offsets, int *fieldInfo);
+        // Writes the stored format of a record into recordBytes, which holds recordLength bytes
+        static void serializeRecord(const vector<Attribute> &recordDescriptor, const void *data, short recordLength,
+                                    const short *offsets, const int *fieldInfo, char *recordBytes);
 
 //        static const unordered_map<int, copy> parserMap;
         static int parseTypeInt(const void* data, int& startOffset, int length);
         static float parseTypeReal(const void* data, int& startOffset, int length);
         static string parseTypeVarchar(const void* data, int& startOffset);
         static const int MIN_RECORD_SIZE = sizeof(short) * 3 + sizeof(RID);
+        static const int RID_PLACEHOLDER_SIZE = sizeof(short) * 3 + sizeof(unsigned) + sizeof(unsigned short);
 
     protected:
         RecordBasedFileManager();                                                   // Prevent construction
@@ -265,17 +318,19 @@ namespace PeterDB {
         RecordBasedFileManager &operator=(const RecordBasedFileManager &);          // Prevent assignment
 
     private:
+        Page insertPage;                                    // scratch page for inserts
 
         static RC writePage(PageNum pageNum, Page &page, FileHandle &file, bool toAppend);
-        Page findFreePage(short bytesNeeded, FileHandle& fileHandle, unsigned &pageDataSize, unsigned &pageNum,
-                          unsigned short &slotNum, bool &append);
+        static RC findFreePage(short bytesNeeded, FileHandle& fileHandle, Page &page, unsigned &pageDataSize,
+                               unsigned &pageNum, unsigned short &slotNum, bool &append);
         static int copyAttribute(const void* data, void* destination, int& startOffset, int length);
         static int copyAttribute(const void* data, void* destination, int& startOffset, int& destOffset, int length);
         static void findRecord(RID& rid, FileHandle& fileHandle, Page &page);
         static void deepDelete(RID rid, FileHandle& fileHandle);
-        static void addRecordToPage(Page &page, Record &record, RID rid, unsigned pageDataSize, short recordLength);
-        static Record getRidPlaceholder(RID rid);
-        static void updateRid(RID rid, Record &newRidData, FileHandle &fileHandle);
+        static void addRecordToPage(Page &page, const char *recordBytes, RID rid, unsigned pageDataSize,
+                                    short recordLength);
+        static void getRidPlaceholder(RID rid, char *placeholder);
+        static void updateRid(RID rid, const char *placeholder, FileHandle &fileHandle);
     };
 
 } // namespace PeterDB
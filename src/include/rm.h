@@ -3,6 +3,8 @@
 
 #include <string>
 #include <vector>
+#include <list>
+#include <unordered_map>
 
 #include "src/include/rbfm.h"
 #include "ix.h"
@@ -12,6 +14,7 @@ namespace PeterDB {
 #define TABLE_FILE_NAME "Tables"
 #define COLUMN_FILE_NAME "Columns"
 #define INDEX_FILE_NAME "Indexes"
+#define HANDLE_CACHE_SIZE 16  // table and index files kept open between calls, least recently used are closed first
 
     // RM_ScanIterator is an iterator to go through tuples
     class RM_ScanIterator {
@@ -26,15 +29,7 @@ namespace PeterDB {
         RC close();
 
         RBFM_ScanIterator rbfmScanner;
-
-        std::string tableName;
-        std::string conditionAttribute;
-        CompOp compOp;
-        void *value;
-        std::vector<std::string> attributeNames;
-        vector<Attribute> descriptor;
-        unsigned pageNum;
-        short slotNum;
+        FileHandle handle;                  // the table file, open from scan() until close()
     };
 
     typedef int (RecordBasedFileManager::*operateRecord)(FileHandle &handle, const vector<Attribute> &recordDescriptor,
@@ -54,6 +49,23 @@ namespace PeterDB {
         IXFileHandle ixHandle;
     };
 
+    // What the catalog says about one table, kept in memory so tuple operations do not scan the catalog files
+    typedef struct CatalogEntry {
+        int tableId;
+        RID tableRid;                       // the table's record in "Tables"
+        std::vector<Attribute> attributes;
+        std::vector<std::string> indexFiles;
+        std::vector<RID> indexRids;         // the index records in "Indexes", in the order of indexFiles
+    } CatalogEntry;
+
+    // A table or index file RelationManager keeps open between calls, so tuple operations do not reopen it each time
+    typedef struct CachedFile {
+        FileHandle handle;                  // open for table files
+        IXFileHandle ixHandle;              // open for index files
+        unsigned users{};                   // callers holding the file right now, it is not closed while there are any
+        std::list<std::string>::iterator recentUse;   // position in the least recently used order
+    } CachedFile;
+
     // Relation Manager
     class RelationManager {
     public:
@@ -73,6 +85,10 @@ namespace PeterDB {
 
         RC insertTuple(const std::string &tableName, const void *data, RID &rid);
 
+        // Insert many tuples at once: pages are filled before being written and each index takes its new entries in
+        // key order. rids[i] is the RID of tuples[i].
+        RC insertTuples(const std::string &tableName, const std::vector<const void *> &tuples, std::vector<RID> &rids);
+
         RC deleteTuple(const std::string &tableName, const RID &rid);
 
         RC updateTuple(const std::string &tableName, const void *data, const RID &rid);
@@ -114,6 +130,12 @@ namespace PeterDB {
                      bool highKeyInclusive,
                      RM_IndexScanIterator &rm_IndexScanIterator);
 
+        // Physical I/O of a table's file and all of its index files since they were created
+        RC getIOStatistics(const std::string &tableName, IOStatistics &statistics);
+
+        // Same as getIOStatistics, as a JSON object with the total and one entry per file
+        RC dumpIOStatistics(const std::string &tableName, std::string &json);
+
     protected:
         RelationManager();                                                  // Prevent construction
         ~RelationManager();                                                 // Prevent unwanted destruction
@@ -121,6 +143,10 @@ namespace PeterDB {
         RelationManager &operator=(const RelationManager &);                // Prevent assignment
 
     private:
+        std::unordered_map<std::string, CatalogEntry> catalogCache;  // filled on first use of a table
+        std::unordered_map<std::string, CachedFile> openFiles;      // at most HANDLE_CACHE_SIZE unless all are in use
+        std::list<std::string> recentlyUsed;                        // open files, least recently used first
+
         static std::vector<Attribute> getTablesDescriptor();
         static std::vector<Attribute> getColumnsDescriptor();
         static std::vector<Attribute> getIndexesDescriptor();
@@ -130,9 +156,21 @@ namespace PeterDB {
         static void getColumnRecord(int id, const Attribute &attribute, int position, int columnFlag, char* data);
         static void getIndexRecord(int tableId, const string &columnName, const string &filename, char *data);
         static vector<string> getAttributeSchema();
-        static Attribute parseColumnAttribute(char* data);
+        static Attribute parseColumnAttribute(char* data, int &position);
         static void copyData(void* data, void* newData, int& copiedLength, int newLength);
         int getTableId(const string &tableName, RID &tableRid);
+        const CatalogEntry *getCatalogEntry(const string &tableName);       // nullptr if there is no such table
+        void invalidateCatalog(const string &tableName);                    // after changing the table's catalog records
+        int scanTableId(const string &tableName, RID &tableRid);
+        RC scanColumns(int tableId, vector<Attribute> &attrs);
+        vector<string> scanIndexFiles(int tableId, vector<RID> &indexRids);
+        FileHandle *acquireFile(const string &tableName);                  // nullptr if it cannot be opened
+        IXFileHandle *acquireIndex(const string &fileName);                 // nullptr if it cannot be opened
+        CachedFile *acquireCached(const string &fileName, bool index);
+        void releaseFile(const string &fileName);                           // once done with an acquired handle
+        void closeCachedFile(const string &fileName);                       // before the file is destroyed
+        void closeCachedFiles();
+        void evictCachedFiles();
         void makeTableIdFilter(int tableId, char* tableFilter);
         int getMaxTableId();
         int operateTuple(const string &tableName, void *data, RID &rid, operateRecord);
@@ -143,13 +181,18 @@ namespace PeterDB {
         static const int SYSTEM_COLUMN_TYPE = 1;
         static const int INDEX_RECORD_MAX_SIZE = 112;
 
-        vector<string> getIndexFiles(const string &tableName, vector<RID> &indexRids, int tableId = -1);
+        vector<string> getIndexFiles(const string &tableName, vector<RID> &indexRids);
         string getIndexFileName(const string &tableName, const string &columnName);
 
         void removeFromIndex(const string &tableName, const RID &rid);
 
         void addToIndex(const string &tableName, const RID &rid, const void *data);
 
+        void addToIndexes(const string &tableName, const vector<Attribute> &tupleDescriptor,
+                          const vector<const void *> &tuples, const vector<RID> &rids);
+
+        static const char *fieldValue(const vector<Attribute> &tupleDescriptor, const void *data, int column); // nullptr if NULL
+
         Attribute getAttribute(const string &tableName, const string &columnName);
     };
 
@@ -0,0 +1,278 @@
+#include "src/include/ix.h"
+#include <src/utils/compare_utils.h>
+#include <algorithm>
+#include <queue>
+
+namespace PeterDB {
+    RC IndexManager::bulkLoad(IXFileHandle &ixFileHandle, const Attribute &attribute, const EntrySource &source,
+                              float fillFactor, size_t runSize) {
+        if (!ixFileHandle.works() || ixFileHandle.getRootPageId() != -1 || fillFactor <= 0 || fillFactor > 1
+            || runSize == 0)
+            return -1;
+
+        // Collect the entries, every runSize bytes of them go to disk as one sorted run
+        vector<char> entries;
+        vector<size_t> offsets;
+        vector<string> runFiles;
+        char key[attribute.length + sizeof(int)];
+        RID rid;
+        RC result = 0;
+        while (result == 0 && source(rid, key) != IX_EOF) {
+            offsets.push_back(entries.size());
+            entries.insert(entries.end(), key, key + entryLength(attribute.type, key) - sizeof(rid.pageNum) - sizeof(rid.slotNum));
+            entries.insert(entries.end(), (char *) &rid.pageNum, (char *) &rid.pageNum + sizeof(rid.pageNum));
+            entries.insert(entries.end(), (char *) &rid.slotNum, (char *) &rid.slotNum + sizeof(rid.slotNum));
+            if (entries.size() < runSize)
+                continue;
+            runFiles.push_back(ixFileHandle.filename + ".run" + to_string(runFiles.size()));
+            result = writeRun(attribute.type, entries, offsets, runFiles.back());
+        }
+
+        TreeBuilder builder(ixFileHandle, attribute, fillFactor);
+        if (result == 0 && runFiles.empty()) {
+            std::sort(offsets.begin(), offsets.end(), [&attribute, &entries](size_t lhs, size_t rhs) {
+                return entryLess(attribute.type, &entries[lhs], &entries[rhs]);
+            });
+            for (int i = 0; result == 0 && i < offsets.size(); ++i)
+                result = builder.addEntry(&entries[offsets[i]]);
+        } else if (result == 0) {
+            if (!offsets.empty()) {
+                runFiles.push_back(ixFileHandle.filename + ".run" + to_string(runFiles.size()));
+                result = writeRun(attribute.type, entries, offsets, runFiles.back());
+            }
+            // Merge the runs, the queue holds the run with the least next entry on top
+            vector<std::ifstream> runs;
+            vector<vector<char>> heads(runFiles.size());
+            auto greater = [&attribute, &heads](int lhs, int rhs) {
+                return entryLess(attribute.type, heads[rhs].data(), heads[lhs].data());
+            };
+            std::priority_queue<int, vector<int>, decltype(greater)> next(greater);
+            for (int i = 0; result == 0 && i < runFiles.size(); ++i) {
+                runs.emplace_back(runFiles[i], ios::in | ios::binary);
+                if (readEntry(attribute.type, runs[i], heads[i]) == 0)
+                    next.push(i);
+            }
+            while (result == 0 && !next.empty()) {
+                int run = next.top();
+                next.pop();
+                result = builder.addEntry(heads[run].data());
+                if (readEntry(attribute.type, runs[run], heads[run]) == 0)
+                    next.push(run);
+            }
+        }
+        for (const string &runFile : runFiles)
+            remove(runFile.c_str());
+        return result == 0 ? builder.finish() : result;
+    }
+
+    int IndexManager::entryLength(AttrType type, const char *entry) {
+        int keyLength = sizeof(int);
+        if (TypeVarChar == type) {
+            std::memcpy(&keyLength, entry, sizeof(keyLength));
+            keyLength += sizeof(int);
+        }
+        return keyLength + sizeof(RID::pageNum) + sizeof(RID::slotNum);
+    }
+
+    bool IndexManager::entryLess(AttrType type, const char *lhs, const char *rhs) {
+        int order = CompareUtils::compare(type, lhs, rhs);
+        if (order != 0)
+            return order < 0;
+        RID lhsRid, rhsRid;
+        const char *lhsRidBytes = lhs + entryLength(type, lhs) - sizeof(RID::pageNum) - sizeof(RID::slotNum);
+        const char *rhsRidBytes = rhs + entryLength(type, rhs) - sizeof(RID::pageNum) - sizeof(RID::slotNum);
+        std::memcpy(&lhsRid.pageNum, lhsRidBytes, sizeof(lhsRid.pageNum));
+        std::memcpy(&lhsRid.slotNum, lhsRidBytes + sizeof(lhsRid.pageNum), sizeof(lhsRid.slotNum));
+        std::memcpy(&rhsRid.pageNum, rhsRidBytes, sizeof(rhsRid.pageNum));
+        std::memcpy(&rhsRid.slotNum, rhsRidBytes + sizeof(rhsRid.pageNum), sizeof(rhsRid.slotNum));
+        return lhsRid.pageNum < rhsRid.pageNum || (lhsRid.pageNum == rhsRid.pageNum && lhsRid.slotNum < rhsRid.slotNum);
+    }
+
+    RC IndexManager::writeRun(AttrType type, vector<char> &entries, vector<size_t> &offsets, const string &runFile) {
+        std::sort(offsets.begin(), offsets.end(), [type, &entries](size_t lhs, size_t rhs) {
+            return entryLess(type, &entries[lhs], &entries[rhs]);
+        });
+        std::ofstream run(runFile, ios::out | ios::binary | ios::trunc);
+        for (size_t offset : offsets)
+            run.write(&entries[offset], entryLength(type, &entries[offset]));
+        entries.clear();
+        offsets.clear();
+        return run.good() ? 0 : -1;
+    }
+
+    RC IndexManager::readEntry(AttrType type, std::ifstream &run, vector<char> &entry) {
+        // The first four bytes are the key, or the length of a varchar one
+        entry.resize(sizeof(int));
+        if (!run.read(entry.data(), sizeof(int)))
+            return -1;
+        entry.resize(entryLength(type, entry.data()));
+        return run.read(entry.data() + sizeof(int), entry.size() - sizeof(int)) ? 0 : -1;
+    }
+
+    TreeBuilder::TreeBuilder(IXFileHandle &ixFileHandle, const Attribute &attribute, float fillFactor)
+            : ixFileHandle(ixFileHandle), attribute(attribute) {
+        node.reset(NODE_TYPE_LEAF);
+        emptySpace = node.freeSpace;
+        nodeCapacity = (int) (emptySpace * fillFactor);
+    }
+
+    RC TreeBuilder::addEntry(const char *entry) {
+        // Equal keys come one after the other, their RIDs make one leaf entry
+        int keyLength = sizeof(int);
+        if (TypeVarChar == attribute.type) {
+            std::memcpy(&keyLength, entry, sizeof(keyLength));
+            keyLength += sizeof(int);
+        }
+        RID rid;
+        std::memcpy(&rid.pageNum, entry + keyLength, sizeof(rid.pageNum));
+        std::memcpy(&rid.slotNum, entry + keyLength + sizeof(rid.pageNum), sizeof(rid.slotNum));
+        if (!currentRids.empty() && CompareUtils::compare(attribute.type, currentKey.data(), entry) == 0) {
+            currentRids.push_back(rid);
+            return 0;
+        }
+        if (!currentRids.empty() && addKey() == -1)
+            return -1;
+        currentKey.assign(entry, entry + keyLength);
+        currentRids.assign(1, rid);
+        return 0;
+    }
+
+    RC TreeBuilder::addKey() {
+        // Leaves hold the key with a short varchar length, then its posting list
+        vector<char> leafEntry;
+        int keyOffset = 0, keyLength = sizeof(int);
+        if (TypeVarChar == attribute.type) {
+            std::memcpy(&keyLength, currentKey.data(), sizeof(keyLength));
+            keyOffset = sizeof(int);
+            unsigned short storedLength = keyLength;
+            leafEntry.assign((char *) &storedLength, (char *) &storedLength + sizeof(storedLength));
+        }
+        leafEntry.insert(leafEntry.end(), currentKey.begin() + keyOffset, currentKey.end());
+        vector<char> postings;
+        PostingList::encode(currentRids, postings);
+        bool chained = postings.size() - sizeof(unsigned short) > POSTING_INLINE_LIMIT;
+        if (chained)
+            PostingList::encodeOverflow(-1, postings);  // The page is known once the leaf is written
+        leafEntry.insert(leafEntry.end(), postings.begin(), postings.end());
+        int length = leafEntry.size();
+
+        if (children.empty() && leafLengths.empty())
+            ixFileHandle.setRootPageId(ixFileHandle.getPageCount() + 1, true);  // The first leaf follows, a root already
+        bool startsLeaf = leafLengths.empty();
+        if (!startsLeaf && !leafFits(leafEntry.data(), length)) {
+            char bytes[PAGE_SIZE] = {};
+            if (writeLeaf(bytes, false) == -1)
+                return -1;
+            startsLeaf = true;
+        }
+        if (startsLeaf) {
+            // Each leaf is known one level up by its least key
+            int separatorLength;
+            const char *separator = Node::entryKey(attribute, leafEntry.data(), separatorLength);
+            separators.insert(separators.end(), separator, separator + separatorLength);
+            separatorLengths.push_back(separatorLength);
+        }
+        leafEntries.insert(leafEntries.end(), leafEntry.begin(), leafEntry.end());
+        leafLengths.push_back(length);
+        if (chained) {
+            chainOffsets.push_back(leafEntries.size() - sizeof(int));
+            chains.push_back(std::move(currentRids));
+        }
+        currentRids.clear();
+        return 0;
+    }
+
+    RC TreeBuilder::finish() {
+        if (!currentRids.empty() && addKey() == -1)
+            return -1;
+        if (children.empty() && leafLengths.empty())
+            return 0;   // No entries, the tree stays empty
+        char bytes[PAGE_SIZE] = {};
+        if (writeLeaf(bytes, true) == -1)
+            return -1;
+        while (children.size() > 1)
+            if (buildLevel() == -1)
+                return -1;
+        ixFileHandle.setRootPageId(children.front());
+        return 0;
+    }
+
+    bool TreeBuilder::fits(int length) const {
+        int spaceNeeded = length + static_cast<int>(sizeof(Slot));
+        return node.directory.empty()
+               || (emptySpace - node.freeSpace + spaceNeeded <= nodeCapacity && spaceNeeded < node.freeSpace);
+    }
+
+    bool TreeBuilder::leafFits(const char *entry, int length) const {
+        int size = Node::packedSize(attribute, leafEntries.data(), entry, leafEntries.size() + length,
+                                    leafLengths.size() + 1);
+        return size <= nodeCapacity && size < emptySpace;
+    }
+
+    RC TreeBuilder::writeLeaf(char *bytes, bool last) {
+        // The leaf's posting pages are appended right after it, then comes the next leaf
+        int page = ixFileHandle.getPageCount() + 1;
+        vector<vector<char>> pages;
+        for (int i = 0; i < chains.size(); ++i) {
+            std::memcpy(&leafEntries[chainOffsets[i]], &page, sizeof(page));
+            PostingList::paginate(chains[i], page, pages);
+            page = ixFileHandle.getPageCount() + 1 + pages.size();
+        }
+        node.packEntries(attribute, leafEntries.data(), leafLengths);
+        node.nextPage = last ? -1 : page;
+        leafEntries.clear();
+        leafLengths.clear();
+        chainOffsets.clear();
+        chains.clear();
+        RC rc = writeNode(bytes);
+        for (int i = 0; rc == 0 && i < pages.size(); ++i)
+            rc = ixFileHandle.appendPage(pages[i].data()) == -1 ? -1 : 0;
+        node.reset(NODE_TYPE_LEAF);
+        return rc;
+    }
+
+    RC TreeBuilder::writeNode(char *bytes) {
+        node.populateBytes(bytes);
+        int pageId = ixFileHandle.appendPage(bytes);
+        if (pageId == -1)
+            return -1;
+        children.push_back(pageId);
+        return 0;
+    }
+
+    RC TreeBuilder::buildLevel() {
+        vector<char> childSeparators = std::move(separators);
+        vector<int> childSeparatorLengths = std::move(separatorLengths);
+        vector<int> childPages = std::move(children);
+        separators.clear();
+        separatorLengths.clear();
+        children.clear();
+
+        // The first child of a node is its nextPage, its least entry is what the node is known by one level up
+        char bytes[PAGE_SIZE] = {};
+        size_t separatorOffset = 0;
+        node.reset(NODE_TYPE_INTERMEDIATE);
+        for (int i = 0; i < childPages.size(); ++i) {
+            const char *separator = childSeparators.data() + separatorOffset;
+            int length = childSeparatorLengths[i];
+            separatorOffset += length;
+            int entryLength = length + sizeof(int);
+            if (i > 0 && fits(entryLength)) {
+                char entry[entryLength];
+                std::memcpy(entry, separator, length);
+                std::memcpy(entry + length, &childPages[i], sizeof(int));
+                node.appendEntry(entry, entryLength);
+                continue;
+            }
+            if (i > 0) {
+                if (writeNode(bytes) == -1)
+                    return -1;
+                node.reset(NODE_TYPE_INTERMEDIATE);
+            }
+            node.nextPage = childPages[i];
+            separators.insert(separators.end(), separator, separator + length);
+            separatorLengths.push_back(length);
+        }
+        return writeNode(bytes);
+    }
+}
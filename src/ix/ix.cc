@@ -1,4 +1,5 @@
 #include "src/include/ix.h"
+#include <algorithm>
 #include <src/utils/compare_utils.h>
 
 namespace PeterDB {
@@ -15,30 +16,141 @@ namespace PeterDB {
     }
 
     RC IndexManager::destroyFile(const std::string &fileName) {
-        this->cachedPage = -1;
+        nodeCaches.erase(fileName);
+        BufferPool::instance().discardFile(fileName);
         return remove(fileName.c_str());
     }
 
     RC IndexManager::openFile(const std::string &fileName, IXFileHandle &ixFileHandle) {
-        this->cachedFile = ixFileHandle.filename;
-        this->cachedPage = -1;
-        return ixFileHandle.open(fileName);
+        if (ixFileHandle.open(fileName) != 0)
+            return -1;
+        ixFileHandle.nodes = shareNodes(fileName, ixFileHandle.ixAppendPageCounter);
+        return 0;
     }
 
     RC IndexManager::closeFile(IXFileHandle &ixFileHandle) {
-        this->cachedPage = -1;
         return ixFileHandle.close();
     }
 
     RC IndexManager::insertEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
+        if (nullptr == ixFileHandle.nodes)
+            return -1;
+        // Most inserts fit in their leaf and latch only it, the rest split under the structure latch
+        RC rc = changeLeaf(ixFileHandle, attribute, key, rid, true);
+        return rc == 1 ? splitInsert(ixFileHandle, attribute, key, rid) : rc;
+    }
+
+    RC IndexManager::changeLeaf(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid,
+                                bool inserting) {
+        NodeCache &nodes = *ixFileHandle.nodes;
+        while (true) {
+            std::shared_ptr<const Node> leaf;
+            unsigned long version;
+            int leafPageId = findLeaf(ixFileHandle, attribute, key, leaf, version);
+            if (-1 == leafPageId)
+                return inserting ? 1 : -1;  // An empty tree gets its root from splitInsert
+            int index = leaf->findKey(attribute, key);
+            if (!inserting && -1 == index) {
+                if (nodes.validate(leafPageId, version))
+                    return -1;  // Key not found
+                continue;
+            }
+            vector<char> postings;
+            if (-1 == index) {
+                PostingList::encode({ rid }, postings);
+                if (!leaf->hasSpaceFor(attribute, key, postings.size()))
+                    return 1;
+            }
+            if (!nodes.upgradeLatch(leafPageId, version))
+                continue;   // Changed since it was read, start over from the root
+
+            // Posting pages of the key change under the leaf's latch too
+            Node currentNode(*leaf);
+            if (-1 != index) {
+                const char *oldPostings;
+                int oldLength = currentNode.getPostings(attribute, index, oldPostings);
+                RC rc = inserting ? PostingList::add(ixFileHandle, oldPostings, oldLength, rid, false, postings)
+                                  : PostingList::remove(ixFileHandle, oldPostings, oldLength, rid, postings);
+                bool unchanged = postings.size() == oldLength
+                                 && std::equal(postings.begin(), postings.end(), oldPostings);
+                if (0 != rc || unchanged) {
+                    nodes.writeUnlatch(leafPageId);
+                    return rc;  // Not there, a posting page to append, or only a posting page changed
+                }
+                if (!postings.empty() && !currentNode.hasSpaceFor(attribute, key, postings.size())) {
+                    nodes.writeUnlatch(leafPageId);
+                    return 1;
+                }
+            }
+
+            postings.empty() ? currentNode.deleteKey(attribute, index)
+                             : currentNode.putKey(attribute, key, postings.data(), postings.size());
+            char bytes [PAGE_SIZE] = {};
+            currentNode.populateBytes(bytes);
+            RC rc = ixFileHandle.writePage(leafPageId, bytes);
+            nodes.writeUnlatch(leafPageId);
+            return rc;
+        }
+    }
+
+    RC IndexManager::splitInsert(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
+        NodeCache &nodes = *ixFileHandle.nodes;
+        std::lock_guard<std::mutex> guard(nodes.structureLatch);
+
+        // Nothing but this splits, so the intermediate nodes hold still. Latch every node the split can reach, from
+        // the lowest one with room for another child (it stops there) down to the leaf, so readers start over.
+        vector<PageNum> latched;
         int rootPageId = ixFileHandle.getRootPageId();
         if (rootPageId == -1) {
-            ixFileHandle.setRootPageId(ixFileHandle.getPageCount() + 1, true);
+            rootPageId = ixFileHandle.getPageCount() + 1;
+            nodes.writeLatch(rootPageId);
+            latched.push_back(rootPageId);
+            ixFileHandle.setRootPageId(rootPageId, true);
             Node root(NODE_TYPE_LEAF);
             char *bytes = (char *) malloc(PAGE_SIZE); // Move inside if block
             root.populateBytes(bytes);
-            rootPageId = ixFileHandle.appendPage(bytes);
+            ixFileHandle.appendPage(bytes);
             free(bytes);
+        } else {
+            int maxEntry = attribute.length;    // separators are keys alone
+            int pageId = rootPageId;
+            while (true) {
+                bool shared = false;
+                for (PageNum page : latched)
+                    shared = shared || NodeCache::sharesLatch(page, pageId);
+                if (!shared)
+                    nodes.writeLatch(pageId);
+                latched.push_back(pageId);
+
+                std::shared_ptr<const Node> node = ixFileHandle.readNode(pageId);
+                if (nullptr == node)
+                    break;
+                bool leaf = NODE_TYPE_LEAF == node->type;
+                bool roomy = !leaf && node->hasSpace(maxEntry);
+                if (leaf) {
+                    // A new key comes with one RID, an existing one grows by at most one
+                    int index = node->findKey(attribute, key);
+                    const char *postings;
+                    int postingsLength = -1 == index ? static_cast<int>(sizeof(unsigned short))
+                                                     : node->getPostings(attribute, index, postings);
+                    roomy = node->hasSpaceFor(attribute, key, postingsLength + POSTING_RID_MAX);
+                }
+                if (roomy) {
+                    // The nodes above will not change, let readers back in
+                    for (int i = 0; i + 1 < latched.size(); i++) {
+                        bool stillHeld = false;
+                        for (int j = i + 1; j < latched.size(); j++)
+                            stillHeld = stillHeld || NodeCache::sharesLatch(latched[i], latched[j]);
+                        if (!stillHeld)
+                            nodes.writeUnlatch(latched[i]);
+                    }
+                    latched.erase(latched.begin(), latched.end() - 1);
+                }
+                if (leaf)
+                    break;
+                int location;
+                pageId = node->findChildNode(attribute, key, location);
+            }
         }
 
         InsertionChild newChild{};
@@ -46,25 +158,63 @@ namespace PeterDB {
         newChild.newChildPresent = false;
         insert(ixFileHandle, rootPageId, attribute, key, rid, &newChild);
         free(newChild.leastChildValue);
+
+        for (int i = 0; i < latched.size(); i++) {
+            bool unlatched = false;
+            for (int j = 0; j < i; j++)
+                unlatched = unlatched || NodeCache::sharesLatch(latched[i], latched[j]);
+            if (!unlatched)
+                nodes.writeUnlatch(latched[i]);
+        }
         return 0;
     }
 
+    int IndexManager::findLeaf(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key,
+                               std::shared_ptr<const Node> &node, unsigned long &version) {
+        NodeCache &nodes = *ixFileHandle.nodes;
+        while (true) {
+            int nodePageId = ixFileHandle.getRootPageId();
+            if (-1 == nodePageId)
+                return -1;
+            version = nodes.readLatch(nodePageId);
+            int rootPageId;
+            if (!nodes.getRootPageId(rootPageId) || rootPageId != nodePageId)
+                continue;   // The root split in between
+
+            node = ixFileHandle.readNode(nodePageId);
+            while (nullptr != node && NODE_TYPE_INTERMEDIATE == node->type) {
+                int location;
+                int childPageId = nullptr == key ? node->nextPage
+                                                 : node->findChildNode(attribute, key, location);
+                unsigned long childVersion = nodes.readLatch(childPageId);
+                if (!nodes.validate(nodePageId, version))
+                    break;  // The child pointer may be stale
+                nodePageId = childPageId;
+                version = childVersion;
+                node = ixFileHandle.readNode(nodePageId);
+            }
+            if (nullptr == node)
+                return -1;
+            if (NODE_TYPE_LEAF == node->type)
+                return nodePageId;
+        }
+    }
+
     void IndexManager::insert(IXFileHandle &ixFileHandle, int nodePageId, const Attribute &attribute, const void *key, const RID &rid, InsertionChild *newChild) {
-        char *bytes = (char *) malloc(PAGE_SIZE);
-        ixFileHandle.readPage(nodePageId, bytes);
-        Node currentNode(bytes);
+        // Cached nodes are shared, copy one before changing it
+        std::shared_ptr<const Node> cachedNode = ixFileHandle.readNode(nodePageId);
 
         // If not a leaf node
-        if (NODE_TYPE_INTERMEDIATE == currentNode.type) {
+        if (NODE_TYPE_INTERMEDIATE == cachedNode->type) {
             int childIndex;
-            int childId = currentNode.findChildNode(attribute, key, rid.pageNum, rid.slotNum, childIndex);
-            free(bytes);
+            int childId = cachedNode->findChildNode(attribute, key, childIndex);
             insert(ixFileHandle, childId, attribute, key, rid, newChild);
             if (!newChild->newChildPresent) {
                 return;
             }
 
-            bytes = (char *) malloc(PAGE_SIZE);
+            Node currentNode(*cachedNode);
+            char *bytes = (char *) calloc(PAGE_SIZE, 1);
             int spaceNeeded = newChild->keyLength;
             if (currentNode.hasSpace(spaceNeeded)) {
                 currentNode.insertChild(attribute, childIndex, newChild->leastChildValue, newChild->keyLength, newChild->childNodePage);
@@ -133,36 +283,35 @@ namespace PeterDB {
         }
 
         // Leaf node
-        // If node has space, insert in the right place
-        int keySize = 4;
-        if (TypeVarChar == attribute.type)
-            std::memcpy(&keySize, key, sizeof(int));
-        int spaceNeeded = keySize + sizeof(unsigned) + sizeof(unsigned short); // key size + rid
+        Node currentNode(*cachedNode);
+        currentNode.cleanDirectory(); // Slots of deleted entries may be all the leaf is short of
+        // The key's posting list with rid added, a long one moves to posting pages
+        vector<char> postings;
+        int index = currentNode.findKey(attribute, key);
+        if (-1 == index) {
+            PostingList::encode({ rid }, postings);
+        } else {
+            const char *oldPostings;
+            int oldLength = currentNode.getPostings(attribute, index, oldPostings);
+            if (PostingList::add(ixFileHandle, oldPostings, oldLength, rid, true, postings) != 0)
+                return;
+            if (postings.size() == oldLength && std::equal(postings.begin(), postings.end(), oldPostings))
+                return;     // Only a posting page changed
+        }
 
-        if (currentNode.hasSpace(spaceNeeded)) {
-            currentNode.insertKey(attribute, spaceNeeded, key, rid);
+        char *bytes = (char *) calloc(PAGE_SIZE, 1);
+        // If node has space, insert in the right place
+        if (currentNode.hasSpaceFor(attribute, key, postings.size())) {
+            currentNode.putKey(attribute, key, postings.data(), postings.size());
             currentNode.populateBytes(bytes);
             ixFileHandle.writePage(nodePageId, bytes);
             free(bytes);
             return;
         }
 
-        // Split leaf node, set up newChild
-        int splitStart;
-        char *newLeaf = (char *) malloc(PAGE_SIZE);
-        currentNode.split(newLeaf, newChild, splitStart, 0);
-
-        char formattedChildKey [newChild->keyLength];
-        RID childKeyId{};
-        parseKey(attribute.type, newChild, formattedChildKey, childKeyId);
-
-        if (CompareUtils::checkLessThan(attribute.type, key, formattedChildKey)) {
-            currentNode.insertKey(attribute, spaceNeeded, key, rid);
-        } else {
-            Node newLeafNode (newLeaf);
-            newLeafNode.insertKey(attribute, spaceNeeded, key, rid);
-            newLeafNode.populateBytes(newLeaf);
-        }
+        // Split leaf node with the key in it, set up newChild
+        char *newLeaf = (char *) calloc(PAGE_SIZE, 1);
+        currentNode.splitLeaf(attribute, key, postings.data(), postings.size(), newLeaf, newChild);
 
         int newPageId = ixFileHandle.appendPage(newLeaf);
         free(newLeaf);
@@ -189,34 +338,9 @@ namespace PeterDB {
     }
 
     RC IndexManager::deleteEntry(IXFileHandle &ixFileHandle, const Attribute &attribute, const void *key, const RID &rid) {
-        char *bytes = (char *) malloc(PAGE_SIZE);
-        int rootId = ixFileHandle.getRootPageId();
-        ixFileHandle.readPage(rootId, bytes);
-        Node currentNode(bytes);
-
-        // Find the leaf node with this key/rid
-        int keyPageId = rootId;
-        while (NODE_TYPE_LEAF != currentNode.type){
-            int location;
-            keyPageId = currentNode.findChildNode(attribute, key, rid.pageNum, rid.slotNum, location);
-            ixFileHandle.readPage(keyPageId, bytes);
-            currentNode.reload(bytes);
-        }
-        int indexToDelete = currentNode.findKey(attribute, key, rid);
-        if (-1 == indexToDelete) {
-            free(bytes);
-            return -1; // Key not found
-        }
-
-        currentNode.deleteKey(attribute, indexToDelete);
-        currentNode.populateBytes(bytes);
-        ixFileHandle.writePage(keyPageId, bytes);
-
-        if (cached(ixFileHandle.filename, keyPageId))
-            refreshCache(bytes, keyPageId);
-
-        free(bytes);
-        return 0;
+        if (nullptr == ixFileHandle.nodes)
+            return -1;
+        return changeLeaf(ixFileHandle, attribute, key, rid, false);
     }
 
     RC IndexManager::scan(IXFileHandle &ixFileHandle,
@@ -226,7 +350,7 @@ namespace PeterDB {
                           bool lowKeyInclusive,
                           bool highKeyInclusive,
                           IX_ScanIterator &ix_ScanIterator) {
-        if (!ixFileHandle.works())
+        if (!ixFileHandle.works() || nullptr == ixFileHandle.nodes)
             return -1;
         ix_ScanIterator.attribute = attribute;
         ix_ScanIterator.lowKey = const_cast<void *>(lowKey);
@@ -237,7 +361,10 @@ namespace PeterDB {
         ix_ScanIterator.pageNum = ixFileHandle.getRootPageId();
         ix_ScanIterator.slotNum = 0;
         ix_ScanIterator.searching = true;
-        this->cachedPage = -1;
+        ix_ScanIterator.node.reset();
+        ix_ScanIterator.nodePage = -1;
+        ix_ScanIterator.rids.clear();
+        ix_ScanIterator.ridIndex = 0;
         return 0;
     }
 
@@ -254,7 +381,7 @@ namespace PeterDB {
         Node currentNode(bytes);
         free(bytes);
 
-        json.append(currentNode.toJsonKeys(attribute));
+        json.append(currentNode.toJsonKeys(attribute, ixFileHandle));
 
         if (NODE_TYPE_INTERMEDIATE == currentNode.type) {
             string childrenJson = "\"children\":[";
@@ -277,33 +404,12 @@ namespace PeterDB {
         return json;
     }
 
-    void IndexManager::refreshCache(IXFileHandle &ixFileHandle, int pageId) {
-        char nodeBytes[PAGE_SIZE];
-        ixFileHandle.readPage(pageId, nodeBytes);
-        cachedNode.reload(nodeBytes);
-        cachedPage = pageId;
-        cachedFile = ixFileHandle.filename;
-    }
-
-    void IndexManager::refreshCache(char *bytes, int pageId) {
-        cachedNode.reload(bytes);
-        cachedPage = pageId;
-    }
-
-    bool IndexManager::cached(const string& filename, int pageId) const {
-        return cachedPage == pageId && this->cachedFile == filename;
-    }
-
-    void IndexManager::parseKey(AttrType attrType, InsertionChild *child, char *key, RID &rid) {
-        int formattedKeyLength = TypeVarChar != attrType ? 4 : child->keyLength - sizeof(RID::pageNum) - sizeof(RID::slotNum);
-        int copiedOffset = 0;
-        if (TypeVarChar == attrType) {
-            std::memcpy(key, &formattedKeyLength, sizeof(formattedKeyLength));
-            copiedOffset += sizeof(formattedKeyLength);
+    std::shared_ptr<NodeCache> IndexManager::shareNodes(const std::string &fileName, unsigned pageCount) {
+        std::shared_ptr<NodeCache> nodes = nodeCaches[fileName].lock();
+        if (nullptr == nodes) {
+            nodes = std::make_shared<NodeCache>(pageCount);
+            nodeCaches[fileName] = nodes;
         }
-
-        std::memcpy(key + copiedOffset, child->leastChildValue, formattedKeyLength);
-        std::memcpy(&rid.pageNum, (char *)child->leastChildValue + formattedKeyLength, sizeof(RID::pageNum));
-        std::memcpy(&rid.slotNum, (char *)child->leastChildValue + formattedKeyLength + sizeof(RID::pageNum), sizeof(RID::slotNum));
+        return nodes;
     }
 } // namespace PeterDB
\ No newline at end of file
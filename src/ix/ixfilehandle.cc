@@ -6,15 +6,20 @@ namespace PeterDB {
         ixReadPageCounter = 0;
         ixWritePageCounter = 0;
         ixAppendPageCounter = 0;
+        ixCacheHitCounter = 0;
+        ixCacheMissCounter = 0;
     }
 
     IXFileHandle::~IXFileHandle() = default;
 
     IXFileHandle& IXFileHandle::operator=(const IXFileHandle &other) {
-        this->ixReadPageCounter = other.ixReadPageCounter;
-        this->ixWritePageCounter = other.ixWritePageCounter;
-        this->ixAppendPageCounter = other.ixAppendPageCounter;
+        this->ixReadPageCounter = other.ixReadPageCounter.load();
+        this->ixWritePageCounter = other.ixWritePageCounter.load();
+        this->ixAppendPageCounter = other.ixAppendPageCounter.load();
+        this->ixCacheHitCounter = other.ixCacheHitCounter.load();
+        this->ixCacheMissCounter = other.ixCacheMissCounter.load();
         this->filename = other.filename;
+        this->nodes = other.nodes;
         // use setFile for fstream ixFile
         return *this;
     }
@@ -30,8 +35,15 @@ namespace PeterDB {
         return 0;
     }
 
+    RC IXFileHandle::collectCacheCounterValues(unsigned &hitCount, unsigned &missCount) {
+        hitCount = ixCacheHitCounter;
+        missCount = ixCacheMissCounter;
+        return 0;
+    }
+
     RC IXFileHandle::create(const std::string &fileName) {
         if (FileHandle::exists(fileName)) return -1;
+        BufferPool::instance().discardFile(fileName);
         ixFile = fstream(fileName, ios::out);
         init();
         close();
@@ -50,10 +62,15 @@ namespace PeterDB {
         }
         filename = fileName;
         ixFile = fstream(fileName, ios::in | ios::out | ios::binary);
+        BufferPool::instance().enableChecksums(fileName);
 
-        int counters[3] = { 0, 0, 0 };
+        int counters[5] = { 0, 0, 0, 0, 0 };
         ixFile.seekg(0);
         ixFile.read(reinterpret_cast<char *>(counters), sizeof(counters));
+        if ((counters[3] == 0 ? 4096 : counters[3]) != PAGE_SIZE || counters[4] != IX_FORMAT_VERSION) {
+            ixFile.close();     // Nodes are laid out for the page size and format the file was written with
+            return -1;
+        }
         ixReadPageCounter = counters[0];
         ixWritePageCounter = counters[1];
         ixAppendPageCounter = counters[2];
@@ -66,62 +83,90 @@ namespace PeterDB {
         if (!ixFile.is_open())
             return 0;
 
+        unsigned pagesWritten = 0;
+        BufferPool::instance().flushFile(filename, pagesWritten);
+        ixWritePageCounter += pagesWritten;
         ixWritePageCounter++;
         ixFile.seekp(0);
-        int counters[3] = { static_cast<int>(ixReadPageCounter), static_cast<int>(ixWritePageCounter), static_cast<int>(ixAppendPageCounter) };
+        // The page count is the file's, other handles may have appended since this one was opened
+        int counters[5] = { static_cast<int>(ixReadPageCounter), static_cast<int>(ixWritePageCounter),
+                            static_cast<int>(getPageCount()), PAGE_SIZE, IX_FORMAT_VERSION };
         ixFile.write(reinterpret_cast<char *>(counters), sizeof(counters));
         int spaceToReserve = PAGE_SIZE * IX_HIDDEN_PAGE_COUNT - sizeof(counters);
         char junk[spaceToReserve];
         ixFile.write(junk, spaceToReserve);
         ixFile.close();
+        nodes.reset();
         return 0;
     }
 
     RC IXFileHandle::readPage(PageNum pageNum, void *data) {
-        char bytes[PAGE_SIZE];
-        if (ixFile.eof())
-            ixFile.clear();
-        ixFile.seekg(pageNum * PAGE_SIZE, ios::beg);
-        ixFile.read(bytes, PAGE_SIZE);
-        std::memcpy(data, bytes, PAGE_SIZE);
+        bool hit = false;
+        if (BufferPool::instance().readPage(filename, pageNum, data, hit) == -1)
+            return -1;
         ixReadPageCounter++;
+        hit ? ixCacheHitCounter++ : ixCacheMissCounter++;
         return 0;
     }
 
     RC IXFileHandle::writePage(PageNum pageNum, const void *data) {
-        ixFile.seekp(pageNum * PAGE_SIZE, ios::beg);
-        ixFile.write(reinterpret_cast<char *>(const_cast<void *>(data)), PAGE_SIZE);
-        ixFile.flush();
+        if (BufferPool::instance().writePage(filename, pageNum, data) == -1)
+            return -1;
         ixWritePageCounter++;
+        if (nullptr != nodes)
+            nodes->pageWritten(pageNum);
         return 0;
     }
 
     int IXFileHandle::appendPage(const void *data) {
-        ixFile.seekp(getPageCount() * PAGE_SIZE, ios::beg);
-        ixFile.write(reinterpret_cast<char *>(const_cast<void *>(data)), PAGE_SIZE);
-        ixFile.flush();
+        unsigned pageNum = getPageCount();
+        if (BufferPool::instance().writePage(filename, pageNum, data) == -1)
+            return -1;
         ixAppendPageCounter++;
-        return static_cast<int>(ixAppendPageCounter - 1);
+        if (nullptr != nodes) {
+            nodes->pageWritten(pageNum);
+            nodes->pageCount++;
+        }
+        return static_cast<int>(pageNum);
     }
 
     void IXFileHandle::setRootPageId(int rootId, bool create) {
         char bytes [PAGE_SIZE];
         std::memcpy(bytes, &rootId, sizeof(rootId));
         create ? appendPage(bytes) : writePage(IX_HIDDEN_PAGE_COUNT, bytes);
+        if (nullptr != nodes)
+            nodes->setRootPageId(rootId);
     }
 
     int IXFileHandle::getRootPageId() {
         if (getPageCount() <= IX_HIDDEN_PAGE_COUNT)
             return -1;
+        int rootPage;
+        if (nullptr != nodes && nodes->getRootPageId(rootPage)) {
+            ixReadPageCounter++;    // The root pointer page, read from memory
+            ixCacheHitCounter++;
+            return rootPage;
+        }
         char bytes [PAGE_SIZE];
         readPage(IX_HIDDEN_PAGE_COUNT, bytes);
-        int rootPage;
         std::memcpy(&rootPage, bytes, sizeof(rootPage));
+        if (nullptr != nodes)
+            nodes->setRootPageId(rootPage);
         return rootPage;
     }
 
+    std::shared_ptr<const Node> IXFileHandle::readNode(PageNum pageNum) {
+        if (nullptr != nodes)
+            return nodes->getNode(*this, pageNum);
+        char bytes [PAGE_SIZE];
+        if (readPage(pageNum, bytes) == -1)
+            return nullptr;
+        return std::make_shared<Node>(bytes);
+    }
+
+
     unsigned IXFileHandle::getPageCount() const {
-        return ixAppendPageCounter;
+        return nullptr != nodes ? nodes->pageCount.load() : ixAppendPageCounter.load();
     }
 
     bool IXFileHandle::works() {
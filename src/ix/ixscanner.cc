@@ -7,48 +7,104 @@ namespace PeterDB {
     IX_ScanIterator::~IX_ScanIterator() = default;
 
     RC IX_ScanIterator::getNextEntry(RID &rid, void *key) {
-        IndexManager &ixManager = IndexManager::instance();
+        if (ridIndex < rids.size()) {
+            // The rest of the last key's RIDs come first
+            rid = rids[ridIndex++];
+            std::memcpy(key, ridsKey.data(), ridsKey.size());
+            return 0;
+        }
         if (pageNum == -1)
             return IX_EOF;
 
-        if (!ixManager.cached(ixFileHandle->filename, pageNum))
-            ixManager.refreshCache(*ixFileHandle, pageNum);
-
-        // Go to the correct leaf
-        while (NODE_TYPE_INTERMEDIATE == ixManager.cachedNode.type) {
-            int location;
-            int pageId = nullptr == lowKey ? ixManager.cachedNode.nextPage : ixManager.cachedNode.findChildNode(attribute, lowKey, -1, -1, location, true);
-            pageNum = pageId;
-            ixManager.refreshCache(*ixFileHandle, pageId);
-        }
-
-        // Find the index in this leaf node
-        if (searching && nullptr != lowKey) {
+        if (searching) {
+            // Go to the correct leaf
             searching = false;
-            slotNum = ixManager.cachedNode.findKey(attribute, lowKey, {}, false, true);
-        }
-
-        while (!ixManager.cachedNode.validateIndex(slotNum)) {
-            incrementCursor(ixManager.cachedNode.getKeyCount(), ixManager.cachedNode.nextPage);
+            unsigned long version;
+            do {
+                pageNum = IndexManager::instance().findLeaf(*ixFileHandle, attribute, lowKey, node, version);
+                if (pageNum == -1)
+                    return IX_EOF;
+            } while (!ixFileHandle->nodes->validate(pageNum, version));
+            nodePage = pageNum;
+
+            // Find the index in this leaf node
+            if (nullptr != lowKey)
+                slotNum = node->findKey(attribute, lowKey, true);
+        } else if (loadLeaf() == -1)
+            return -1;
+
+        while (!node->validateIndex(slotNum)) {
+            incrementCursor(node->getKeyCount(), node->nextPage);
             if (pageNum == -1)
                 return IX_EOF;
-            if (ixManager.cached(ixFileHandle->filename, pageNum))
-                continue;
-            ixManager.refreshCache(*ixFileHandle, pageNum);
+            if (loadLeaf() == -1)
+                return -1;
         }
-        ixManager.cachedNode.getKeyData(attribute, slotNum, static_cast<char *>(key), rid);
+        node->getKey(attribute, slotNum, static_cast<char *>(key));
+        int index = slotNum;
 
-        incrementCursor(ixManager.cachedNode.getKeyCount(), ixManager.cachedNode.nextPage);
+        incrementCursor(node->getKeyCount(), node->nextPage);
 
         if (!meetsCondition(key))
             return getNextEntry(rid, key);
 
+        // The key's whole posting list is read at once, its RIDs go out one a call
+        if (readRids(index) == -1)
+            return -1;
+        int keyLength = sizeof(int);
+        if (TypeVarChar == attribute.type) {
+            std::memcpy(&keyLength, key, sizeof(keyLength));
+            keyLength += sizeof(int);
+        }
+        ridsKey.assign(static_cast<char *>(key), static_cast<char *>(key) + keyLength);
+        ridIndex = 0;
+        if (rids.empty())
+            return getNextEntry(rid, key);
+        rid = rids[ridIndex++];
         return 0;
     }
 
     RC IX_ScanIterator::close() {
         pageNum = -1;
         slotNum = -1;
+        node.reset();
+        nodePage = -1;
+        rids.clear();
+        ridIndex = 0;
+        return 0;
+    }
+
+    RC IX_ScanIterator::readRids(int index) {
+        const char *postings;
+        node->getPostings(attribute, index, postings);
+        if (-1 == PostingList::overflowPage(postings))
+            return PostingList::read(*ixFileHandle, postings, rids);
+
+        // Posting pages change under the latch of their leaf, read them all at one version of it
+        NodeCache &nodes = *ixFileHandle->nodes;
+        while (true) {
+            unsigned long version = nodes.readLatch(nodePage);
+            if (PostingList::read(*ixFileHandle, postings, rids) == -1)
+                return -1;
+            if (nodes.validate(nodePage, version))
+                return 0;
+        }
+    }
+
+    RC IX_ScanIterator::loadLeaf() {
+        // Each leaf is read once, as it was when the scan got to it. Entries that go into it later are missed, like
+        // those going into a leaf the scan has passed, and a split only moves entries to the leaf's right.
+        if (nodePage == pageNum)
+            return 0;
+        NodeCache &nodes = *ixFileHandle->nodes;
+        unsigned long version;
+        do {
+            version = nodes.readLatch(pageNum);
+            node = ixFileHandle->readNode(pageNum);
+            if (nullptr == node)
+                return -1;
+        } while (!nodes.validate(pageNum, version));
+        nodePage = pageNum;
         return 0;
     }
 
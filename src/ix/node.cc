@@ -3,32 +3,41 @@
 #include "src/include/ix.h"
 
 namespace PeterDB{
+    namespace {
+        int commonLength(const char *key, int keyLength, const char *otherKey, int otherLength) {
+            int length = 0;
+            while (length < keyLength && length < otherLength && key[length] == otherKey[length])
+                length++;
+            return length;
+        }
+    }
 
     Node::Node() {
         keys = nullptr;
-        freeSpace = PAGE_SIZE - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
+        freeSpace = PAGE_DATA_SIZE - sizeof(prefixLength) - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
         type = NODE_TYPE_INTERMEDIATE;
         nextPage = -1;
     }
 
     Node::Node(char nodeType) {
         keys = nullptr;
-        freeSpace = PAGE_SIZE - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
+        freeSpace = PAGE_DATA_SIZE - sizeof(prefixLength) - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
         type = nodeType;
         nextPage = -1;
     }
 
     Node::Node(char *bytes) {
         // Populate metadata
-        std::memcpy(&type, bytes + PAGE_SIZE - sizeof(type), sizeof(type));
-        std::memcpy(&freeSpace, bytes + PAGE_SIZE - sizeof(freeSpace) - sizeof(type), sizeof(freeSpace));
-        std::memcpy(&nextPage,  bytes + PAGE_SIZE - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(nextPage));
+        std::memcpy(&type, bytes + PAGE_DATA_SIZE - sizeof(type), sizeof(type));
+        std::memcpy(&freeSpace, bytes + PAGE_DATA_SIZE - sizeof(freeSpace) - sizeof(type), sizeof(freeSpace));
+        std::memcpy(&nextPage,  bytes + PAGE_DATA_SIZE - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(nextPage));
         int directoryCount = 0;
-        std::memcpy(&directoryCount, bytes + PAGE_SIZE - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(directoryCount));
+        std::memcpy(&directoryCount, bytes + PAGE_DATA_SIZE - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(directoryCount));
+        std::memcpy(&prefixLength, bytes + PAGE_DATA_SIZE - sizeof(prefixLength) - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(prefixLength));
         if (directoryCount > 0) {
             int directorySize = directoryCount * sizeof(Slot);
             directory = vector<Slot>(directoryCount, {0, 0});
-            std::memcpy(directory.data(), bytes + PAGE_SIZE - directorySize - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), directorySize);
+            std::memcpy(directory.data(), bytes + PAGE_DATA_SIZE - directorySize - sizeof(prefixLength) - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), directorySize);
         }
 
         // Populate data
@@ -36,17 +45,25 @@ namespace PeterDB{
         std::memcpy(keys, bytes, PAGE_SIZE);
     }
 
+    Node::Node(const Node &other) : type(other.type), freeSpace(other.freeSpace), nextPage(other.nextPage),
+                                    prefixLength(other.prefixLength), directory(other.directory) {
+        keys = (char *) malloc(PAGE_SIZE);
+        if (nullptr != other.keys)
+            std::memcpy(keys, other.keys, PAGE_SIZE);
+    }
+
     void Node::reload(char *bytes) {
         // Populate metadata
-        std::memcpy(&type, bytes + PAGE_SIZE - sizeof(type), sizeof(type));
-        std::memcpy(&freeSpace, bytes + PAGE_SIZE - sizeof(freeSpace) - sizeof(type), sizeof(freeSpace));
-        std::memcpy(&nextPage,  bytes + PAGE_SIZE - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(nextPage));
+        std::memcpy(&type, bytes + PAGE_DATA_SIZE - sizeof(type), sizeof(type));
+        std::memcpy(&freeSpace, bytes + PAGE_DATA_SIZE - sizeof(freeSpace) - sizeof(type), sizeof(freeSpace));
+        std::memcpy(&nextPage,  bytes + PAGE_DATA_SIZE - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(nextPage));
         int directoryCount = 0;
-        std::memcpy(&directoryCount, bytes + PAGE_SIZE - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(directoryCount));
+        std::memcpy(&directoryCount, bytes + PAGE_DATA_SIZE - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(directoryCount));
+        std::memcpy(&prefixLength, bytes + PAGE_DATA_SIZE - sizeof(prefixLength) - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), sizeof(prefixLength));
         if (directoryCount > 0) {
             int directorySize = directoryCount * sizeof(Slot);
             directory = vector<Slot>(directoryCount, {0, 0});
-            std::memcpy(directory.data(), bytes + PAGE_SIZE - directorySize - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), directorySize);
+            std::memcpy(directory.data(), bytes + PAGE_DATA_SIZE - directorySize - sizeof(prefixLength) - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type), directorySize);
         }
 
         // Populate data
@@ -57,27 +74,30 @@ namespace PeterDB{
     }
 
     int Node::getOccupiedSpace() const {
-        return PAGE_SIZE - freeSpace;
+        return PAGE_DATA_SIZE - freeSpace;
     }
 
     void Node::populateBytes(char *bytes) {
         int directoryCount = directory.size();
         int directorySize = sizeof(Slot) * directoryCount;
-        int dataSize = PAGE_SIZE - freeSpace - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type) - directorySize;
+        int dataSize = PAGE_DATA_SIZE - freeSpace - sizeof(prefixLength) - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type) - directorySize;
         if (nullptr != keys)
             std::memcpy(bytes, keys, dataSize);
 
         if (directoryCount > 0)
-            std::memcpy(bytes + PAGE_SIZE - directorySize - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
+            std::memcpy(bytes + PAGE_DATA_SIZE - directorySize - sizeof(prefixLength) - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
                         directory.data(), directorySize);
 
-        std::memcpy(bytes + PAGE_SIZE - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
+        std::memcpy(bytes + PAGE_DATA_SIZE - sizeof(prefixLength) - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
+                    &prefixLength, sizeof(prefixLength));
+
+        std::memcpy(bytes + PAGE_DATA_SIZE - sizeof(directoryCount) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
                     &directoryCount, sizeof(directoryCount));
-        std::memcpy(bytes + PAGE_SIZE - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
+        std::memcpy(bytes + PAGE_DATA_SIZE - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type),
                     &nextPage, sizeof(nextPage));
-        std::memcpy(bytes + PAGE_SIZE - sizeof(freeSpace) - sizeof(type),
+        std::memcpy(bytes + PAGE_DATA_SIZE - sizeof(freeSpace) - sizeof(type),
                     &freeSpace, sizeof(freeSpace));
-        std::memcpy(bytes + PAGE_SIZE - sizeof(type),
+        std::memcpy(bytes + PAGE_DATA_SIZE - sizeof(type),
                     &type, sizeof(type));
     }
 
@@ -88,174 +108,223 @@ namespace PeterDB{
         return freeSpace > spaceNeeded;
     }
 
-    int Node::findChildNode(const Attribute &keyField, const void *key, long pageId, int slotId, int &index, bool compareRids){
+    int Node::findChildNode(const Attribute &keyField, const void *key, int &index) const {
         // Key is expected formatted with varchar length at the start
 
         // Find the correct sub-tree, return child page ID
         if (NODE_TYPE_LEAF == type)
             return -1;
 
-        if (directory.empty()) {
-            index = 0;
-            return nextPage;
+        // The child right of the last entry at or below key, the leftmost child (nextPage) when there is none
+        int above = searchSlots(keyField.type, key, true);
+        index = above;
+        while (--above >= 0) {
+            Slot entry = directory[above];
+            if (entry.offset == -1)
+                continue;
+            int childPage;
+            std::memcpy(&childPage, keys + entry.offset + entry.length - sizeof(childPage), sizeof(childPage));
+            return childPage;
         }
+        index = 0;
+        return nextPage;
+    }
 
-        char firstKey [directory.at(0).length + sizeof(int)]; // Why adding sizeof(int)?
-        RID firstRid {};
-        populateFormattedKey(keyField.type, firstKey, firstRid, 0);
+    int Node::findKey(const Attribute &keyField, const void *key, bool getIndex) const {
+        if (directory.empty() || NODE_TYPE_INTERMEDIATE == type)
+            return -1;
 
-        // given key < leftmost entry in node
-        if (CompareUtils::checkLessThan(keyField.type, key, firstKey)) {
-            index = 0;
-            return nextPage;
+        // First entry at or above key, the index to insert at when there is no equal one
+        int index = searchSlots(keyField.type, key, false);
+        if (index < directory.size()) {
+            int keyLength;
+            const char *keyBytes = CompareUtils::rawValue(keyField.type, key, keyLength);
+            if (stripPrefix(keyBytes, keyLength) == 0 && compareEntry(keyField.type, index, keyBytes, keyLength) == 0)
+                return index;
         }
-        if (CompareUtils::checkEqual(keyField.type, key, firstKey) && compareRids &&
-            (pageId < firstRid.pageNum || (pageId == firstRid.pageNum && slotId < firstRid.slotNum))) {
-            index = 0;
-            return nextPage;
+        return getIndex ? index : -1;
+    }
+
+    int Node::searchSlots(AttrType keyType, const void *key, bool upper) const {
+        int keyLength;
+        const char *keyBytes = CompareUtils::rawValue(keyType, key, keyLength);
+        int side = stripPrefix(keyBytes, keyLength);
+        if (side > 0)
+            return directory.size();
+        if (side < 0) {
+            int live = 0;
+            while (live < directory.size() && directory[live].offset == -1)
+                live++;
+            return live;
+        }
+        switch (keyType) {
+            case TypeInt:
+                return searchSlots<TypeInt>(keyBytes, keyLength, upper);
+            case TypeReal:
+                return searchSlots<TypeReal>(keyBytes, keyLength, upper);
+            case TypeVarChar:
+                return searchSlots<TypeVarChar>(keyBytes, keyLength, upper);
         }
+        return 0;
+    }
 
-        int lastIndex = 0;
-        for (int i = 0; i < directory.size() - 1; ) {
-            Slot current = directory.at(i);
-            if (current.offset == -1) {
-                ++i;
+    template<AttrType keyType>
+    int Node::searchSlots(const char *key, int keyLength, bool upper) const {
+        // Binary search over the directory, comparing keys where they lie. Deleted slots are stepped over to the
+        // next live one, a range with none left is dropped.
+        int low = 0, high = directory.size();
+        while (low < high) {
+            int middle = low + (high - low) / 2;
+            int live = middle;
+            while (live < high && directory[live].offset == -1)
+                live++;
+            if (live == high) {
+                high = middle;
                 continue;
             }
+            int order = compareEntry<keyType>(live, key, keyLength);
+            if (order < 0 || (upper && order == 0))
+                low = live + 1;
+            else
+                high = live;
+        }
+        while (low < directory.size() && directory[low].offset == -1)
+            low++;
+        return low;
+    }
 
-            char currentKey [current.length + sizeof(int)];
-            RID currentRid {};
-            populateFormattedKey(keyField.type, currentKey, currentRid, i);
-
-            int nextIndex = i + 1;
-            Slot next = directory.at(nextIndex);
-            while (next.offset == -1) {
-                ++nextIndex;
-                if (nextIndex >= directory.size())
-                    break;
-                next = directory.at(nextIndex);
-            }
-            if (nextIndex >= directory.size())
-                break;
-            lastIndex = nextIndex;
-
-            char nextKey [next.length + sizeof(int)];
-            RID nextRid;
-            populateFormattedKey(keyField.type, nextKey, nextRid, nextIndex);
-
-            // current key <= given key < next key
-            if ((CompareUtils::checkGreaterThan(keyField.type, key, currentKey)
-                    || (CompareUtils::checkEqual(keyField.type, key, currentKey) &&
-                        (pageId > currentRid.pageNum || (pageId == currentRid.pageNum && slotId >= currentRid.slotNum) ))
-                ) &&
-                (CompareUtils::checkLessThan(keyField.type, key, nextKey)
-                    || (CompareUtils::checkEqual(keyField.type, key, nextKey) &&
-                        (pageId < nextRid.pageNum || (pageId == nextRid.pageNum && slotId < nextRid.slotNum)))
-                 )) {
-                index = nextIndex;
-                int childPage = -1;
-                std::memcpy(&childPage, keys + current.offset + current.length - sizeof(childPage), sizeof(childPage));
-                return childPage;
-            }
-
-            i = nextIndex;
+    int Node::compareEntry(AttrType keyType, int index, const char *key, int keyLength) const {
+        switch (keyType) {
+            case TypeInt:
+                return compareEntry<TypeInt>(index, key, keyLength);
+            case TypeReal:
+                return compareEntry<TypeReal>(index, key, keyLength);
+            case TypeVarChar:
+                return compareEntry<TypeVarChar>(index, key, keyLength);
         }
+        return 0;
+    }
 
-        // Key >= last key in node, return last childNode
-        int lastChild = -1;
-        Slot last = directory.at(lastIndex);
-        std::memcpy(&lastChild, keys + last.offset + last.length - sizeof(lastChild), sizeof(lastChild));
-        index = lastIndex + 1;
-        return lastChild;
+    template<AttrType keyType>
+    int Node::compareEntry(int index, const char *key, int keyLength) const {
+        int entryKeyLength;
+        const char *entryKey = storedKey(keyType, index, entryKeyLength);
+        return RawOrder<keyType>::compare(entryKey, entryKeyLength, key, keyLength);
     }
 
-    int Node::findKey(const Attribute &keyField, const void *key, const RID &rid, bool compareRid, bool getIndex){
-        if (directory.empty() || NODE_TYPE_INTERMEDIATE == type)
-            return -1;
+    const char *Node::storedKey(AttrType keyType, int index, int &keyLength) const {
+        Slot entry = directory[index];
+        const char *entryKey = keys + entry.offset;
+        if (NODE_TYPE_INTERMEDIATE == type) {
+            keyLength = entry.length - sizeof(int);     // then the child page
+            return entryKey;
+        }
+        if (TypeVarChar != keyType) {
+            keyLength = sizeof(int);
+            return entryKey;
+        }
+        unsigned short storedLength;
+        std::memcpy(&storedLength, entryKey, sizeof(storedLength));
+        keyLength = storedLength;
+        return entryKey + sizeof(storedLength);
+    }
 
-        // Find the correct leaf entry
-        int left  = 0; // initialise to first non-empty index
-        while (left < directory.size() && directory.at(left).offset == -1)
-            left++;
-
-        int right = directory.size() - 1; // initialise to last non-empty index
-        while (right >= 0 && directory.at(right).offset == -1)
-            right--;
-
-        while (left <= right) {
-            int middleIndex = (left + right) / 2;
-            int initialMiddle = middleIndex;
-            Slot middle = directory.at(middleIndex);
-            while (middle.offset == -1 && middleIndex <= right) {
-                middleIndex++;
-                middle = directory.at(middleIndex);
-            }
+    int Node::stripPrefix(const char *&key, int &keyLength) const {
+        if (0 == prefixLength)
+            return 0;
+        int order = std::memcmp(key, keys, std::min(keyLength, (int) prefixLength));
+        if (order == 0 && keyLength < prefixLength)
+            return -1;  // A prefix of the prefix sorts first
+        if (order != 0)
+            return order < 0 ? -1 : 1;
+        key += prefixLength;
+        keyLength -= prefixLength;
+        return 0;
+    }
 
-            int middleKeyLength = middle.length - sizeof(RID::pageNum) - sizeof(RID::slotNum);
-            char middleKey[middleKeyLength + sizeof(int)];
-            int copiedOffset = 0;
-            if (TypeVarChar == keyField.type) {
-                std::memcpy(middleKey, &middleKeyLength, sizeof(middleKeyLength));
-                copiedOffset += sizeof(middleKeyLength);
-            }
-            std::memcpy(middleKey + copiedOffset, keys + middle.offset, middleKeyLength);
+    int Node::sharedPrefix(const char *key, int keyLength) const {
+        int shared = 0;
+        while (shared < prefixLength && shared < keyLength && key[shared] == keys[shared])
+            shared++;
+        return shared;
+    }
 
-            if (CompareUtils::checkLessThan(keyField.type, middleKey, key)) {
-                left = middleIndex + 1;
-                continue;
-            }
-            if (CompareUtils::checkGreaterThan(keyField.type, middleKey, key)) {
-                right = initialMiddle - 1;
+    void Node::shortenPrefix(int length) {
+        // Each live entry takes back the prefix bytes past length, the page is laid out afresh
+        int moved = prefixLength - length;
+        char *shortened = (char *) malloc(PAGE_SIZE);
+        std::memcpy(shortened, keys, length);
+        int offset = length, liveCount = 0;
+        for (Slot &slot : directory) {
+            if (slot.offset == -1)
                 continue;
-            }
-
-            if (!compareRid) {
-                while(middleIndex >= 0 && CompareUtils::checkEqual(keyField.type, middleKey, key)){
-                    middle = directory.at(middleIndex);
-                    if (TypeVarChar == keyField.type) {
-                        std::memcpy(middleKey, &middleKeyLength, sizeof(middleKeyLength));
-                        copiedOffset += sizeof(middleKeyLength);
-                    }
-                    std::memcpy(middleKey + copiedOffset, keys + middle.offset, middleKeyLength);
-                    middleIndex--;
-                }
-                return middleIndex + 1;
-            }
-
-            unsigned keyPageNum;
-            unsigned short keySlotNum;
-            std::memcpy(&keyPageNum, keys + middle.offset + middleKeyLength, sizeof(keyPageNum));
-            std::memcpy(&keySlotNum, keys + middle.offset + middle.length - sizeof(keySlotNum),
-                        sizeof(keySlotNum));
-            if (keyPageNum < rid.pageNum || (keyPageNum == rid.pageNum && keySlotNum < rid.slotNum)) {
-                left = middleIndex + 1;
-            } else if (keyPageNum > rid.pageNum || (keyPageNum == rid.pageNum && keySlotNum > rid.slotNum)) {
-                right = initialMiddle - 1;
-            } else {
-                return middleIndex;
-            }
+            unsigned short storedLength;
+            std::memcpy(&storedLength, keys + slot.offset, sizeof(storedLength));
+            storedLength += moved;
+            std::memcpy(shortened + offset, &storedLength, sizeof(storedLength));
+            std::memcpy(shortened + offset + sizeof(storedLength), keys + length, moved);
+            std::memcpy(shortened + offset + sizeof(storedLength) + moved, keys + slot.offset + sizeof(storedLength),
+                        slot.length - sizeof(storedLength));
+            slot = { static_cast<short>(offset), static_cast<short>(slot.length + moved) };
+            offset += slot.length;
+            liveCount++;
         }
-        // If not found
-        return getIndex ? left : -1; // TODO: check which index to return when index is needed
+        free(keys);
+        keys = shortened;
+        freeSpace -= moved * (liveCount - 1);
+        prefixLength = static_cast<short>(length);
     }
 
-    void Node::insertKey(const Attribute &keyField, int dataSpace, const void *key, const RID &rid) {
-        int keySize = 4;
-        int keyStart = 0;
-        if (TypeVarChar == keyField.type) {
-            std::memcpy(&keySize, key, sizeof(int));
-            keyStart += sizeof(int);
-        }
+    int Node::entryLength(const Attribute &keyField, const void *key, int postingsLength) const {
+        int keyLength;
+        const char *keyBytes = CompareUtils::rawValue(keyField.type, key, keyLength);
+        int length = keyLength - sharedPrefix(keyBytes, keyLength) + postingsLength;
+        return TypeVarChar == keyField.type ? length + static_cast<int>(sizeof(unsigned short)) : length;
+    }
 
-        int freeSpaceStart = getFreeSpaceStart();
+    bool Node::hasSpaceFor(const Attribute &keyField, const void *key, int postingsLength) const {
+        int length = entryLength(keyField, key, postingsLength);
+        int existing = findKey(keyField, key);
+        if (-1 != existing)
+            return freeSpace > length - directory[existing].length;
+
+        int keyLength;
+        const char *keyBytes = CompareUtils::rawValue(keyField.type, key, keyLength);
+        int liveCount = 0;
+        for (const Slot &slot : directory)
+            liveCount += slot.offset != -1;
+        return hasSpace(length + (prefixLength - sharedPrefix(keyBytes, keyLength)) * (liveCount - 1));
+    }
 
-        std::memcpy(keys + freeSpaceStart, (char *)key + keyStart, keySize);
-        std::memcpy(keys + freeSpaceStart + keySize, &rid.pageNum, sizeof(rid.pageNum));
-        std::memcpy(keys + freeSpaceStart + keySize + sizeof(rid.pageNum), &rid.slotNum, sizeof(rid.slotNum));
+    void Node::putKey(const Attribute &keyField, const void *key, const char *postings, int postingsLength) {
+        int keyLength;
+        const char *keyBytes = CompareUtils::rawValue(keyField.type, key, keyLength);
+        int index = findKey(keyField, key);
+        if (-1 != index) {
+            // The entry is written anew in the same slot
+            deleteKey(keyField, index);
+            freeSpace += sizeof(Slot);
+        } else {
+            int shared = sharedPrefix(keyBytes, keyLength);
+            if (shared < prefixLength)
+                shortenPrefix(shared);
+            index = directory.empty() ? 0 : findKey(keyField, key, true);
+            directory.insert(directory.begin() + index, { -1, -1 });
+        }
 
-        int index = directory.empty() ? 0 : findKey(keyField, key, rid, true, true);
-        directory.insert(directory.begin() + index, { static_cast<short>(freeSpaceStart), static_cast<short>(dataSpace) });
-        freeSpace = freeSpace - dataSpace - sizeof(Slot);
+        int freeSpaceStart = getFreeSpaceStart() + static_cast<int>(sizeof(Slot));     // the slot is not paid for yet
+        char *entry = keys + freeSpaceStart;
+        if (TypeVarChar == keyField.type) {
+            unsigned short storedLength = keyLength - prefixLength;
+            std::memcpy(entry, &storedLength, sizeof(storedLength));
+            entry += sizeof(storedLength);
+        }
+        std::memcpy(entry, keyBytes + prefixLength, keyLength - prefixLength);
+        entry += keyLength - prefixLength;
+        std::memcpy(entry, postings, postingsLength);
+        int length = entry + postingsLength - (keys + freeSpaceStart);
+        directory[index] = { static_cast<short>(freeSpaceStart), static_cast<short>(length) };
+        freeSpace -= length + sizeof(Slot);
     }
 
     void Node::deleteKey(const Attribute &keyField, int index) {
@@ -272,18 +341,24 @@ namespace PeterDB{
         directory.at(index).length = -1;
     }
 
-    void Node::getKeyData(const Attribute &keyField, int index, char *key, RID &rid) {
-        Slot keySlot = directory.at(index);
-        int keySize =  getKeySize(index, keyField);
+    void Node::getKey(const Attribute &keyField, int index, char *key) const {
+        int keySize;
+        const char *storedBytes = storedKey(keyField.type, index, keySize);
         int copiedLength = 0;
         if (TypeVarChar == keyField.type) {
-            std::memcpy(key, &keySize, sizeof(keySize));
-            copiedLength += sizeof(keySize);
+            int fullSize = prefixLength + keySize;
+            std::memcpy(key, &fullSize, sizeof(fullSize));
+            copiedLength += sizeof(fullSize);
         }
 
-        std::memcpy(key + copiedLength, keys + keySlot.offset, keySize);
-        std::memcpy(&rid.pageNum, keys + keySlot.offset + keySize, sizeof(rid.pageNum));
-        std::memcpy(&rid.slotNum, keys + keySlot.offset + keySize + sizeof(rid.pageNum), sizeof(rid.slotNum));
+        std::memcpy(key + copiedLength, keys, prefixLength);
+        std::memcpy(key + copiedLength + prefixLength, storedBytes, keySize);
+    }
+
+    int Node::getPostings(const Attribute &keyField, int index, const char *&postings) const {
+        int keySize;
+        postings = storedKey(keyField.type, index, keySize) + keySize;
+        return static_cast<int>(keys + directory[index].offset + directory[index].length - postings);
     }
 
     void Node::insertChild(const Attribute &keyField, int index, void *key, int keyLength, int childPageId) {
@@ -304,12 +379,13 @@ namespace PeterDB{
     }
 
     void Node::cleanDirectory() {
-        for (int i = 0; i < directory.size(); ++i) {
-            Slot current = directory.at(i);
-            if (current.offset == -1) {
-                directory.erase(directory.begin() + i);
-                freeSpace += sizeof(Slot);
+        for (int i = 0; i < directory.size(); ) {
+            if (directory.at(i).offset != -1) {
+                ++i;
+                continue;
             }
+            directory.erase(directory.begin() + i);
+            freeSpace += sizeof(Slot);
         }
     }
 
@@ -375,51 +451,169 @@ namespace PeterDB{
         splitNode.populateBytes(newNode);
     }
 
-    std::string Node::toJsonKeys(const Attribute &keyField) {
+    void Node::splitLeaf(const Attribute &keyField, const void *key, const char *postings, int postingsLength,
+                         char *newNode, InsertionChild *child) {
+        // Every live entry in full, the one for key in its place
+        int keyLength;
+        const char *keyBytes = CompareUtils::rawValue(keyField.type, key, keyLength);
+        int existing = findKey(keyField, key);
+        int insertAt = -1 != existing ? existing : directory.empty() ? 0 : findKey(keyField, key, true);
+        vector<char> entries;
+        vector<int> lengths, offsets(1, 0);
+        auto appendEntry = [&](const char *head, int headLength, const char *tail, int tailLength,
+                               const char *entryPostings, int entryPostingsLength) {
+            if (TypeVarChar == keyField.type) {
+                unsigned short fullLength = headLength + tailLength;
+                entries.insert(entries.end(), (char *) &fullLength, (char *) &fullLength + sizeof(fullLength));
+            }
+            entries.insert(entries.end(), head, head + headLength);
+            entries.insert(entries.end(), tail, tail + tailLength);
+            entries.insert(entries.end(), entryPostings, entryPostings + entryPostingsLength);
+            lengths.push_back(entries.size() - offsets.back());
+            offsets.push_back(entries.size());
+        };
+        for (int i = 0; i <= directory.size(); ++i) {
+            if (i == insertAt)
+                appendEntry(keyBytes, keyLength, keyBytes, 0, postings, postingsLength);
+            if (i == directory.size() || directory[i].offset == -1 || i == existing)
+                continue;
+            int storedLength;
+            const char *stored = storedKey(keyField.type, i, storedLength);
+            const char *entryPostings;
+            int entryPostingsLength = getPostings(keyField, i, entryPostings);
+            appendEntry(keys, prefixLength, stored, storedLength, entryPostings, entryPostingsLength);
+        }
+
+        // Split about halfway through the bytes, or at the nearest point both halves fit. A key cutting a long
+        // prefix short lands at either end, it can always go alone.
+        int count = lengths.size();
+        int emptySpace = Node(NODE_TYPE_LEAF).freeSpace;
+        auto fits = [&](int from, int to) {
+            return packedSize(keyField, entries.data() + offsets[from], entries.data() + offsets[to - 1],
+                              offsets[to] - offsets[from], to - from) < emptySpace;
+        };
+        int middle = 1;
+        while (middle < count - 1 && offsets[middle] * 2 < offsets[count])
+            middle++;
+        int splitAt = middle;
+        for (int distance = 0; distance < count; ++distance) {
+            if (middle - distance >= 1 && fits(0, middle - distance) && fits(middle - distance, count)) {
+                splitAt = middle - distance;
+                break;
+            }
+            if (middle + distance < count && fits(0, middle + distance) && fits(middle + distance, count)) {
+                splitAt = middle + distance;
+                break;
+            }
+        }
+
+        Node splitNode(NODE_TYPE_LEAF);
+        splitNode.packEntries(keyField, entries.data() + offsets[splitAt],
+                              vector<int>(lengths.begin() + splitAt, lengths.end()));
+        splitNode.nextPage = this->nextPage;
+        splitNode.populateBytes(newNode);
+        packEntries(keyField, entries.data(), vector<int>(lengths.begin(), lengths.begin() + splitAt));
+
+        // Inner nodes keep whole keys, printBTree shows them and they bound the fanout like before
+        const char *separator = entryKey(keyField, entries.data() + offsets[splitAt], child->keyLength);
+        std::memcpy(child->leastChildValue, separator, child->keyLength);
+    }
+
+    const char *Node::entryKey(const Attribute &keyField, const char *entry, int &keyLength) {
+        if (TypeVarChar != keyField.type) {
+            keyLength = sizeof(int);
+            return entry;
+        }
+        unsigned short fullLength;
+        std::memcpy(&fullLength, entry, sizeof(fullLength));
+        keyLength = fullLength;
+        return entry + sizeof(fullLength);
+    }
+
+    void Node::packEntries(const Attribute &keyField, const char *entries, const vector<int> &lengths) {
+        int keptNextPage = nextPage;
+        reset(type);
+        nextPage = keptNextPage;
+        if (lengths.empty())
+            return;
+
+        int lastOffset = 0;
+        for (int i = 0; i + 1 < lengths.size(); ++i)
+            lastOffset += lengths[i];
+        // Entries are in key order, what the first and last share all of them do
+        int firstLength, lastLength;
+        const char *firstKey = entryKey(keyField, entries, firstLength);
+        const char *lastKey = entryKey(keyField, entries + lastOffset, lastLength);
+        if (TypeVarChar == keyField.type)
+            prefixLength = static_cast<short>(commonLength(firstKey, firstLength, lastKey, lastLength));
+        std::memcpy(keys, firstKey, prefixLength);
+        int offset = prefixLength;
+        for (int length : lengths) {
+            int storedLength = length - prefixLength;
+            if (TypeVarChar == keyField.type) {
+                unsigned short fullLength;
+                std::memcpy(&fullLength, entries, sizeof(fullLength));
+                unsigned short suffixLength = fullLength - prefixLength;
+                std::memcpy(keys + offset, &suffixLength, sizeof(suffixLength));
+                std::memcpy(keys + offset + sizeof(suffixLength), entries + sizeof(fullLength) + prefixLength,
+                            length - sizeof(fullLength) - prefixLength);
+            } else {
+                std::memcpy(keys + offset, entries, length);
+            }
+            directory.push_back({ static_cast<short>(offset), static_cast<short>(storedLength) });
+            offset += storedLength;
+            entries += length;
+        }
+        freeSpace -= offset + sizeof(Slot) * directory.size();
+    }
+
+    int Node::packedSize(const Attribute &keyField, const char *first, const char *last, int entryBytes, int count) {
+        int prefix = 0;
+        if (TypeVarChar == keyField.type) {
+            int firstLength, lastLength;
+            const char *firstKey = entryKey(keyField, first, firstLength);
+            const char *lastKey = entryKey(keyField, last, lastLength);
+            prefix = commonLength(firstKey, firstLength, lastKey, lastLength);
+        }
+        return entryBytes - (count - 1) * prefix + count * static_cast<int>(sizeof(Slot));
+    }
+
+    std::string Node::toJsonKeys(const Attribute &keyField, IXFileHandle &ixFileHandle) {
         return NODE_TYPE_INTERMEDIATE == type
             ? toJsonKeysIntermediate(keyField)
-            : toJsonKeysLeaf(keyField);
+            : toJsonKeysLeaf(keyField, ixFileHandle);
     }
 
-    std::string Node::toJsonKeysLeaf(const Attribute &keyField) {
+    std::string Node::toJsonKeysLeaf(const Attribute &keyField, IXFileHandle &ixFileHandle) {
         string keysJson = "\"keys\": [";
-        std::string previousKey;
-        bool processedKeys = false;
-        int currentKeyCount = 0;
+        bool first = true;
+        vector<RID> rids;
 
         for(int i = 0; i < directory.size(); ++i) {
-            Slot current = directory.at(i);
-            if (-1 == current.offset)
+            if (-1 == directory.at(i).offset)
                 continue;
 
-            int keySize = getKeySize(i, keyField);
-            char *key = (char *) malloc(keySize);
-            std::memcpy(key, keys + current.offset, keySize);
-
-            std::string currentKey = ParseUtils::parse(keyField.type, key, keySize);
+            int keySize;
+            const char *storedBytes = storedKey(keyField.type, i, keySize);
+            char *key = (char *) malloc(prefixLength + keySize);
+            std::memcpy(key, keys, prefixLength);
+            std::memcpy(key + prefixLength, storedBytes, keySize);
+            std::string currentKey = ParseUtils::parse(keyField.type, key, prefixLength + keySize);
             free(key);
-            if ((!processedKeys && currentKey.empty()) || currentKey != previousKey) {
-                currentKeyCount = 0;
-                std::string prefix = !processedKeys ? "\"" : "]\",\"";
-                std::string suffix = ":[";
-                keysJson.append(prefix.append(currentKey + suffix));
-                processedKeys = true;
-            }
-
-            unsigned pageNum;
-            unsigned short slotNum;
-            std::memcpy(&pageNum, keys + current.offset + keySize, sizeof(pageNum));
-            std::memcpy(&slotNum, keys + current.offset + keySize + sizeof(pageNum), sizeof(slotNum));
-
-            std::string comma = currentKeyCount > 0 ? "," : "";
-            keysJson.append(comma + "(" + to_string(pageNum) + "," + to_string(slotNum) + ")");
-            ++currentKeyCount;
+            keysJson.append((first ? "\"" : "\",\"") + currentKey + ":[");
+            first = false;
 
-            if (previousKey != currentKey)
-                previousKey = currentKey;
+            const char *postings;
+            getPostings(keyField, i, postings);
+            PostingList::read(ixFileHandle, postings, rids);
+            for (int j = 0; j < rids.size(); ++j) {
+                std::string comma = j > 0 ? "," : "";
+                keysJson.append(comma + "(" + to_string(rids[j].pageNum) + "," + to_string(rids[j].slotNum) + ")");
+            }
+            keysJson.append("]");
         }
-        if (processedKeys)
-            keysJson.append("]\""); // closing last key's RID list
+        if (!first)
+            keysJson.append("\""); // closing last key quote
         keysJson.append("]"); // closing keys array
         return keysJson;
     }
@@ -432,10 +626,10 @@ namespace PeterDB{
             if (-1 == directory.at(i).offset)
                 continue;
 
-            Slot current = directory.at(i);
-            int keySize = getKeySize(i, keyField);
+            int keySize;
+            const char *storedBytes = storedKey(keyField.type, i, keySize);
             char *key = (char *) malloc(keySize);
-            std::memcpy(key, keys + current.offset, keySize);
+            std::memcpy(key, storedBytes, keySize);
             std::string currentKey = ParseUtils::parse(keyField.type, key, keySize);
             free(key);
             std::string prefix = first ? "\"" : "\",\"";
@@ -468,37 +662,13 @@ namespace PeterDB{
         return childPages;
     }
 
-    int Node::getKeySize(int index, const Attribute &keyField) const {
-        if (TypeVarChar != keyField.type)
-            return 4;
-
-        Slot keySlot = directory.at(index);
-        int keySize = keySlot.length - static_cast<int>(sizeof(unsigned)) - static_cast<int>(sizeof(unsigned short));
-        if (NODE_TYPE_INTERMEDIATE == type)
-            keySize -= sizeof(int);
-        return keySize;
-    }
-
     int Node::getKeyCount() const {
         return directory.size();
     }
 
     int Node::getFreeSpaceStart() {
-        return PAGE_SIZE - freeSpace - sizeof(Slot) * directory.size()
-               - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
-    }
-
-    void Node::populateFormattedKey(AttrType attrType, char *key, RID &rid, int index) {
-        Slot slot = directory.at(index);
-        int keyLength = slot.length - sizeof(RID::pageNum) - sizeof(RID::slotNum) - sizeof(int);
-        int copiedOffset = 0;
-        if (TypeVarChar == attrType) {
-            std::memcpy(key, &keyLength, sizeof(keyLength));
-            copiedOffset += sizeof(keyLength);
-        }
-        std::memcpy(key + copiedOffset, keys + slot.offset, keyLength);
-        std::memcpy(&rid.pageNum, keys + slot.offset + keyLength, sizeof(rid.pageNum));
-        std::memcpy(&rid.slotNum, keys + slot.offset + keyLength + sizeof(rid.pageNum), sizeof(rid.slotNum));
+        return PAGE_DATA_SIZE - freeSpace - sizeof(Slot) * directory.size()
+               - sizeof(prefixLength) - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
     }
 
     Node::~Node() {
@@ -506,7 +676,24 @@ namespace PeterDB{
             free(keys);
     }
 
-    bool Node::validateIndex(int index) {
+    bool Node::validateIndex(int index) const {
         return index < directory.size() && directory.at(index).offset != -1;
     }
+
+    void Node::reset(char nodeType) {
+        if (nullptr == keys)
+            keys = (char *) malloc(PAGE_SIZE);
+        type = nodeType;
+        freeSpace = PAGE_DATA_SIZE - sizeof(prefixLength) - sizeof(int) - sizeof(nextPage) - sizeof(freeSpace) - sizeof(type);
+        nextPage = -1;
+        prefixLength = 0;
+        directory.clear();
+    }
+
+    void Node::appendEntry(const char *entry, int length) {
+        int freeSpaceStart = getFreeSpaceStart();
+        std::memcpy(keys + freeSpaceStart, entry, length);
+        directory.push_back({ static_cast<short>(freeSpaceStart), static_cast<short>(length) });
+        freeSpace -= length + sizeof(Slot);
+    }
 }
\ No newline at end of file
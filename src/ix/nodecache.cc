@@ -0,0 +1,103 @@
+#include "src/include/ix.h"
+#include <thread>
+
+namespace PeterDB {
+    NodeCache::NodeCache(unsigned pageCount) : pageCount(pageCount) {
+        writes = 0;
+        rootPageId = -1;
+        for (std::atomic<unsigned long> &version : versions)
+            version = 0;
+    }
+
+    std::shared_ptr<const Node> NodeCache::getNode(IXFileHandle &ixFileHandle, PageNum pageNum) {
+        unsigned long writesBefore;
+        {
+            std::lock_guard<std::mutex> guard(latch);
+            auto cached = nodes.find(pageNum);
+            if (cached != nodes.end()) {
+                if (NODE_TYPE_LEAF == cached->second.node->type)
+                    leaves.splice(leaves.end(), leaves, cached->second.recentUse);
+                // Still a page read as far as the handle's counters go, served without touching the buffer pool
+                ixFileHandle.ixReadPageCounter++;
+                ixFileHandle.ixCacheHitCounter++;
+                return cached->second.node;
+            }
+            writesBefore = writes;
+        }
+
+        char bytes[PAGE_SIZE];
+        if (ixFileHandle.readPage(pageNum, bytes) == -1)
+            return nullptr;
+        std::shared_ptr<const Node> node = std::make_shared<Node>(bytes);
+
+        std::lock_guard<std::mutex> guard(latch);
+        if (writes != writesBefore || nodes.count(pageNum) > 0)
+            return node;    // The page may have changed while it was decoded, or another reader cached it first
+        CachedNode &entry = nodes[pageNum];
+        entry.node = node;
+        if (NODE_TYPE_LEAF == node->type) {
+            entry.recentUse = leaves.insert(leaves.end(), pageNum);
+            if (leaves.size() > NODE_CACHE_LEAVES) {
+                nodes.erase(leaves.front());
+                leaves.pop_front();
+            }
+        }
+        return node;
+    }
+
+    bool NodeCache::getRootPageId(int &rootPage) {
+        std::lock_guard<std::mutex> guard(latch);
+        rootPage = rootPageId;
+        return rootPageId != -1;
+    }
+
+    void NodeCache::setRootPageId(int rootPage) {
+        std::lock_guard<std::mutex> guard(latch);
+        rootPageId = rootPage;
+    }
+
+    void NodeCache::pageWritten(PageNum pageNum) {
+        std::lock_guard<std::mutex> guard(latch);
+        writes++;
+        if (IX_HIDDEN_PAGE_COUNT == pageNum)
+            rootPageId = -1;    // The root pointer page
+        auto cached = nodes.find(pageNum);
+        if (cached == nodes.end())
+            return;
+        if (NODE_TYPE_LEAF == cached->second.node->type)
+            leaves.erase(cached->second.recentUse);
+        nodes.erase(cached);
+    }
+
+    unsigned long NodeCache::readLatch(PageNum pageNum) {
+        std::atomic<unsigned long> &version = versions[pageNum % NODE_LATCH_STRIPES];
+        unsigned long seen = version.load(std::memory_order_acquire);
+        while (seen & 1) {
+            std::this_thread::yield();  // Writers hold a latch for a page write or a split, not worth sleeping on
+            seen = version.load(std::memory_order_acquire);
+        }
+        return seen;
+    }
+
+    bool NodeCache::validate(PageNum pageNum, unsigned long version) {
+        std::atomic_thread_fence(std::memory_order_acquire);
+        return versions[pageNum % NODE_LATCH_STRIPES].load(std::memory_order_relaxed) == version;
+    }
+
+    bool NodeCache::upgradeLatch(PageNum pageNum, unsigned long version) {
+        return versions[pageNum % NODE_LATCH_STRIPES].compare_exchange_strong(version, version + 1,
+                                                                              std::memory_order_acquire);
+    }
+
+    void NodeCache::writeLatch(PageNum pageNum) {
+        while (!upgradeLatch(pageNum, readLatch(pageNum)));
+    }
+
+    void NodeCache::writeUnlatch(PageNum pageNum) {
+        versions[pageNum % NODE_LATCH_STRIPES].fetch_add(1, std::memory_order_release);
+    }
+
+    bool NodeCache::sharesLatch(PageNum pageNum, PageNum otherPage) {
+        return pageNum % NODE_LATCH_STRIPES == otherPage % NODE_LATCH_STRIPES;
+    }
+}
@@ -0,0 +1,350 @@
+#include "src/include/ix.h"
+#include <algorithm>
+
+namespace PeterDB {
+    namespace {
+        const unsigned short OVERFLOW_MARK = 0xFFFF;    // in place of the count when the RIDs are on posting pages
+        // Next page, the count, the greatest RID so that walks decode only the page they stop at, then the bytes of
+        // RIDs so that a greater one is appended without decoding any
+        const int POSTING_PAGE_HEADER = sizeof(int) + sizeof(unsigned short) + sizeof(unsigned) + sizeof(unsigned short)
+                                        + sizeof(unsigned short);
+
+        void putVarint(unsigned value, vector<char> &codes) {
+            while (value >= 0x80) {
+                codes.push_back(static_cast<char>(value | 0x80));
+                value >>= 7;
+            }
+            codes.push_back(static_cast<char>(value));
+        }
+
+        unsigned getVarint(const char *&codes) {
+            unsigned value = 0;
+            for (int shift = 0; ; shift += 7) {
+                unsigned char byte = static_cast<unsigned char>(*codes++);
+                value |= (unsigned) (byte & 0x7F) << shift;
+                if (byte < 0x80)
+                    return value;
+            }
+        }
+
+        int varintSize(unsigned value) {
+            int size = 1;
+            while (value >= 0x80) {
+                value >>= 7;
+                size++;
+            }
+            return size;
+        }
+    }
+
+    void PostingList::encode(const vector<RID> &rids, vector<char> &postings) {
+        unsigned short count = rids.size();
+        postings.assign((char *) &count, (char *) &count + sizeof(count));
+        encodeRids(rids.data(), rids.size(), postings);
+    }
+
+    int PostingList::overflowPage(const char *postings) {
+        unsigned short count;
+        std::memcpy(&count, postings, sizeof(count));
+        if (OVERFLOW_MARK != count)
+            return -1;
+        int firstPage;
+        std::memcpy(&firstPage, postings + sizeof(count), sizeof(firstPage));
+        return firstPage;
+    }
+
+    void PostingList::encodeOverflow(int firstPage, vector<char> &postings) {
+        postings.assign((const char *) &OVERFLOW_MARK, (const char *) &OVERFLOW_MARK + sizeof(OVERFLOW_MARK));
+        postings.insert(postings.end(), (char *) &firstPage, (char *) &firstPage + sizeof(firstPage));
+    }
+
+    RC PostingList::read(IXFileHandle &ixFileHandle, const char *postings, vector<RID> &rids) {
+        rids.clear();
+        int page = overflowPage(postings);
+        if (-1 == page) {
+            unsigned short count;
+            std::memcpy(&count, postings, sizeof(count));
+            decodeRids(postings + sizeof(count), count, rids);
+            return 0;
+        }
+        char bytes[PAGE_SIZE];
+        PageHeader header;
+        while (-1 != page) {
+            if (readPage(ixFileHandle, page, bytes, header) == -1)
+                return -1;
+            decodeRids(bytes + POSTING_PAGE_HEADER, header.count, rids);
+            page = header.nextPage;
+        }
+        return 0;
+    }
+
+    RC PostingList::add(IXFileHandle &ixFileHandle, const char *postings, int length, const RID &rid, bool mayAppend,
+                        vector<char> &updated) {
+        vector<RID> rids;
+        int page = overflowPage(postings);
+        if (-1 == page) {
+            unsigned short count;
+            std::memcpy(&count, postings, sizeof(count));
+            decodeRids(postings + sizeof(count), count, rids);
+            rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, less), rid);
+            encode(rids, updated);
+            if (updated.size() - sizeof(count) <= POSTING_INLINE_LIMIT)
+                return 0;
+            if (!mayAppend)
+                return 1;
+
+            // Too long for the leaf, the RIDs move to posting pages
+            vector<vector<char>> pages;
+            int firstPage = ixFileHandle.getPageCount();
+            paginate(rids, firstPage, pages);
+            for (const vector<char> &bytes : pages)
+                if (ixFileHandle.appendPage(bytes.data()) == -1)
+                    return -1;
+            encodeOverflow(firstPage, updated);
+            return 0;
+        }
+
+        // The RID goes in the first page ending at or above it, or the last one
+        char pageData[PAGE_SIZE];
+        PageHeader header;
+        while (true) {
+            if (readPage(ixFileHandle, page, pageData, header) == -1)
+                return -1;
+            if (-1 == header.nextPage || (header.count > 0 && !less(header.last, rid)))
+                break;
+            page = header.nextPage;
+        }
+        updated.assign(postings, postings + length);
+        if (putRid(pageData, header, rid)) {
+            writeHeader(header, pageData);
+            return ixFileHandle.writePage(page, pageData);
+        }
+        if (!mayAppend)
+            return 1;
+
+        // Full, its upper half moves to a new page linked in after it
+        decodeRids(pageData + POSTING_PAGE_HEADER, header.count, rids);
+        rids.insert(std::upper_bound(rids.begin(), rids.end(), rid, less), rid);
+        int nextPage = header.nextPage;
+        vector<char> bytes;
+        int half = rids.size() / 2;
+        int newPage = ixFileHandle.getPageCount();
+        pageBytes(nextPage, rids.data() + half, rids.size() - half, bytes);
+        if (ixFileHandle.appendPage(bytes.data()) == -1)
+            return -1;
+        pageBytes(newPage, rids.data(), half, bytes);
+        return ixFileHandle.writePage(page, bytes.data());
+    }
+
+    RC PostingList::remove(IXFileHandle &ixFileHandle, const char *postings, int length, const RID &rid,
+                           vector<char> &updated) {
+        vector<RID> rids;
+        int page = overflowPage(postings);
+        if (-1 == page) {
+            unsigned short count;
+            std::memcpy(&count, postings, sizeof(count));
+            decodeRids(postings + sizeof(count), count, rids);
+            auto found = std::lower_bound(rids.begin(), rids.end(), rid, less);
+            if (found == rids.end() || less(rid, *found))
+                return -1;
+            rids.erase(found);
+            rids.empty() ? updated.clear() : encode(rids, updated);
+            return 0;
+        }
+
+        // Only the first page ending at or above rid can hold it
+        char pageData[PAGE_SIZE];
+        int firstPage = page;
+        PageHeader header;
+        while (true) {
+            if (readPage(ixFileHandle, page, pageData, header) == -1)
+                return -1;
+            if (header.count > 0 && !less(header.last, rid))
+                break;
+            if (-1 == header.nextPage)
+                return -1;
+            page = header.nextPage;
+        }
+        if (!cutRid(pageData, header, rid))
+            return -1;
+        writeHeader(header, pageData);
+        if (ixFileHandle.writePage(page, pageData) == -1)
+            return -1;
+        updated.assign(postings, postings + length);
+        if (page != firstPage || header.count > 0)
+            return 0;
+
+        // The first page is empty, the list starts at the next page with RIDs. Emptied pages stay unused.
+        int nextPage = header.nextPage;
+        while (-1 != nextPage) {
+            if (readPage(ixFileHandle, nextPage, pageData, header) == -1)
+                return -1;
+            if (header.count > 0) {
+                encodeOverflow(nextPage, updated);
+                return 0;
+            }
+            nextPage = header.nextPage;
+        }
+        updated.clear();
+        return 0;
+    }
+
+    void PostingList::paginate(const vector<RID> &rids, int firstPage, vector<vector<char>> &pages) {
+        int start = 0, page = firstPage;
+        while (start < rids.size()) {
+            int end = start, size = 0;
+            unsigned previous = 0;
+            while (end < rids.size()) {
+                int ridSize = varintSize(rids[end].pageNum - previous) + varintSize(rids[end].slotNum);
+                if (size + ridSize > PAGE_DATA_SIZE - POSTING_PAGE_HEADER)
+                    break;
+                size += ridSize;
+                previous = rids[end].pageNum;
+                end++;
+            }
+            pages.emplace_back();
+            pageBytes(end == rids.size() ? -1 : page + 1, rids.data() + start, end - start, pages.back());
+            start = end;
+            page++;
+        }
+    }
+
+    bool PostingList::putRid(char *bytes, PageHeader &header, const RID &rid) {
+        // After the last RID, as RIDs of new records mostly are, or walk the codes to the first RID above it, which
+        // then takes its page delta from rid
+        char *codes = bytes + POSTING_PAGE_HEADER;
+        const char *code = codes + header.codesLength, *followingEnd = code;
+        RID previous = 0 == header.count ? RID{} : header.last;
+        RID following{};
+        bool last = 0 == header.count || !less(rid, header.last);
+        if (!last) {
+            code = codes;
+            previous = RID{};
+            while (true) {
+                const char *start = code;
+                following.pageNum = previous.pageNum + getVarint(code);
+                following.slotNum = static_cast<unsigned short>(getVarint(code));
+                if (less(rid, following)) {
+                    followingEnd = code;
+                    code = start;
+                    break;
+                }
+                previous = following;
+            }
+        }
+
+        vector<char> replacement;
+        putVarint(rid.pageNum - previous.pageNum, replacement);
+        putVarint(rid.slotNum, replacement);
+        if (!last) {
+            putVarint(following.pageNum - rid.pageNum, replacement);
+            putVarint(following.slotNum, replacement);
+        }
+        int start = code - codes, end = followingEnd - codes;
+        int grown = static_cast<int>(replacement.size()) - (end - start);
+        if (header.codesLength + grown > PAGE_DATA_SIZE - POSTING_PAGE_HEADER)
+            return false;
+        std::memmove(codes + start + replacement.size(), codes + end, header.codesLength - end);
+        std::memcpy(codes + start, replacement.data(), replacement.size());
+        header.codesLength += grown;
+        header.count++;
+        if (last)
+            header.last = rid;
+        return true;
+    }
+
+    bool PostingList::cutRid(char *bytes, PageHeader &header, const RID &rid) {
+        // Walk the codes to rid, the RID after it takes over its page delta
+        char *codes = bytes + POSTING_PAGE_HEADER;
+        const char *code = codes;
+        RID previous{};
+        for (int i = 0; i < header.count; i++) {
+            char *start = const_cast<char *>(code);
+            RID current;
+            current.pageNum = previous.pageNum + getVarint(code);
+            current.slotNum = static_cast<unsigned short>(getVarint(code));
+            if (less(rid, current))
+                return false;
+            if (less(current, rid)) {
+                previous = current;
+                continue;
+            }
+
+            vector<char> replacement;
+            if (i + 1 < header.count) {
+                RID following;
+                following.pageNum = current.pageNum + getVarint(code);
+                following.slotNum = static_cast<unsigned short>(getVarint(code));
+                putVarint(following.pageNum - previous.pageNum, replacement);
+                putVarint(following.slotNum, replacement);
+            } else {
+                header.last = previous;
+            }
+            int end = code - codes;
+            std::memcpy(start, replacement.data(), replacement.size());
+            std::memmove(start + replacement.size(), codes + end, header.codesLength - end);
+            header.codesLength -= end - (start - codes) - replacement.size();
+            header.count--;
+            return true;
+        }
+        return false;
+    }
+
+    void PostingList::encodeRids(const RID *rids, int count, vector<char> &codes) {
+        unsigned previous = 0;
+        for (int i = 0; i < count; i++) {
+            putVarint(rids[i].pageNum - previous, codes);
+            putVarint(rids[i].slotNum, codes);
+            previous = rids[i].pageNum;
+        }
+    }
+
+    void PostingList::decodeRids(const char *codes, int count, vector<RID> &rids) {
+        rids.reserve(rids.size() + count + 1);  // room for the one add puts in
+        unsigned previous = 0;
+        for (int i = 0; i < count; i++) {
+            RID rid;
+            rid.pageNum = previous + getVarint(codes);
+            rid.slotNum = static_cast<unsigned short>(getVarint(codes));
+            rids.push_back(rid);
+            previous = rid.pageNum;
+        }
+    }
+
+    void PostingList::pageBytes(int nextPage, const RID *rids, int count, vector<char> &bytes) {
+        vector<char> codes;
+        encodeRids(rids, count, codes);
+        bytes.assign(PAGE_SIZE, 0);
+        writeHeader({ nextPage, count, count > 0 ? rids[count - 1] : RID{}, static_cast<int>(codes.size()) },
+                    bytes.data());
+        std::memcpy(bytes.data() + POSTING_PAGE_HEADER, codes.data(), codes.size());
+    }
+
+    RC PostingList::readPage(IXFileHandle &ixFileHandle, int pageNum, char *bytes, PageHeader &header) {
+        if (ixFileHandle.readPage(pageNum, bytes) == -1)
+            return -1;
+        unsigned short count, codesLength;
+        const char *field = bytes;
+        std::memcpy(&header.nextPage, field, sizeof(header.nextPage));
+        std::memcpy(&count, field += sizeof(header.nextPage), sizeof(count));
+        std::memcpy(&header.last.pageNum, field += sizeof(count), sizeof(header.last.pageNum));
+        std::memcpy(&header.last.slotNum, field += sizeof(header.last.pageNum), sizeof(header.last.slotNum));
+        std::memcpy(&codesLength, field + sizeof(header.last.slotNum), sizeof(codesLength));
+        header.count = count;
+        header.codesLength = codesLength;
+        return 0;
+    }
+
+    void PostingList::writeHeader(const PageHeader &header, char *bytes) {
+        unsigned short count = header.count, codesLength = header.codesLength;
+        std::memcpy(bytes, &header.nextPage, sizeof(header.nextPage));
+        std::memcpy(bytes += sizeof(header.nextPage), &count, sizeof(count));
+        std::memcpy(bytes += sizeof(count), &header.last.pageNum, sizeof(header.last.pageNum));
+        std::memcpy(bytes += sizeof(header.last.pageNum), &header.last.slotNum, sizeof(header.last.slotNum));
+        std::memcpy(bytes + sizeof(header.last.slotNum), &codesLength, sizeof(codesLength));
+    }
+
+    bool PostingList::less(const RID &lhs, const RID &rhs) {
+        return lhs.pageNum < rhs.pageNum || (lhs.pageNum == rhs.pageNum && lhs.slotNum < rhs.slotNum);
+    }
+}
@@ -0,0 +1,136 @@
+#include "src/include/pfm.h"
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+
+using namespace std;
+
+namespace PeterDB {
+    PageBatch::PageBatch() {
+        pending = 0;
+        status = 0;
+    }
+
+    void PageBatch::expect(unsigned pageCount) {
+        lock_guard<mutex> guard(latch);
+        pending += pageCount;
+    }
+
+    void PageBatch::complete(RC rc) {
+        lock_guard<mutex> guard(latch);
+        if (rc == -1)
+            status = -1;
+        if (--pending == 0)
+            finished.notify_all();
+    }
+
+    bool PageBatch::done() {
+        lock_guard<mutex> guard(latch);
+        return pending == 0;
+    }
+
+    RC PageBatch::wait() {
+        unique_lock<mutex> guard(latch);
+        finished.wait(guard, [this] { return pending == 0; });
+        return status;
+    }
+
+    AsyncPageIO &AsyncPageIO::instance() {
+        static AsyncPageIO _async_io;
+        return _async_io;
+    }
+
+    AsyncPageIO::AsyncPageIO() {
+        stopping = false;
+        for (unsigned i = 0; i < ASYNC_IO_THREADS; ++i)
+            workers.emplace_back(&AsyncPageIO::work, this);
+    }
+
+    AsyncPageIO::~AsyncPageIO() {
+        {
+            lock_guard<mutex> guard(latch);
+            stopping = true;
+        }
+        available.notify_all();
+        for (thread &worker : workers)
+            worker.join();
+        for (auto &entry : descriptors)
+            close(entry.second.first);
+    }
+
+    RC AsyncPageIO::submitRead(const std::string &fileName, PageNum pageNum, void *data, PageBatch &batch) {
+        {
+            lock_guard<mutex> guard(latch);
+            auto descriptor = descriptors.find(fileName);
+            if (descriptor == descriptors.end()) {
+                bool direct = true;
+                int fd = -1;
+#ifdef O_DIRECT
+                fd = open(fileName.c_str(), O_RDONLY | O_DIRECT);
+#endif
+                if (fd == -1) {
+                    // tmpfs and friends refuse O_DIRECT, go through the page cache instead
+                    direct = false;
+                    fd = open(fileName.c_str(), O_RDONLY);
+                }
+                if (fd == -1)
+                    return -1;
+                descriptor = descriptors.emplace(fileName, make_pair(fd, direct)).first;
+            }
+            batch.expect(1);
+            queue.push_back({ fileName, descriptor->second.first, descriptor->second.second, pageNum,
+                              static_cast<char *>(data), &batch });
+        }
+        available.notify_one();
+        return 0;
+    }
+
+    void AsyncPageIO::discardFile(const std::string &fileName) {
+        lock_guard<mutex> guard(latch);
+        auto descriptor = descriptors.find(fileName);
+        if (descriptor == descriptors.end())
+            return;
+        close(descriptor->second.first);
+        descriptors.erase(descriptor);
+    }
+
+    void AsyncPageIO::work() {
+        while (true) {
+            Request request;
+            {
+                unique_lock<mutex> guard(latch);
+                available.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty())
+                    return;
+                request = queue.front();
+                queue.pop_front();
+            }
+            request.batch->complete(serve(request));
+        }
+    }
+
+    RC AsyncPageIO::serve(const Request &request) {
+        // O_DIRECT needs an aligned buffer, callers hand in whatever they have so bounce through one
+        char *buffer = request.data;
+        if (request.direct && reinterpret_cast<uintptr_t>(request.data) % PAGE_SIZE != 0) {
+            void *aligned = nullptr;
+            if (posix_memalign(&aligned, PAGE_SIZE, PAGE_SIZE) != 0)
+                return -1;
+            buffer = static_cast<char *>(aligned);
+        }
+        auto started = chrono::steady_clock::now();
+        ssize_t bytesRead = pread(request.fd, buffer, PAGE_SIZE, (off_t) request.pageNum * PAGE_SIZE);
+        BufferPool::instance().recordRead(request.fileName, 1, chrono::steady_clock::now() - started);
+        if (bytesRead >= 0 && bytesRead < PAGE_SIZE)
+            memset(buffer + bytesRead, 0, PAGE_SIZE - bytesRead);   // Past the end of the file, an empty page
+        if (buffer != request.data) {
+            memcpy(request.data, buffer, PAGE_SIZE);
+            free(buffer);
+        }
+        if (bytesRead < 0)
+            return -1;
+        return BufferPool::instance().verifyPage(request.fileName, request.data) ? 0 : -1;
+    }
+}
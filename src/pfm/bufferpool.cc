@@ -0,0 +1,456 @@
+#include "src/include/pfm.h"
+#include <fcntl.h>
+#include <unistd.h>
+#include <cstring>
+#include <algorithm>
+
+using namespace std;
+
+namespace PeterDB {
+    Frame::Frame() {
+        pageNum = 0;
+        pinCount = 0;
+        dirty = false;
+        data = nullptr;
+    }
+
+    BufferPool &BufferPool::instance() {
+        static BufferPool _buffer_pool;
+        return _buffer_pool;
+    }
+
+    BufferPool::BufferPool() {
+        hitCounter = 0;
+        missCounter = 0;
+        writeBackCounter = 0;
+        prefetchCounter = 0;
+        checksumFailureCounter = 0;
+        checksumMode = CHECKSUM_ON_LOAD;
+        policy = nullptr;
+        configure(BUFFER_POOL_SIZE, LRU_POLICY);
+    }
+
+    BufferPool::~BufferPool() {
+        for (Frame &frame : frames) {
+            if (frame.dirty)
+                writePhysical(frame.fileName, frame.pageNum, frame.data);
+            free(frame.data);
+        }
+        delete policy;
+    }
+
+    RC BufferPool::configure(unsigned frameCount, ReplacementPolicyType policyType) {
+        if (frameCount == 0)
+            return -1;
+        lock_guard<recursive_mutex> guard(latch);
+        for (Frame &frame : frames) {
+            if (frame.pinCount > 0)
+                return -1; // Someone still holds a page, cannot rebuild under them
+        }
+        for (Frame &frame : frames) {
+            if (frame.dirty)
+                writePhysical(frame.fileName, frame.pageNum, frame.data);
+            free(frame.data);
+        }
+        delete policy;
+
+        frames = vector<Frame>(frameCount);
+        freeFrames.clear();
+        for (unsigned i = 0; i < frameCount; ++i) {
+            frames[i].data = (char *) malloc(PAGE_SIZE);
+            freeFrames.push_back(frameCount - 1 - i);
+        }
+        pageTable.clear();
+        policy = ReplacementPolicy::create(policyType, frameCount);
+        return 0;
+    }
+
+    char *BufferPool::pinPage(const std::string &fileName, PageNum pageNum, bool &hit) {
+        lock_guard<recursive_mutex> guard(latch);
+        int cached = lookup(fileName, pageNum);
+        if (cached != -1) {
+            Frame &frame = frames[cached];
+            if (checksumMode == CHECKSUM_ALWAYS && !frame.dirty && !verifyPage(fileName, frame.data))
+                return nullptr;
+            frame.pinCount++;
+            policy->recordAccess(cached);
+            policy->setEvictable(cached, false);
+            hitCounter++;
+            statistics[fileName].cacheHits++;
+            hit = true;
+            return frame.data;
+        }
+
+        unsigned frameId;
+        if (!allocateFrame(frameId))
+            return nullptr;
+        Frame &frame = frames[frameId];
+        if (readPhysical(fileName, pageNum, frame.data) == -1) {
+            freeFrames.push_back(frameId);
+            return nullptr;
+        }
+        frame.fileName = fileName;
+        frame.pageNum = pageNum;
+        frame.pinCount = 1;
+        frame.dirty = false;
+        pageTable[fileName][pageNum] = frameId;
+        policy->recordAccess(frameId);
+        policy->setEvictable(frameId, false);
+        missCounter++;
+        statistics[fileName].cacheMisses++;
+        hit = false;
+        return frame.data;
+    }
+
+    RC BufferPool::unpinPage(const std::string &fileName, PageNum pageNum, bool dirty) {
+        lock_guard<recursive_mutex> guard(latch);
+        int cached = lookup(fileName, pageNum);
+        if (cached == -1 || frames[cached].pinCount <= 0)
+            return -1;
+        Frame &frame = frames[cached];
+        frame.dirty = frame.dirty || dirty;
+        frame.pinCount--;
+        if (frame.pinCount == 0)
+            policy->setEvictable(cached, true);
+        return 0;
+    }
+
+    RC BufferPool::readPage(const std::string &fileName, PageNum pageNum, void *data, bool &hit) {
+        lock_guard<recursive_mutex> guard(latch);
+        unsigned failures = checksumFailureCounter;
+        char *page = pinPage(fileName, pageNum, hit);
+        if (nullptr == page) {
+            if (checksumFailureCounter != failures)
+                return -1;
+            // Every frame is pinned, serve the read straight from the file
+            hit = false;
+            return readPhysical(fileName, pageNum, data);
+        }
+        memcpy(data, page, PAGE_SIZE);
+        return unpinPage(fileName, pageNum, false);
+    }
+
+    RC BufferPool::writePage(const std::string &fileName, PageNum pageNum, const void *data, bool deferred) {
+        lock_guard<recursive_mutex> guard(latch);
+        if (!deferred && writePhysical(fileName, pageNum, data) == -1)
+            return -1;
+
+        int cached = lookup(fileName, pageNum);
+        if (cached != -1) {
+            memcpy(frames[cached].data, data, PAGE_SIZE);
+            if (!deferred && checksummed(fileName))
+                PageChecksum::stamp(frames[cached].data);                   // Match what went to disk
+            frames[cached].dirty = deferred;
+            policy->recordAccess(cached);
+            return deferred ? deferWrite(fileName) : 0;
+        }
+
+        // Keep a copy since pages that are written are usually read again soon
+        unsigned frameId;
+        if (!allocateFrame(frameId))
+            return deferred ? writePhysical(fileName, pageNum, data) : 0;   // Every frame is pinned, cannot defer
+        Frame &frame = frames[frameId];
+        memcpy(frame.data, data, PAGE_SIZE);
+        if (!deferred && checksummed(fileName))
+            PageChecksum::stamp(frame.data);
+        frame.fileName = fileName;
+        frame.pageNum = pageNum;
+        frame.pinCount = 0;
+        frame.dirty = deferred;
+        pageTable[fileName][pageNum] = frameId;
+        policy->recordAccess(frameId);
+        policy->setEvictable(frameId, true);
+        return deferred ? deferWrite(fileName) : 0;
+    }
+
+    unsigned BufferPool::prefetch(const std::string &fileName, PageNum pageNum, unsigned pageCount) {
+        lock_guard<recursive_mutex> guard(latch);
+        fstream *stream = getStream(fileName);
+        if (nullptr == stream)
+            return 0;
+        unsigned pagesRead = 0;
+        vector<char> run;
+        PageNum end = pageNum + pageCount;
+        for (PageNum start = pageNum; start < end;) {
+            if (lookup(fileName, start) != -1) {
+                start++;
+                continue;
+            }
+            // Read each run of pages missing from the pool with one call
+            PageNum runEnd = start + 1;
+            while (runEnd < end && lookup(fileName, runEnd) == -1)
+                runEnd++;
+            run.assign((size_t) (runEnd - start) * PAGE_SIZE, 0);
+            auto started = chrono::steady_clock::now();
+            stream->clear();
+            stream->seekg((long) start * PAGE_SIZE, ios::beg);
+            stream->read(run.data(), run.size());
+            stream->clear();
+            recordRead(fileName, runEnd - start, chrono::steady_clock::now() - started);
+            for (PageNum page = start; page < runEnd; ++page) {
+                if (!verifyPage(fileName, run.data() + (size_t) (page - start) * PAGE_SIZE))
+                    continue;   // Left for the demand read to report
+                unsigned frameId;
+                if (!allocateFrame(frameId))
+                    return pagesRead;
+                Frame &frame = frames[frameId];
+                memcpy(frame.data, run.data() + (size_t) (page - start) * PAGE_SIZE, PAGE_SIZE);
+                frame.fileName = fileName;
+                frame.pageNum = page;
+                frame.pinCount = 0;
+                frame.dirty = false;
+                pageTable[fileName][page] = frameId;
+                policy->recordAccess(frameId);
+                policy->setEvictable(frameId, true);
+                pagesRead++;
+            }
+            start = runEnd;
+        }
+        prefetchCounter += pagesRead;
+        return pagesRead;
+    }
+
+    bool BufferPool::readCached(const std::string &fileName, PageNum pageNum, void *data) {
+        lock_guard<recursive_mutex> guard(latch);
+        int cached = lookup(fileName, pageNum);
+        if (cached == -1)
+            return false;
+        if (checksumMode == CHECKSUM_ALWAYS && !frames[cached].dirty && !verifyPage(fileName, frames[cached].data))
+            return false;
+        memcpy(data, frames[cached].data, PAGE_SIZE);
+        policy->recordAccess(cached);
+        hitCounter++;
+        statistics[fileName].cacheHits++;
+        return true;
+    }
+
+    RC BufferPool::flushFile(const std::string &fileName, unsigned &pagesWritten) {
+        lock_guard<recursive_mutex> guard(latch);
+        pagesWritten = 0;
+        pendingWrites.erase(fileName);
+        auto filePages = pageTable.find(fileName);
+        if (filePages == pageTable.end())
+            return 0;
+        vector<pair<PageNum, unsigned>> dirtyPages;
+        for (auto &entry : filePages->second) {
+            if (frames[entry.second].dirty)
+                dirtyPages.emplace_back(entry.first, entry.second);
+        }
+        if (dirtyPages.empty())
+            return 0;
+        fstream *stream = getStream(fileName);
+        if (nullptr == stream)
+            return -1;
+
+        // Write runs of consecutive pages with a single call each, and flush the stream once at the end
+        sort(dirtyPages.begin(), dirtyPages.end());
+        vector<char> run;
+        for (size_t start = 0, end; start < dirtyPages.size(); start = end) {
+            end = start + 1;
+            while (end < dirtyPages.size() && end - start < GROUP_COMMIT_PAGES
+                   && dirtyPages[end].first == dirtyPages[end - 1].first + 1)
+                end++;
+            run.resize((end - start) * PAGE_SIZE);
+            for (size_t i = start; i < end; ++i) {
+                char *page = frames[dirtyPages[i].second].data;
+                if (checksummed(fileName))
+                    PageChecksum::stamp(page);
+                memcpy(run.data() + (i - start) * PAGE_SIZE, page, PAGE_SIZE);
+            }
+            auto started = chrono::steady_clock::now();
+            stream->clear();
+            stream->seekp((long) dirtyPages[start].first * PAGE_SIZE, ios::beg);
+            stream->write(run.data(), run.size());
+            if (!stream->good())
+                return -1;
+            recordWrite(fileName, end - start, chrono::steady_clock::now() - started);
+            for (size_t i = start; i < end; ++i)
+                frames[dirtyPages[i].second].dirty = false;
+            pagesWritten += end - start;
+        }
+        stream->flush();
+        return stream->good() ? 0 : -1;
+    }
+
+    RC BufferPool::syncFile(const std::string &fileName) {
+        // The streams hide their descriptors, a second one reaches the same inode and its page cache
+        int fd = ::open(fileName.c_str(), O_RDONLY);
+        if (fd == -1)
+            return -1;
+        auto started = chrono::steady_clock::now();
+        RC rc = fdatasync(fd) == 0 ? 0 : -1;
+        recordSync(fileName, chrono::steady_clock::now() - started);
+        ::close(fd);
+        return rc;
+    }
+
+    unsigned BufferPool::getFlushCount(const std::string &fileName) {
+        lock_guard<recursive_mutex> guard(latch);
+        auto fileStatistics = statistics.find(fileName);
+        return fileStatistics == statistics.end() ? 0 : fileStatistics->second.writeLatency.getCount();
+    }
+
+    IOStatistics BufferPool::getStatistics(const std::string &fileName) {
+        lock_guard<recursive_mutex> guard(latch);
+        auto fileStatistics = statistics.find(fileName);
+        return fileStatistics == statistics.end() ? IOStatistics() : fileStatistics->second;
+    }
+
+    void BufferPool::recordRead(const std::string &fileName, unsigned pageCount, std::chrono::nanoseconds elapsed) {
+        lock_guard<recursive_mutex> guard(latch);
+        IOStatistics &fileStatistics = statistics[fileName];
+        fileStatistics.pagesRead += pageCount;
+        fileStatistics.bytesRead += (unsigned long long) pageCount * PAGE_SIZE;
+        fileStatistics.readLatency.record(elapsed);
+    }
+
+    void BufferPool::recordWrite(const std::string &fileName, unsigned pageCount, std::chrono::nanoseconds elapsed) {
+        lock_guard<recursive_mutex> guard(latch);
+        IOStatistics &fileStatistics = statistics[fileName];
+        fileStatistics.pagesWritten += pageCount;
+        fileStatistics.bytesWritten += (unsigned long long) pageCount * PAGE_SIZE;
+        fileStatistics.writeLatency.record(elapsed);
+    }
+
+    void BufferPool::recordSync(const std::string &fileName, std::chrono::nanoseconds elapsed) {
+        lock_guard<recursive_mutex> guard(latch);
+        statistics[fileName].syncLatency.record(elapsed);
+    }
+
+    void BufferPool::discardFile(const std::string &fileName) {
+        lock_guard<recursive_mutex> guard(latch);
+        auto filePages = pageTable.find(fileName);
+        if (filePages != pageTable.end()) {
+            for (auto &entry : filePages->second)
+                releaseFrame(entry.second);
+            pageTable.erase(filePages);
+        }
+        streams.erase(fileName);
+        pendingWrites.erase(fileName);
+        statistics.erase(fileName);
+        checksumFiles.erase(fileName);
+    }
+
+    void BufferPool::enableChecksums(const std::string &fileName) {
+        lock_guard<recursive_mutex> guard(latch);
+        checksumFiles.insert(fileName);
+    }
+
+    bool BufferPool::checksummed(const std::string &fileName) {
+        lock_guard<recursive_mutex> guard(latch);
+        return checksumFiles.count(fileName) != 0;
+    }
+
+    void BufferPool::setChecksumMode(ChecksumMode mode) {
+        lock_guard<recursive_mutex> guard(latch);
+        checksumMode = mode;
+    }
+
+    unsigned BufferPool::getFrameCount() const {
+        return frames.size();
+    }
+
+    std::fstream *BufferPool::getStream(const std::string &fileName) {
+        auto existing = streams.find(fileName);
+        if (existing != streams.end())
+            return &existing->second;
+
+        fstream stream(fileName, ios::in | ios::out | ios::binary);
+        if (!stream.is_open())
+            return nullptr;
+        return &streams.emplace(fileName, std::move(stream)).first->second;
+    }
+
+    RC BufferPool::readPhysical(const std::string &fileName, PageNum pageNum, void *data) {
+        fstream *stream = getStream(fileName);
+        if (nullptr == stream)
+            return -1;
+        auto started = chrono::steady_clock::now();
+        stream->clear();
+        stream->seekg((long) pageNum * PAGE_SIZE, ios::beg);
+        stream->read(static_cast<char *>(data), PAGE_SIZE);
+        long bytesRead = stream->gcount();
+        recordRead(fileName, 1, chrono::steady_clock::now() - started);
+        if (bytesRead < PAGE_SIZE) {
+            // Reading past the end of the file, hand back an empty page
+            memset(static_cast<char *>(data) + bytesRead, 0, PAGE_SIZE - bytesRead);
+            stream->clear();
+        }
+        return verifyPage(fileName, static_cast<char *>(data)) ? 0 : -1;
+    }
+
+    RC BufferPool::writePhysical(const std::string &fileName, PageNum pageNum, const void *data) {
+        fstream *stream = getStream(fileName);
+        if (nullptr == stream)
+            return -1;
+        char stamped[PAGE_SIZE];
+        if (checksummed(fileName)) {
+            // The caller's buffer is const, stamp a copy
+            memcpy(stamped, data, PAGE_SIZE);
+            PageChecksum::stamp(stamped);
+            data = stamped;
+        }
+        auto started = chrono::steady_clock::now();
+        stream->clear();
+        stream->seekp((long) pageNum * PAGE_SIZE, ios::beg);
+        stream->write(static_cast<const char *>(data), PAGE_SIZE);
+        stream->flush();
+        recordWrite(fileName, 1, chrono::steady_clock::now() - started);
+        return stream->good() ? 0 : -1;
+    }
+
+    bool BufferPool::verifyPage(const std::string &fileName, const char *data) {
+        if (checksumMode == CHECKSUM_OFF || !checksummed(fileName) || PageChecksum::verify(data))
+            return true;
+        checksumFailureCounter++;
+        return false;
+    }
+
+    RC BufferPool::deferWrite(const std::string &fileName) {
+        auto now = chrono::steady_clock::now();
+        PendingWrites &writes = pendingWrites[fileName];
+        if (writes.pageCount++ == 0)
+            writes.oldest = now;
+        if (writes.pageCount < GROUP_COMMIT_PAGES && now - writes.oldest < chrono::milliseconds(GROUP_COMMIT_MILLIS))
+            return 0;
+        unsigned pagesWritten = 0;
+        return flushFile(fileName, pagesWritten);
+    }
+
+    bool BufferPool::allocateFrame(unsigned &frameId) {
+        if (!freeFrames.empty()) {
+            frameId = freeFrames.back();
+            freeFrames.pop_back();
+            return true;
+        }
+        if (!policy->victim(frameId))
+            return false;
+
+        Frame &frame = frames[frameId];
+        if (frame.dirty) {
+            writePhysical(frame.fileName, frame.pageNum, frame.data);
+            writeBackCounter++;
+        }
+        pageTable[frame.fileName].erase(frame.pageNum);
+        frame.dirty = false;
+        frame.pinCount = 0;
+        return true;
+    }
+
+    void BufferPool::releaseFrame(unsigned frameId) {
+        Frame &frame = frames[frameId];
+        policy->remove(frameId);
+        frame.fileName.clear();
+        frame.pinCount = 0;
+        frame.dirty = false;
+        freeFrames.push_back(frameId);
+    }
+
+    int BufferPool::lookup(const std::string &fileName, PageNum pageNum) {
+        auto filePages = pageTable.find(fileName);
+        if (filePages == pageTable.end())
+            return -1;
+        auto entry = filePages->second.find(pageNum);
+        return entry == filePages->second.end() ? -1 : static_cast<int>(entry->second);
+    }
+}
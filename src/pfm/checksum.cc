@@ -0,0 +1,112 @@
+#include "src/include/pfm.h"
+#include <cstdint>
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#elif defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#endif
+
+namespace PeterDB {
+    namespace {
+        const uint32_t CRC32C_POLYNOMIAL = 0x82F63B78;  // Castagnoli, reflected
+
+        struct CrcTable {
+            uint32_t entries[256];
+
+            CrcTable() {
+                for (uint32_t i = 0; i < 256; ++i) {
+                    uint32_t crc = i;
+                    for (int bit = 0; bit < 8; ++bit)
+                        crc = (crc >> 1) ^ (crc & 1 ? CRC32C_POLYNOMIAL : 0);
+                    entries[i] = crc;
+                }
+            }
+        };
+
+        uint32_t softwareCrc(uint32_t crc, const unsigned char *data, size_t length) {
+            static const CrcTable table;
+            while (length--)
+                crc = table.entries[(crc ^ *data++) & 0xFF] ^ (crc >> 8);
+            return crc;
+        }
+
+#if defined(__x86_64__) || defined(__i386__)
+        __attribute__((target("sse4.2")))
+        uint32_t hardwareCrc(uint32_t crc, const unsigned char *data, size_t length) {
+#if defined(__x86_64__)
+            uint64_t wide = crc;
+            for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, data, sizeof(word));
+                wide = _mm_crc32_u64(wide, word);
+            }
+            crc = (uint32_t) wide;
+#endif
+            for (; length >= sizeof(uint32_t); length -= sizeof(uint32_t), data += sizeof(uint32_t)) {
+                uint32_t word;
+                memcpy(&word, data, sizeof(word));
+                crc = _mm_crc32_u32(crc, word);
+            }
+            while (length--)
+                crc = _mm_crc32_u8(crc, *data++);
+            return crc;
+        }
+
+        bool hardwareAvailable() {
+            static const bool available = __builtin_cpu_supports("sse4.2");
+            return available;
+        }
+#elif defined(__ARM_FEATURE_CRC32)
+        uint32_t hardwareCrc(uint32_t crc, const unsigned char *data, size_t length) {
+            for (; length >= sizeof(uint64_t); length -= sizeof(uint64_t), data += sizeof(uint64_t)) {
+                uint64_t word;
+                memcpy(&word, data, sizeof(word));
+                crc = __crc32cd(crc, word);
+            }
+            while (length--)
+                crc = __crc32cb(crc, *data++);
+            return crc;
+        }
+
+        bool hardwareAvailable() {
+            return true;
+        }
+#else
+        uint32_t hardwareCrc(uint32_t crc, const unsigned char *data, size_t length) {
+            return softwareCrc(crc, data, length);
+        }
+
+        bool hardwareAvailable() {
+            return false;
+        }
+#endif
+    }
+
+    unsigned PageChecksum::crc32c(const void *data, size_t length) {
+        const unsigned char *bytes = static_cast<const unsigned char *>(data);
+        uint32_t crc = hardwareAvailable() ? hardwareCrc(~0U, bytes, length) : softwareCrc(~0U, bytes, length);
+        return ~crc;
+    }
+
+    void PageChecksum::stamp(char *page) {
+        unsigned checksum = crc32c(page, PAGE_DATA_SIZE);
+        memcpy(page + PAGE_DATA_SIZE, &checksum, PAGE_CHECKSUM_SIZE);
+    }
+
+    bool PageChecksum::verify(const char *page) {
+        unsigned stored;
+        memcpy(&stored, page + PAGE_DATA_SIZE, PAGE_CHECKSUM_SIZE);
+        if (stored == crc32c(page, PAGE_DATA_SIZE))
+            return true;
+        // Never written pages (past the end of the file, fresh appends) are all zeroes and carry no checksum
+        if (stored != 0)
+            return false;
+        for (unsigned i = 0; i < PAGE_DATA_SIZE; ++i) {
+            if (page[i] != 0)
+                return false;
+        }
+        return true;
+    }
+}
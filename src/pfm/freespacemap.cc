@@ -0,0 +1,55 @@
+#include "src/include/pfm.h"
+#include <algorithm>
+
+namespace PeterDB {
+    PageNum FreeSpaceMap::dataPageLocation(PageNum pageNum) {
+        // Every data page is preceded by the level-0 and level-1 pages covering it and all the ones before it
+        PageNum leafPagesBefore = pageNum / FSM_FANOUT + 1;
+        PageNum innerPagesBefore = pageNum / (FSM_FANOUT * FSM_FANOUT) + 1;
+        return HIDDEN_PAGE_COUNT + pageNum + leafPagesBefore + innerPagesBefore;
+    }
+
+    PageNum FreeSpaceMap::leafPageLocation(PageNum pageNum) {
+        return dataPageLocation(pageNum - pageNum % FSM_FANOUT) - 1;
+    }
+
+    PageNum FreeSpaceMap::innerPageLocation(PageNum pageNum) {
+        return dataPageLocation(pageNum - pageNum % (FSM_FANOUT * FSM_FANOUT)) - 2;
+    }
+
+    PageNum FreeSpaceMap::fileEnd(unsigned dataPageCount) {
+        return dataPageCount == 0 ? HIDDEN_PAGE_COUNT : dataPageLocation(dataPageCount - 1) + 1;
+    }
+
+    short FreeSpaceMap::getMaxFreeSpace(const char *page) {
+        return reinterpret_cast<const short *>(page)[0];
+    }
+
+    bool FreeSpaceMap::update(char *page, unsigned slot, short freeBytes) {
+        // Node i has children 2i + 1 and 2i + 2, the FSM_FANOUT leaves are at the end of the array
+        short *tree = reinterpret_cast<short *>(page);
+        unsigned node = FSM_FANOUT - 1 + slot;
+        if (tree[node] == freeBytes)
+            return false;
+        tree[node] = freeBytes;
+        while (node > 0) {
+            node = (node - 1) / 2;
+            short largest = std::max(tree[2 * node + 1], tree[2 * node + 2]);
+            if (tree[node] == largest)
+                break;
+            tree[node] = largest;
+        }
+        return true;
+    }
+
+    int FreeSpaceMap::find(const char *page, short freeBytes) {
+        const short *tree = reinterpret_cast<const short *>(page);
+        if (tree[0] <= freeBytes)
+            return -1;
+        // Prefer the right subtree so the last page with enough space is picked, like the old backward scan
+        unsigned node = 0;
+        while (node < FSM_FANOUT - 1)
+            node = tree[2 * node + 2] > freeBytes ? 2 * node + 2 : 2 * node + 1;
+        return static_cast<int>(node - (FSM_FANOUT - 1));
+    }
+}
@@ -0,0 +1,121 @@
+#include "src/include/pfm.h"
+#include <sstream>
+#include <algorithm>
+
+using namespace std;
+
+namespace PeterDB {
+    namespace {
+        const unsigned SUB_BUCKETS = 1U << LATENCY_SUB_BUCKET_BITS;
+        const unsigned BUCKET_COUNT = (64 - LATENCY_SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+    }
+
+    LatencyHistogram::LatencyHistogram() : buckets(BUCKET_COUNT, 0) {
+        count = 0;
+        total = 0;
+        max = 0;
+    }
+
+    void LatencyHistogram::record(std::chrono::nanoseconds elapsed) {
+        unsigned long long value = elapsed.count() < 0 ? 0 : elapsed.count();
+        buckets[bucketOf(value)]++;
+        count++;
+        total += value;
+        if (value > max)
+            max = value;
+    }
+
+    void LatencyHistogram::merge(const LatencyHistogram &other) {
+        for (unsigned i = 0; i < BUCKET_COUNT; ++i)
+            buckets[i] += other.buckets[i];
+        count += other.count;
+        total += other.total;
+        if (other.max > max)
+            max = other.max;
+    }
+
+    unsigned long long LatencyHistogram::getCount() const {
+        return count;
+    }
+
+    unsigned long long LatencyHistogram::getTotal() const {
+        return total;
+    }
+
+    unsigned long long LatencyHistogram::getMax() const {
+        return max;
+    }
+
+    unsigned long long LatencyHistogram::percentile(double fraction) const {
+        if (count == 0)
+            return 0;
+        unsigned long long rank = (unsigned long long) (fraction * count + 0.5);
+        if (rank == 0)
+            rank = 1;
+        unsigned long long seen = 0;
+        for (unsigned i = 0; i < BUCKET_COUNT; ++i) {
+            seen += buckets[i];
+            if (seen >= rank)
+                return std::min(upperBound(i), max);
+        }
+        return max;
+    }
+
+    std::string LatencyHistogram::toJson() const {
+        ostringstream out;
+        out << "{\"count\":" << count << ",\"totalNanos\":" << total
+            << ",\"p50Nanos\":" << percentile(0.5) << ",\"p90Nanos\":" << percentile(0.9)
+            << ",\"p99Nanos\":" << percentile(0.99) << ",\"maxNanos\":" << max << "}";
+        return out.str();
+    }
+
+    unsigned LatencyHistogram::bucketOf(unsigned long long value) {
+        // Values below two sub-bucket ranges get a bucket each, above that the magnitude picks the range and the
+        // next LATENCY_SUB_BUCKET_BITS bits below the leading one pick the bucket in it
+        if (value < 2 * SUB_BUCKETS)
+            return (unsigned) value;
+        unsigned magnitude = 63 - __builtin_clzll(value);
+        unsigned subBucket = (unsigned) (value >> (magnitude - LATENCY_SUB_BUCKET_BITS)) & (SUB_BUCKETS - 1);
+        return (magnitude - LATENCY_SUB_BUCKET_BITS + 1) * SUB_BUCKETS + subBucket;
+    }
+
+    unsigned long long LatencyHistogram::upperBound(unsigned bucket) {
+        if (bucket < 2 * SUB_BUCKETS)
+            return bucket;
+        unsigned magnitude = bucket / SUB_BUCKETS + LATENCY_SUB_BUCKET_BITS - 1;
+        unsigned long long width = 1ULL << (magnitude - LATENCY_SUB_BUCKET_BITS);
+        return (SUB_BUCKETS + bucket % SUB_BUCKETS) * width + width - 1;
+    }
+
+    IOStatistics::IOStatistics() {
+        pagesRead = 0;
+        pagesWritten = 0;
+        bytesRead = 0;
+        bytesWritten = 0;
+        cacheHits = 0;
+        cacheMisses = 0;
+    }
+
+    void IOStatistics::merge(const IOStatistics &other) {
+        pagesRead += other.pagesRead;
+        pagesWritten += other.pagesWritten;
+        bytesRead += other.bytesRead;
+        bytesWritten += other.bytesWritten;
+        cacheHits += other.cacheHits;
+        cacheMisses += other.cacheMisses;
+        readLatency.merge(other.readLatency);
+        writeLatency.merge(other.writeLatency);
+        syncLatency.merge(other.syncLatency);
+    }
+
+    std::string IOStatistics::toJson() const {
+        ostringstream out;
+        out << "{\"pagesRead\":" << pagesRead << ",\"pagesWritten\":" << pagesWritten
+            << ",\"bytesRead\":" << bytesRead << ",\"bytesWritten\":" << bytesWritten
+            << ",\"cacheHits\":" << cacheHits << ",\"cacheMisses\":" << cacheMisses
+            << ",\"syncs\":" << syncLatency.getCount() << ",\"syncNanos\":" << syncLatency.getTotal()
+            << ",\"readLatency\":" << readLatency.toJson() << ",\"writeLatency\":" << writeLatency.toJson()
+            << ",\"syncLatency\":" << syncLatency.toJson() << "}";
+        return out.str();
+    }
+}
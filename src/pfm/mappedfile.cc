@@ -0,0 +1,90 @@
+#include "src/include/pfm.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <algorithm>
+
+namespace PeterDB {
+    MappedFile::MappedFile() {
+        fd = -1;
+        base = nullptr;
+        windowSize = 0;
+        fileSize = 0;
+    }
+
+    MappedFile::~MappedFile() {
+        if (nullptr != base)
+            munmap(base, windowSize);
+        if (fd != -1)
+            ::close(fd);
+    }
+
+    RC MappedFile::open(const std::string &fileName) {
+        fd = ::open(fileName.c_str(), O_RDWR);
+        if (fd == -1)
+            return -1;
+        struct stat info{};
+        if (fstat(fd, &info) == -1)
+            return -1;
+        fileSize = info.st_size;
+        // Leave room for the file to at least double before the mapping has to move
+        return map(std::max<size_t>(2 * fileSize, (size_t) MMAP_WINDOW_PAGES * PAGE_SIZE));
+    }
+
+    RC MappedFile::close(PageNum pageCount) {
+        if (nullptr == base)
+            return -1;
+        sync();
+        munmap(base, windowSize);
+        base = nullptr;
+        // The growth chunks are not part of the file, hand back what was never used
+        RC rc = ftruncate(fd, (off_t) pageCount * PAGE_SIZE);
+        ::close(fd);
+        fd = -1;
+        return rc == 0 ? 0 : -1;
+    }
+
+    char *MappedFile::page(PageNum pageNum) {
+        if (nullptr == base || (size_t) (pageNum + 1) * PAGE_SIZE > fileSize)
+            return nullptr;
+        return base + (size_t) pageNum * PAGE_SIZE;
+    }
+
+    RC MappedFile::extend(PageNum pageCount) {
+        size_t needed = (size_t) pageCount * PAGE_SIZE;
+        if (needed <= fileSize)
+            return 0;
+        size_t chunk = (size_t) MMAP_GROWTH_PAGES * PAGE_SIZE;
+        size_t newSize = (needed + chunk - 1) / chunk * chunk;
+        if (ftruncate(fd, (off_t) newSize) == -1)
+            return -1;
+        fileSize = newSize;
+        if (newSize <= windowSize)
+            return 0;
+        munmap(base, windowSize);
+        base = nullptr;
+        return map(2 * newSize);
+    }
+
+    RC MappedFile::sync() {
+        if (nullptr == base || fileSize == 0)
+            return 0;
+        return msync(base, fileSize, MS_SYNC) == 0 ? 0 : -1;
+    }
+
+    RC MappedFile::advise(bool sequential) {
+        if (nullptr == base)
+            return -1;
+        return madvise(base, windowSize, sequential ? MADV_SEQUENTIAL : MADV_NORMAL) == 0 ? 0 : -1;
+    }
+
+    RC MappedFile::map(size_t size) {
+        void *address = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (address == MAP_FAILED)
+            return -1;
+        base = static_cast<char *>(address);
+        windowSize = size;
+        return 0;
+    }
+}
@@ -3,6 +3,7 @@
 #include <vector>
 #include <cstring>
 #include <fstream>
+#include <algorithm>
 
 using namespace std;
 
@@ -22,6 +23,9 @@ namespace PeterDB {
 
     RC PagedFileManager::createFile(const std::string &fileName) {
         if (FileHandle::exists(fileName)) return -1;
+        BufferPool::instance().discardFile(fileName);
+        AsyncPageIO::instance().discardFile(fileName);
+        fileStates.erase(fileName);
         fstream newFile(fileName, ios::out);
         FileHandle handle(std::move(newFile));
         handle.init();
@@ -30,16 +34,30 @@ namespace PeterDB {
     }
 
     RC PagedFileManager::destroyFile(const std::string &fileName) {
+        BufferPool::instance().discardFile(fileName);
+        AsyncPageIO::instance().discardFile(fileName);
+        fileStates.erase(fileName);
         return remove(fileName.c_str());
     }
 
-    RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
+    RC PagedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle, PageIOMode mode) {
         if (fileHandle.isOpen() || !FileHandle::exists(fileName)) {
             return -1;
         }
         fstream file(fileName, ios::in | ios::out | ios::binary);
         fileHandle.setFile(std::move(file));
-        return fileHandle.open();
+        fileHandle.fileName = fileName;
+        if (fileHandle.open() == -1) {
+            fileHandle.file.close();
+            return -1;
+        }
+        // A handle already open on this file knows better than the header, which is only written back on close
+        fileHandle.state = shareState(fileName, fileHandle.state->dataPageCount, mode);
+        if (nullptr == fileHandle.state) {
+            fileHandle.file.close();
+            return -1;
+        }
+        return 0;
     }
 
     RC PagedFileManager::closeFile(FileHandle &fileHandle) {
@@ -47,16 +65,55 @@ namespace PeterDB {
         return 0;
     }
 
+    std::shared_ptr<FileState> PagedFileManager::shareState(const std::string &fileName, unsigned dataPageCount,
+                                                            PageIOMode mode) {
+        std::shared_ptr<FileState> state = fileStates[fileName].lock();
+        if (nullptr != state)
+            return state->mode == mode ? state : nullptr;   // Mapped and buffered handles would not see each other's pages
+
+        state = std::make_shared<FileState>(dataPageCount, mode);
+        if (mode == MMAP_IO) {
+            // Frames left over from buffered handles would go stale once the mapping is written
+            unsigned pagesWritten = 0;
+            BufferPool::instance().flushFile(fileName, pagesWritten);
+            BufferPool::instance().discardFile(fileName);
+            state->mapping = new MappedFile();
+            if (state->mapping->open(fileName) == -1)
+                return nullptr;
+        }
+        fileStates[fileName] = state;
+        return state;
+    }
+
+    FileState::FileState(unsigned dataPageCount, PageIOMode mode) {
+        this->dataPageCount = dataPageCount;
+        this->mode = mode;
+        this->mapping = nullptr;
+    }
+
+    FileState::~FileState() {
+        if (nullptr == mapping)
+            return;
+        mapping->close(FreeSpaceMap::fileEnd(dataPageCount));
+        delete mapping;
+    }
+
     FileHandle::FileHandle() {
         readPageCounter = 0;
         writePageCounter = 0;
         appendPageCounter = 0;
+        cacheHitCounter = 0;
+        cacheMissCounter = 0;
+        resetReadAhead();
     }
 
     FileHandle::FileHandle(fstream&& file) {
         readPageCounter = 0;
         writePageCounter = 0;
         appendPageCounter = 0;
+        cacheHitCounter = 0;
+        cacheMissCounter = 0;
+        resetReadAhead();
         this->file = std::move(file);
     }
 
@@ -64,7 +121,11 @@ namespace PeterDB {
         this->readPageCounter = other.readPageCounter;
         this->writePageCounter = other.writePageCounter;
         this->appendPageCounter = other.appendPageCounter;
-        this->pageSpaceMap = other.pageSpaceMap;
+        this->cacheHitCounter = other.cacheHitCounter;
+        this->cacheMissCounter = other.cacheMissCounter;
+        this->state = other.state;
+        this->fileName = other.fileName;
+        resetReadAhead();   // The access pattern belongs to whoever uses the copy
         // Copy assignment will copy the state of this class except the filestream itself. Use setFile to move the file stream.
         // this->file = std::move(other.file);
         return *this;
@@ -74,41 +135,145 @@ namespace PeterDB {
 
     RC FileHandle::readPage(PageNum pageNum, void *data) {
         if (getNumberOfPages() < pageNum) return -1;
-        char bytes[PAGE_SIZE];
-        if (file.eof())
-            file.clear();
-        file.seekg((HIDDEN_PAGE_COUNT + pageNum) * PAGE_SIZE, ios::beg);
-        file.read(bytes, PAGE_SIZE);
-        std::memcpy(data, bytes, PAGE_SIZE);
+        if (mapped()) {
+            char *page = state->mapping->page(FreeSpaceMap::dataPageLocation(pageNum));
+            if (nullptr == page)
+                return -1;
+            memcpy(data, page, PAGE_SIZE);
+            readPageCounter++;
+            return 0;
+        }
+        bool hit = false;
+        if (BufferPool::instance().readPage(fileName, FreeSpaceMap::dataPageLocation(pageNum), data, hit) == -1)
+            return -1;
+        // Every request counts as a page read, misses are the ones that reached the disk
         readPageCounter++;
+        hit ? cacheHitCounter++ : cacheMissCounter++;
+        readAhead(pageNum);
         return 0;
     }
 
     RC FileHandle::writePage(PageNum pageNum, const void *data) {
         if (getNumberOfPages() < pageNum) return -1;
-        file.seekp((HIDDEN_PAGE_COUNT + pageNum) * PAGE_SIZE, ios::beg);
-        file.write(reinterpret_cast<char *>(const_cast<void *>(data)), PAGE_SIZE);
-        file.flush();
+        if (mapped()) {
+            char *page = state->mapping->page(FreeSpaceMap::dataPageLocation(pageNum));
+            if (nullptr == page)
+                return -1;
+            memcpy(page, data, PAGE_SIZE);
+            stampMapped(page);
+            writePageCounter++;
+            return 0;
+        }
+        if (BufferPool::instance().writePage(fileName, FreeSpaceMap::dataPageLocation(pageNum), data, deferred()) == -1)
+            return -1;
         writePageCounter++;
         return 0;
     }
 
     RC FileHandle::appendPage(const void *data) {
+        lock_guard<recursive_mutex> guard(state->latch);
+        PageNum pageNum = getNumberOfPages();
+        // The first data page of every FSM page's range brings the (empty) map pages along
+        if (pageNum % (FSM_FANOUT * FSM_FANOUT) == 0 && appendMapPage(FreeSpaceMap::innerPageLocation(pageNum)) == -1)
+            return -1;
+        if (pageNum % FSM_FANOUT == 0 && appendMapPage(FreeSpaceMap::leafPageLocation(pageNum)) == -1)
+            return -1;
+        PageNum location = FreeSpaceMap::dataPageLocation(pageNum);
+        if (mapped()) {
+            if (state->mapping->extend(location + 1) == -1)
+                return -1;
+            memcpy(state->mapping->page(location), data, PAGE_SIZE);
+            stampMapped(state->mapping->page(location));
+        } else if (BufferPool::instance().writePage(fileName, location, data, deferred()) == -1)
+            return -1;
         appendPageCounter++;
-        pageSpaceMap.push_back(PAGE_SIZE);
-        file.seekp((getNumberOfPages() + HIDDEN_PAGE_COUNT - 1) * PAGE_SIZE, ios::beg);
-        file.write(reinterpret_cast<char *>(const_cast<void *>(data)), PAGE_SIZE);
-        file.flush();
+        state->dataPageCount++;
+        return setPageSpace(pageNum, PAGE_DATA_SIZE);
+    }
+
+    RC FileHandle::readPagesAsync(const std::vector<PageNum> &pageNums, void *data, PageBatch &batch) {
+        for (PageNum pageNum : pageNums) {
+            if (getNumberOfPages() <= pageNum)
+                return -1;
+        }
+        char *target = static_cast<char *>(data);
+        for (PageNum pageNum : pageNums) {
+            PageNum location = FreeSpaceMap::dataPageLocation(pageNum);
+            readPageCounter++;
+            if (mapped()) {
+                batch.expect(1);
+                memcpy(target, state->mapping->page(location), PAGE_SIZE);
+                batch.complete(0);
+            } else if (BufferPool::instance().readCached(fileName, location, target)) {
+                // The pool may hold pages newer than the disk, those never go to the I/O threads
+                batch.expect(1);
+                cacheHitCounter++;
+                batch.complete(0);
+            } else if (AsyncPageIO::instance().submitRead(fileName, location, target, batch) == -1) {
+                return -1;
+            } else {
+                cacheMissCounter++;
+            }
+            target += PAGE_SIZE;
+        }
         return 0;
     }
 
+    RC FileHandle::readPages(const std::vector<PageNum> &pageNums, void *data) {
+        PageBatch batch;
+        RC rc = readPagesAsync(pageNums, data, batch);
+        // Even on a failed submit, the reads already queued write into data and the batch
+        RC completion = batch.wait();
+        return rc == -1 ? -1 : completion;
+    }
+
+    char *FileHandle::pinPage(PageNum pageNum) {
+        if (getNumberOfPages() <= pageNum) return nullptr;
+        if (mapped()) {
+            readPageCounter++;
+            return state->mapping->page(FreeSpaceMap::dataPageLocation(pageNum));
+        }
+        bool hit = false;
+        char *page = BufferPool::instance().pinPage(fileName, FreeSpaceMap::dataPageLocation(pageNum), hit);
+        if (nullptr == page)
+            return nullptr;
+        readPageCounter++;
+        hit ? cacheHitCounter++ : cacheMissCounter++;
+        readAhead(pageNum);
+        return page;
+    }
+
+    RC FileHandle::unpinPage(PageNum pageNum, bool dirty) {
+        if (mapped()) {
+            // Writes through the mapping land in the page cache, msync on checkpoint makes them durable
+            if (dirty)
+                stampMapped(state->mapping->page(FreeSpaceMap::dataPageLocation(pageNum)));
+            return 0;
+        }
+        return BufferPool::instance().unpinPage(fileName, FreeSpaceMap::dataPageLocation(pageNum), dirty);
+    }
+
     unsigned FileHandle::getNumberOfPages() {
-        return pageSpaceMap.size();
+        return nullptr == state ? 0 : state->dataPageCount;
     }
 
     RC FileHandle::setPageSpace(PageNum num, short freeBytes) {
-        this->pageSpaceMap[num] = freeBytes;
-        persistCounters();
+        lock_guard<recursive_mutex> guard(state->latch);
+        // Walk up leaf, inner and root pages, stopping as soon as a page's maximum stays the same
+        PageNum locations[3] = { FreeSpaceMap::leafPageLocation(num), FreeSpaceMap::innerPageLocation(num), FSM_ROOT_PAGE };
+        unsigned slots[3] = { static_cast<unsigned>(num % FSM_FANOUT), static_cast<unsigned>(num / FSM_FANOUT % FSM_FANOUT),
+                              static_cast<unsigned>(num / (FSM_FANOUT * FSM_FANOUT)) };
+        for (int level = 0; level < 3; ++level) {
+            char *mapPage = pinMapPage(locations[level]);
+            if (nullptr == mapPage)
+                return -1;
+            short before = FreeSpaceMap::getMaxFreeSpace(mapPage);
+            bool changed = FreeSpaceMap::update(mapPage, slots[level], freeBytes);
+            freeBytes = FreeSpaceMap::getMaxFreeSpace(mapPage);
+            unpinMapPage(locations[level], changed);
+            if (!changed || before == freeBytes)
+                break;
+        }
         return 0;
     }
 
@@ -119,19 +284,30 @@ namespace PeterDB {
         return 0;
     }
 
+    RC FileHandle::collectCounterValues(unsigned &readPageCount, unsigned &writePageCount, unsigned &appendPageCount,
+                                        unsigned &flushCount) {
+        flushCount = BufferPool::instance().getFlushCount(fileName);
+        return collectCounterValues(readPageCount, writePageCount, appendPageCount);
+    }
+
+    RC FileHandle::collectCacheCounterValues(unsigned &hitCount, unsigned &missCount) {
+        hitCount = this->cacheHitCounter;
+        missCount = this->cacheMissCounter;
+        return 0;
+    }
+
     RC FileHandle::open() {
-        unsigned counters[4] = { 0, 0, 0, 0 };
+        unsigned counters[5] = { 0, 0, 0, 0, 0 };
         file.seekg(0);
         file.read(reinterpret_cast<char *>(counters), sizeof(counters));
+        // Offsets are compiled for one page size, files written with another cannot be read. Older headers have no
+        // page size and are 4 KB.
+        if ((counters[4] == 0 ? 4096 : counters[4]) != PAGE_SIZE)
+            return -1;
         this->readPageCounter = counters[0];
         this->writePageCounter = counters[1];
         this->appendPageCounter = counters[2];
-        unsigned dataPageCount = counters[3];
-        if (dataPageCount > 0) {
-            pageSpaceMap.clear();
-            pageSpaceMap.insert(pageSpaceMap.begin(), dataPageCount, PAGE_SIZE);
-            file.read(reinterpret_cast<char *>(pageSpaceMap.data()), sizeof(short) * dataPageCount);
-        }
+        this->state = std::make_shared<FileState>(counters[3], BUFFERED_IO);
         this->readPageCounter++;
         return 0;
     }
@@ -141,10 +317,46 @@ namespace PeterDB {
     }
 
     RC FileHandle::close() {
-        if (!file.is_open())
+        if (!file.is_open()) {
+            state.reset();
             return 0;
-        persistCounters();
+        }
+        checkpoint();
         file.close();
+        state.reset();
+        return 0;
+    }
+
+    RC FileHandle::sync() {
+        if (writeBack() == -1)
+            return -1;
+        return mapped() ? 0 : BufferPool::instance().syncFile(fileName);   // msync already waited for the mapping
+    }
+
+    RC FileHandle::checkpoint() {
+        if (!file.is_open() || writeBack() == -1 || persistCounters() == -1)
+            return -1;
+        return BufferPool::instance().syncFile(fileName);   // The header goes through this handle's stream
+    }
+
+    RC FileHandle::writeBack() {
+        if (mapped()) {
+            auto started = chrono::steady_clock::now();
+            RC rc = state->mapping->sync();
+            BufferPool::instance().recordSync(fileName, chrono::steady_clock::now() - started);
+            return rc;
+        }
+        unsigned pagesWritten = 0;
+        if (BufferPool::instance().flushFile(fileName, pagesWritten) == -1)
+            return -1;
+        writePageCounter += pagesWritten;
+        return 0;
+    }
+
+    RC FileHandle::adviseSequential(bool sequential) {
+        if (mapped())
+            return state->mapping->advise(sequential);   // The kernel does the read-ahead for mapped files
+        sequentialHint = sequential;
         return 0;
     }
 
@@ -153,8 +365,12 @@ namespace PeterDB {
     }
 
     RC FileHandle::init() {
-        // Initialize appendPageCounter to 1 since we are using a hidden page
-        readPageCounter = 0, writePageCounter = 0, appendPageCounter = 1;
+        // Initialize appendPageCounter to the hidden pages: the counters and the free space map root
+        readPageCounter = 0, writePageCounter = 0, appendPageCounter = HIDDEN_PAGE_COUNT;
+        state = std::make_shared<FileState>(0, BUFFERED_IO);
+        char emptyPage[PAGE_SIZE] = {};
+        file.seekp(FSM_ROOT_PAGE * PAGE_SIZE);
+        file.write(emptyPage, PAGE_SIZE);
         return 0;
     }
 
@@ -169,24 +385,119 @@ namespace PeterDB {
     RC FileHandle::persistCounters(){
         writePageCounter++;
         file.seekp(0);
-        unsigned counters[4] = { readPageCounter, writePageCounter, appendPageCounter, static_cast<unsigned>(pageSpaceMap.size()) };
-        file.write(reinterpret_cast<char *>(counters), sizeof(counters));
-        if (!pageSpaceMap.empty())
-            file.write(reinterpret_cast<char *>(pageSpaceMap.data()), sizeof(short) * pageSpaceMap.size());  //TODO: Handle when map becomes too big for one page
-        int spaceToReserve = PAGE_SIZE * HIDDEN_PAGE_COUNT - sizeof(counters) - sizeof(short) * pageSpaceMap.size();
-        char junk[spaceToReserve];
-        file.write(junk, spaceToReserve);
+        char header[PAGE_SIZE] = {};
+        unsigned counters[5] = { readPageCounter, writePageCounter, appendPageCounter, getNumberOfPages(), PAGE_SIZE };
+        memcpy(header, counters, sizeof(counters));
+        file.write(header, PAGE_SIZE);
         file.flush();
         return 0;
     }
 
-    int16_t FileHandle::findFreePage(short bytesToStore) {
-        open();
-        for (int i = (int) getNumberOfPages() - 1; i >= 0 ; --i){
-            if (pageSpaceMap[i] > bytesToStore)
-                return static_cast<int16_t>(i);
+    int FileHandle::findFreePage(short bytesToStore) {
+        lock_guard<recursive_mutex> guard(state->latch);
+        // Descend root -> inner -> leaf, each level narrows the search to one child page
+        PageNum location = FSM_ROOT_PAGE;
+        int pageNum = 0;
+        for (int level = 0; level < 3; ++level) {
+            char *mapPage = pinMapPage(location);
+            if (nullptr == mapPage)
+                return -1;
+            int slot = FreeSpaceMap::find(mapPage, bytesToStore);
+            unpinMapPage(location, false);
+            if (slot == -1)
+                return -1;
+            pageNum = pageNum * FSM_FANOUT + slot;
+            if (level == 0)
+                location = FreeSpaceMap::innerPageLocation(pageNum * FSM_FANOUT * FSM_FANOUT);
+            else if (level == 1)
+                location = FreeSpaceMap::leafPageLocation(pageNum * FSM_FANOUT);
+        }
+        return pageNum < (int) getNumberOfPages() ? pageNum : -1;
+    }
+
+    char *FileHandle::pinMapPage(PageNum location) {
+        if (mapped()) {
+            readPageCounter++;
+            return state->mapping->page(location);
+        }
+        bool hit = false;
+        char *page = BufferPool::instance().pinPage(fileName, location, hit);
+        if (nullptr == page)
+            return nullptr;
+        readPageCounter++;
+        hit ? cacheHitCounter++ : cacheMissCounter++;
+        return page;
+    }
+
+    RC FileHandle::unpinMapPage(PageNum location, bool dirty) {
+        if (!mapped())
+            return BufferPool::instance().unpinPage(fileName, location, dirty);
+        if (dirty)
+            stampMapped(state->mapping->page(location));
+        return 0;
+    }
+
+    void FileHandle::stampMapped(char *page) {
+        // The pool stamps pages on their way to disk, mapped pages never pass through it
+        if (nullptr != page && BufferPool::instance().checksummed(fileName))
+            PageChecksum::stamp(page);
+    }
+
+    RC FileHandle::appendMapPage(PageNum location) {
+        char emptyPage[PAGE_SIZE] = {};
+        if (mapped()) {
+            if (state->mapping->extend(location + 1) == -1)
+                return -1;
+            memcpy(state->mapping->page(location), emptyPage, PAGE_SIZE);
+        } else if (BufferPool::instance().writePage(fileName, location, emptyPage, deferred()) == -1)
+            return -1;
+        appendPageCounter++;
+        return 0;
+    }
+
+    void FileHandle::resetReadAhead() {
+        lastReadPage = static_cast<PageNum>(-1);   // So that starting at page 0 already looks sequential
+        sequentialReads = 0;
+        readAheadWindow = READ_AHEAD_MIN_PAGES;
+        readAheadEnd = 0;
+        sequentialHint = false;
+    }
+
+    void FileHandle::readAhead(PageNum pageNum) {
+        if (pageNum == lastReadPage)
+            return;     // Scans read the same page once per record
+        bool sequential = pageNum == lastReadPage + 1;
+        lastReadPage = pageNum;
+        if (!sequential) {
+            sequentialReads = 0;
+            readAheadWindow = READ_AHEAD_MIN_PAGES;
+            readAheadEnd = pageNum + 1;
+            if (!sequentialHint)
+                return;
+        } else if (++sequentialReads < READ_AHEAD_TRIGGER && !sequentialHint) {
+            return;
         }
-        return -1;
+        // Start the next window once the reader is half way through the current one
+        if (pageNum + readAheadWindow / 2 < readAheadEnd)
+            return;
+        PageNum first = std::max(readAheadEnd, pageNum + 1);
+        PageNum last = std::min(first + readAheadWindow, getNumberOfPages());
+        if (first >= last)
+            return;
+        PageNum location = FreeSpaceMap::dataPageLocation(first);
+        BufferPool::instance().prefetch(fileName, location, FreeSpaceMap::dataPageLocation(last - 1) + 1 - location);
+        readAheadEnd = last;
+        // Keep growing on sustained sequential access, but never let one reader take over the pool
+        unsigned limit = std::max<unsigned>(READ_AHEAD_MIN_PAGES, BufferPool::instance().getFrameCount() / 4);
+        readAheadWindow = std::min<unsigned>(std::min<unsigned>(2 * readAheadWindow, READ_AHEAD_MAX_PAGES), limit);
+    }
+
+    bool FileHandle::mapped() const {
+        return nullptr != state && nullptr != state->mapping;
+    }
+
+    bool FileHandle::deferred() const {
+        return nullptr != state && state->mode == WRITE_BEHIND_IO;
     }
 
 } // namespace PeterDB
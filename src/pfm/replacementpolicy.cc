@@ -0,0 +1,141 @@
+#include "src/include/pfm.h"
+
+namespace PeterDB {
+    ReplacementPolicy *ReplacementPolicy::create(ReplacementPolicyType type, unsigned frameCount) {
+        switch (type) {
+            case CLOCK_POLICY:
+                return new ClockPolicy(frameCount);
+            case LRU_K_POLICY:
+                return new LRUKPolicy(frameCount, LRU_K_HISTORY);
+            case LRU_POLICY:
+            default:
+                return new LRUPolicy(frameCount);
+        }
+    }
+
+    LRUPolicy::LRUPolicy(unsigned frameCount) {
+        positions = std::vector<std::list<unsigned>::iterator>(frameCount);
+        tracked = std::vector<bool>(frameCount, false);
+        evictable = std::vector<bool>(frameCount, false);
+    }
+
+    void LRUPolicy::recordAccess(unsigned frameId) {
+        // Relinking the existing node keeps hits on cached pages off the heap
+        if (tracked[frameId])
+            order.splice(order.end(), order, positions[frameId]);
+        else
+            positions[frameId] = order.insert(order.end(), frameId);
+        tracked[frameId] = true;
+    }
+
+    void LRUPolicy::setEvictable(unsigned frameId, bool canEvict) {
+        evictable[frameId] = canEvict;
+    }
+
+    bool LRUPolicy::victim(unsigned &frameId) {
+        for (unsigned candidate : order) {
+            if (!evictable[candidate])
+                continue;
+            frameId = candidate;
+            remove(candidate);
+            return true;
+        }
+        return false;
+    }
+
+    void LRUPolicy::remove(unsigned frameId) {
+        if (!tracked[frameId])
+            return;
+        order.erase(positions[frameId]);
+        tracked[frameId] = false;
+        evictable[frameId] = false;
+    }
+
+    ClockPolicy::ClockPolicy(unsigned frameCount) {
+        referenced = std::vector<bool>(frameCount, false);
+        tracked = std::vector<bool>(frameCount, false);
+        evictable = std::vector<bool>(frameCount, false);
+        hand = 0;
+    }
+
+    void ClockPolicy::recordAccess(unsigned frameId) {
+        tracked[frameId] = true;
+        referenced[frameId] = true;
+    }
+
+    void ClockPolicy::setEvictable(unsigned frameId, bool canEvict) {
+        evictable[frameId] = canEvict;
+    }
+
+    bool ClockPolicy::victim(unsigned &frameId) {
+        // Two full sweeps clear every reference bit, so a third one cannot find anything new
+        unsigned frameCount = tracked.size();
+        for (unsigned step = 0; step < 2 * frameCount; ++step) {
+            unsigned candidate = hand;
+            hand = (hand + 1) % frameCount;
+            if (!tracked[candidate] || !evictable[candidate])
+                continue;
+            if (referenced[candidate]) {
+                referenced[candidate] = false;
+                continue;
+            }
+            frameId = candidate;
+            remove(candidate);
+            return true;
+        }
+        return false;
+    }
+
+    void ClockPolicy::remove(unsigned frameId) {
+        tracked[frameId] = false;
+        referenced[frameId] = false;
+        evictable[frameId] = false;
+    }
+
+    LRUKPolicy::LRUKPolicy(unsigned frameCount, unsigned k) {
+        this->k = k;
+        currentTime = 0;
+        history = std::vector<std::deque<unsigned long long>>(frameCount);
+        tracked = std::vector<bool>(frameCount, false);
+        evictable = std::vector<bool>(frameCount, false);
+    }
+
+    void LRUKPolicy::recordAccess(unsigned frameId) {
+        tracked[frameId] = true;
+        history[frameId].push_back(currentTime++);
+        if (history[frameId].size() > k)
+            history[frameId].pop_front();
+    }
+
+    void LRUKPolicy::setEvictable(unsigned frameId, bool canEvict) {
+        evictable[frameId] = canEvict;
+    }
+
+    bool LRUKPolicy::victim(unsigned &frameId) {
+        // Frames with fewer than k accesses have an infinite backward k-distance and go first,
+        // ties (and frames with full history) are broken by the oldest recorded access
+        bool found = false, foundInfinite = false;
+        unsigned long long oldest = 0;
+        for (unsigned candidate = 0; candidate < tracked.size(); ++candidate) {
+            if (!tracked[candidate] || !evictable[candidate])
+                continue;
+            bool infinite = history[candidate].size() < k;
+            unsigned long long accessTime = history[candidate].front();
+            if (!found || (infinite && !foundInfinite) || (infinite == foundInfinite && accessTime < oldest)) {
+                frameId = candidate;
+                oldest = accessTime;
+                foundInfinite = infinite;
+                found = true;
+            }
+        }
+        if (found)
+            remove(frameId);
+        return found;
+    }
+
+    void LRUKPolicy::remove(unsigned frameId) {
+        tracked[frameId] = false;
+        evictable[frameId] = false;
+        history[frameId].clear();
+    }
+}
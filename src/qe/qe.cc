@@ -7,6 +7,7 @@ namespace PeterDB {
     Filter::Filter(Iterator *input, const Condition &condition) {
         this->input = input;
         this->condition = condition;
+        compileCondition();
     }
 
     Filter::~Filter() = default;
@@ -15,7 +16,7 @@ namespace PeterDB {
         RC response = 0;
         do {
             response = this->input->getNextTuple(data);
-        } while (response != QE_EOF && !conditionSatisfied(data, this->condition)) ;
+        } while (response != QE_EOF && !conditionSatisfied(data)) ;
         return response;
     }
 
@@ -25,50 +26,59 @@ namespace PeterDB {
         return 0;
     }
 
-    bool Filter::conditionSatisfied(void *data, Condition condition) {
+    void Filter::compileCondition() {
+        // Where the attributes sit in the input and how to compare them is fixed for the whole scan
+        input->getAttributes(inputAttributes);
+        lhsIndex = -1, rhsIndex = -1;
+        for (int i = 0; i < inputAttributes.size(); ++i) {
+            if (condition.lhsAttr == inputAttributes[i].name)
+                lhsIndex = i;
+            if (condition.bRhsIsAttr && condition.rhsAttr == inputAttributes[i].name)
+                rhsIndex = i;
+        }
+        AttrType type = lhsIndex == -1 ? condition.rhsValue.type : inputAttributes[lhsIndex].type;
+        comparator = CompareUtils::compile(type, condition.op);
+        rhsValue = nullptr;
+        rhsLength = 0;
+        if (!condition.bRhsIsAttr && nullptr != condition.rhsValue.data)
+            rhsValue = CompareUtils::rawValue(type, condition.rhsValue.data, rhsLength);
+    }
+
+    bool Filter::conditionSatisfied(const void *data) const {
         if (condition.bRhsIsAttr && condition.lhsAttr == condition.rhsAttr)
             return true;
-
-        std::vector<Attribute> inputAttributes;
-        this->input->getAttributes(inputAttributes);
-        char *lhs, *rhs;
-
-        int nullBytes = ceil((float)inputAttributes.size() / 8);
-        int seenLength = nullBytes;
-        for (int i = 0; i < inputAttributes.size(); ++i) {
-            Attribute attribute = inputAttributes.at(i);
-            if (((char *) data)[i / 8] & (1 << (7 - i % 8))) {
-                if (condition.lhsAttr == attribute.name || (condition.bRhsIsAttr && condition.rhsAttr == attribute.name))
+        if (lhsIndex == -1 || (condition.bRhsIsAttr && rhsIndex == -1))
+            return false;
+
+        // Walk the tuple only as far as the compared attributes, pointing at the values in place
+        const char *tuple = (const char *) data;
+        const char *lhs = nullptr, *rhs = rhsValue;
+        int lhsLength = 0, rhsLength = this->rhsLength;
+        int lastIndex = std::max(lhsIndex, rhsIndex);
+        int seenLength = ceil((float)inputAttributes.size() / 8);
+        for (int i = 0; i <= lastIndex; ++i) {
+            if (tuple[i / 8] & (1 << (7 - i % 8))) {
+                if (i == lhsIndex || i == rhsIndex)
                     return false;
                 continue;
             }
 
-            int fieldLength = attribute.length;
-            if (TypeVarChar == attribute.type)
-            {
-                std::memcpy(&fieldLength, (char *)data + seenLength, sizeof(fieldLength));
-                fieldLength += sizeof(int);
+            int fieldLength = inputAttributes[i].length;
+            if (TypeVarChar == inputAttributes[i].type) {
+                std::memcpy(&fieldLength, tuple + seenLength, sizeof(fieldLength));
+                seenLength += sizeof(fieldLength);
             }
-
-            if (condition.lhsAttr == attribute.name) {
-                lhs = (char *) malloc(fieldLength);
-                std::memcpy(lhs, (char *) data + seenLength, fieldLength);
+            if (i == lhsIndex) {
+                lhs = tuple + seenLength;
+                lhsLength = fieldLength;
             }
-
-            if (condition.bRhsIsAttr && condition.rhsAttr == attribute.name) {
-                rhs = (char *) malloc(fieldLength);
-                std::memcpy(rhs, (char *) data + seenLength, fieldLength);
+            if (i == rhsIndex) {
+                rhs = tuple + seenLength;
+                rhsLength = fieldLength;
             }
             seenLength += fieldLength;
         }
-
-        if (!condition.bRhsIsAttr)
-            rhs = (char *)condition.rhsValue.data;
-
-        bool result = CompareUtils::check(condition.rhsValue.type, condition.op, lhs, rhs);
-        if (nullptr != lhs) free(lhs);
-        if (condition.bRhsIsAttr && nullptr != rhs) free(rhs);
-        return result;
+        return comparator(lhs, lhsLength, rhs, rhsLength);
     }
 
     Project::Project(Iterator *input, const std::vector<std::string> &attrNames) {
@@ -1,12 +1,15 @@
 #include "src/include/rbfm.h"
 #include <cstring>
+#include <utility>
 
 using namespace std;
 
 namespace PeterDB {
     Page::Page() {
         this->records = (char*) malloc(PAGE_SIZE);
-        this->directory = SlotDirectory(PAGE_SIZE - sizeof(short) * 2, 0);
+        this->directory = SlotDirectory(PAGE_DATA_SIZE - sizeof(short) * 2, 0);
+        // A page can never hold more slots than this, adding records to it then never reallocates
+        this->directory.slots.reserve(PAGE_DATA_SIZE / sizeof(Slot));
     }
 
     Page::Page(short recordCount, short freeSpace) {
@@ -14,6 +17,18 @@ namespace PeterDB {
         this->directory = SlotDirectory(freeSpace, recordCount);
     }
 
+    Page::Page(Page &&other) noexcept {
+        this->records = other.records;
+        this->directory = std::move(other.directory);
+        other.records = nullptr;
+    }
+
+    Page& Page::operator=(Page &&other) noexcept {
+        std::swap(this->records, other.records);
+        this->directory = std::move(other.directory);
+        return *this;
+    }
+
     Page& Page::operator=(const Page &other) {
         this->directory.recordCount = other.directory.recordCount;
         this->directory.freeSpace = other.directory.freeSpace;
@@ -22,7 +37,14 @@ namespace PeterDB {
         return *this;
     }
 
-    RC Page::addRecord(unsigned short slotNum, Record &record, unsigned short recordLength) {
+    void Page::reset() {
+        // Keeps the record buffer and the slot vector's capacity for the next page
+        this->directory.slots.clear();
+        this->directory.recordCount = 0;
+        this->directory.freeSpace = PAGE_DATA_SIZE - sizeof(short) * 2;
+    }
+
+    RC Page::addRecord(unsigned short slotNum, const char *recordBytes, unsigned short recordLength) {
         // To set to the start of the record
         Slot leftSlot = findFilledSlotBetween(0, slotNum - 1);
         int copiedLength = leftSlot.length > 0 ? leftSlot.offset + leftSlot.length : 0;
@@ -30,22 +52,19 @@ namespace PeterDB {
         // To copy data after slot with addition
         Slot rightSlot = findFilledSlotBetween(slotNum + 1, directory.slots.size() - 1);
         if (rightSlot.length > 0) {
-            memcpy(this->records + copiedLength + recordLength, records + leftSlot.offset + leftSlot.length,
-                   rightSlot.offset + rightSlot.length - (leftSlot.offset + leftSlot.length));
+            memmove(this->records + copiedLength + recordLength, records + leftSlot.offset + leftSlot.length,
+                    rightSlot.offset + rightSlot.length - (leftSlot.offset + leftSlot.length));
             for (int i = slotNum + 1; i < directory.recordCount; ++i)
                 if (directory.slots[i].offset != -1)
                     directory.slots[i].offset += recordLength;
         }
 
-        char *recordBytes = (char *) malloc(recordLength);
-        record.toBytes(recordLength, recordBytes);
         memcpy(this->records + copiedLength, recordBytes, recordLength);
-        free(recordBytes);
         this->directory.freeSpace = this->directory.freeSpace - recordLength;
         return 0;
     }
 
-    RC Page::updateRecord(unsigned short slotNum, Record &record, short newLength) {
+    RC Page::updateRecord(unsigned short slotNum, const char *recordBytes, short newLength) {
         // Shift records to the right
         if (slotNum + 1 < directory.recordCount) {
             Slot lastSlot = findFilledSlotBetween(slotNum + 1, directory.recordCount - 1);
@@ -59,10 +78,7 @@ namespace PeterDB {
                     directory.slots[i].offset += (newLength - currentSlot.length);
         }
         // Update record in place
-        char *recordBytes = (char *) malloc(newLength);
-        record.toBytes(newLength, recordBytes);
         memcpy(records + directory.getRecordOffset(slotNum), recordBytes, newLength);
-        free(recordBytes);
         directory.freeSpace -= (newLength - directory.getRecordLength(slotNum));
         directory.updateSlot(slotNum, newLength);
         return 0;
@@ -93,15 +109,9 @@ namespace PeterDB {
         return 0;
     }
 
-    void Page::getRecord(unsigned short slotNum, Record &record) {
-        if (checkRecordDeleted(slotNum))
-            record = Record({ PAGE_SIZE * 2, PAGE_SIZE  * 2 }, -1, vector<short>(0), nullptr);
-
-        Slot recordSlot = this->directory.slots[slotNum];
-        char* recordData = (char*) malloc(recordSlot.length);
-        memcpy(recordData, records + recordSlot.offset, recordSlot.length);
-        record = Record(recordData);
-        free(recordData);
+    RecordView Page::getRecord(unsigned short slotNum) const {
+        // Only valid until the page is changed, check checkRecordDeleted() first
+        return RecordView(records + this->directory.slots[slotNum].offset);
     }
 
     bool Page::checkRecordDeleted(unsigned short slotNum) {
@@ -120,10 +130,7 @@ namespace PeterDB {
     }
 
     void Page::moveRecords(int moveStartOffset, int destinationOffset, int length) {
-        char *dataToShift = (char *) malloc(length);
-        std::memcpy(dataToShift, this->records + moveStartOffset, length);
-        std::memcpy(this->records + destinationOffset, dataToShift, length);
-        free(dataToShift);
+        std::memmove(this->records + destinationOffset, this->records + moveStartOffset, length);
     }
 
     int Page::getDataRecordCount() {
@@ -0,0 +1,67 @@
+#include "src/include/rbfm.h"
+#include <cstring>
+
+namespace PeterDB {
+    PageView::PageView() {
+        fileHandle = nullptr;
+        pageNum = 0;
+        data = nullptr;
+    }
+
+    PageView::~PageView() {
+        unpin();
+    }
+
+    RC PageView::pin(FileHandle &handle, PageNum num) {
+        unpin();
+        data = handle.pinPage(num);
+        if (nullptr == data)
+            return -1;
+        fileHandle = &handle;
+        pageNum = num;
+        return 0;
+    }
+
+    void PageView::unpin() {
+        if (nullptr == data)
+            return;
+        fileHandle->unpinPage(pageNum, false);
+        data = nullptr;
+    }
+
+    bool PageView::pinned() const {
+        return nullptr != data;
+    }
+
+    PageNum PageView::getPageNum() const {
+        return pageNum;
+    }
+
+    short PageView::getRecordCount() const {
+        short recordCount;
+        memcpy(&recordCount, data + PAGE_DATA_SIZE - sizeof(short), sizeof(short));
+        return recordCount;
+    }
+
+    short PageView::getFreeSpace() const {
+        short freeSpace;
+        memcpy(&freeSpace, data + PAGE_DATA_SIZE - sizeof(short) * 2, sizeof(short));
+        return freeSpace;
+    }
+
+    Slot PageView::getSlot(unsigned short slotNum) const {
+        // Slots are stored in order, right before the free space and record count
+        Slot slot;
+        const char *slots = data + PAGE_DATA_SIZE - sizeof(short) * 2 - sizeof(Slot) * getRecordCount();
+        memcpy(&slot, slots + sizeof(Slot) * slotNum, sizeof(Slot));
+        return slot;
+    }
+
+    bool PageView::recordDeleted(unsigned short slotNum) const {
+        return slotNum >= getRecordCount() || getSlot(slotNum).length == -1;
+    }
+
+    RecordView PageView::getRecord(unsigned short slotNum) const {
+        return RecordView(data + getSlot(slotNum).offset);
+    }
+}
@@ -17,10 +17,6 @@ namespace PeterDB {
 
     RecordBasedFileManager::~RecordBasedFileManager() = default;
 
-    RecordBasedFileManager::RecordBasedFileManager(const RecordBasedFileManager &) = default;
-
-    RecordBasedFileManager &RecordBasedFileManager::operator=(const RecordBasedFileManager &) = default;
-
     RC RecordBasedFileManager::createFile(const std::string &fileName) {
         PagedFileManager &pagedFileManager = PagedFileManager::instance();
         return pagedFileManager.createFile(fileName);
@@ -31,9 +27,11 @@ namespace PeterDB {
         return pagedFileManager.destroyFile(fileName);
     }
 
-    RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle) {
+    RC RecordBasedFileManager::openFile(const std::string &fileName, FileHandle &fileHandle, PageIOMode mode) {
         PagedFileManager &pagedFileManager = PagedFileManager::instance();
-        return pagedFileManager.openFile(fileName, fileHandle);
+        // Record pages keep a checksum in their last bytes, raw paged files stay byte for byte what was written
+        BufferPool::instance().enableChecksums(fileName);
+        return pagedFileManager.openFile(fileName, fileHandle, mode);
     }
 
     RC RecordBasedFileManager::closeFile(FileHandle &fileHandle) {
@@ -45,63 +43,83 @@ namespace PeterDB {
                                             const void *data, RID &rid) {
         int fieldInfo[recordDescriptor.size()];
         short recordLength;
-        vector<short> offsets (recordDescriptor.size(), 0);
+        short offsets[recordDescriptor.size()];
         getRecordProperties(recordDescriptor, data, recordLength, offsets, fieldInfo);
-        // Find the right page
+        char recordBytes[recordLength];
+        serializeRecord(recordDescriptor, data, recordLength, offsets, fieldInfo, recordBytes);
+        // Find the right page, insertPage is reused so a steady stream of inserts does not touch the heap
         unsigned pageDataSize; bool append;
-        Page page = findFreePage(recordLength + offsets.size() * sizeof(short) + sizeof(short) + sizeof(Slot),
-                                 fileHandle, pageDataSize, rid.pageNum, rid.slotNum, append);
-        Record record = prepareRecord(rid, recordDescriptor, data, recordLength, offsets, fieldInfo);
-        addRecordToPage(page, record, rid, pageDataSize, recordLength);
-        return writePage(rid.pageNum, page, fileHandle, append);
+        if (findFreePage(recordLength + recordDescriptor.size() * sizeof(short) + sizeof(short) + sizeof(Slot),
+                         fileHandle, insertPage, pageDataSize, rid.pageNum, rid.slotNum, append) == -1)
+            return -1;
+        addRecordToPage(insertPage, recordBytes, rid, pageDataSize, recordLength);
+        return writePage(rid.pageNum, insertPage, fileHandle, append);
+    }
+
+    RC RecordBasedFileManager::insertRecords(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
+                                             const std::vector<const void *> &records, std::vector<RID> &rids) {
+        rids.resize(records.size());
+        int fieldInfo[recordDescriptor.size()];
+        short offsets[recordDescriptor.size()];
+        RID rid;
+        unsigned pageDataSize = 0; bool append = false;
+        bool filling = false;   // insertPage holds records not written yet, it is page rid.pageNum
+        for (size_t i = 0; i < records.size(); ++i) {
+            short recordLength;
+            getRecordProperties(recordDescriptor, records[i], recordLength, offsets, fieldInfo);
+            char recordBytes[recordLength];
+            serializeRecord(recordDescriptor, records[i], recordLength, offsets, fieldInfo, recordBytes);
+
+            // Same reservation as insertRecord, so batched and single inserts fill pages alike
+            short bytesNeeded = recordLength + recordDescriptor.size() * sizeof(short) + sizeof(short) + sizeof(Slot);
+            long freeBytes = PAGE_DATA_SIZE - (long) pageDataSize - sizeof(short) * 2
+                             - (long) (insertPage.directory.slots.size() * sizeof(Slot));
+            if (filling && freeBytes < bytesNeeded) {
+                if (writePage(rid.pageNum, insertPage, fileHandle, append) == -1)
+                    return -1;
+                filling = false;
+            }
+            if (!filling) {
+                if (findFreePage(bytesNeeded, fileHandle, insertPage, pageDataSize, rid.pageNum, rid.slotNum,
+                                 append) == -1)
+                    return -1;
+                filling = true;
+            } else {
+                rid.slotNum = insertPage.getFreeSlot();
+            }
+            addRecordToPage(insertPage, recordBytes, rid, pageDataSize, recordLength);
+            pageDataSize += recordLength;
+            rids[i] = rid;
+        }
+        return filling ? writePage(rid.pageNum, insertPage, fileHandle, append) : 0;
     }
 
     RC RecordBasedFileManager::readRecord(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                           const RID &rid, void *data) {
         RID trueId = rid;
-        Page page;
-        findRecord(trueId, fileHandle, page);
-
-        if (!page.checkValid())
+        PageView page;
+        if (locateRecord(fileHandle, trueId, page) == -1)
             return -1; // Was deleted, return error
-
-        int recordOffset = page.directory.slots[trueId.slotNum].offset,
-            recordLength = page.directory.slots[trueId.slotNum].length;
-        char* recordData = (char*) malloc(recordLength);
-        copyAttribute(page.records, recordData, recordOffset, recordLength);
-        Record record(recordData);
-        free(recordData);
+        RecordView record = page.getRecord(trueId.slotNum);
 
         // Null bitmap
-        int nullBytes = ceil((float)record.attributeCount / 8);
-        char nullBitMap [nullBytes];
+        int nullBytes = ceil((float) recordDescriptor.size() / 8);
+        char *nullBitMap = (char *) data;
         std::memset(nullBitMap, 0, nullBytes);
-        for (int i = 0; i < recordDescriptor.size(); ++i) {
-            if (record.offsets[i] == -1)
-                nullBitMap[i / 8] = nullBitMap[i / 8] | (1 << (7 - i % 8));
-        }
-
-        memcpy(data, nullBitMap, nullBytes);
         int currentOffset = nullBytes;
-        int sourceOffset = 0;
-        int nonNullIndex = -1;
-        // Add back varchar length
+        // Copy the values straight off the page, adding back the varchar lengths
         for (int i = 0; i < recordDescriptor.size(); ++i) {
-            int columnPosition = i;
-            if (record.offsets[columnPosition] == -1)
-                continue; // NULL
-            int fieldSize = recordDescriptor[i].length;
+            int fieldSize = record.getAttributeLength(i);
+            if (fieldSize == -1) {
+                nullBitMap[i / 8] = nullBitMap[i / 8] | (1 << (7 - i % 8));
+                continue;
+            }
             if (recordDescriptor[i].type == TypeVarChar) {
-                // Get the size of the varchar and append
-                int startIndex = nonNullIndex == -1 ? sizeof(short) * (recordDescriptor.size() + 1) : record.offsets[nonNullIndex];
-                fieldSize = record.offsets[columnPosition] == -1 ? 0 : record.offsets[columnPosition] - startIndex;
                 memcpy((char*) data + currentOffset, &fieldSize, 4);
                 currentOffset += 4;
             }
-            if (fieldSize == 0)
-                continue;
-            copyAttribute(record.values, data, sourceOffset, currentOffset, fieldSize);
-            nonNullIndex = columnPosition;
+            memcpy((char*) data + currentOffset, record.getAttribute(i), fieldSize);
+            currentOffset += fieldSize;
         }
 
         return 0;
@@ -166,26 +184,29 @@ namespace PeterDB {
         // Find change in record length
         int fieldInfo[recordDescriptor.size()];
         short newLength;
-        vector<short> offsets (recordDescriptor.size(), 0);
+        short offsets[recordDescriptor.size()];
         getRecordProperties(recordDescriptor, data, newLength, offsets, fieldInfo);
-        Record record = prepareRecord(rid, recordDescriptor, data, newLength, offsets, fieldInfo);
+        char recordBytes[newLength];
+        serializeRecord(recordDescriptor, data, newLength, offsets, fieldInfo, recordBytes);
 
         if (newLength <= recordLength || newLength - recordLength < page.directory.freeSpace) {
-            page.updateRecord(rid.slotNum, record, newLength);
+            page.updateRecord(rid.slotNum, recordBytes, newLength);
             return writePage(rid.pageNum, page, fileHandle, false);
         }
 
         // 2. If current page cannot hold, find a new page, insert record there
         unsigned pageDataSize, pageNum;
         unsigned short slotNum; bool append;
-        Page newPage = findFreePage(newLength, fileHandle, pageDataSize, pageNum, slotNum, append);
+        Page newPage;
+        if (findFreePage(newLength, fileHandle, newPage, pageDataSize, pageNum, slotNum, append) == -1)
+            return -1;
         RID newRid = { pageNum, slotNum };
-        record.rid = newRid;
-        addRecordToPage(newPage, record, newRid, pageDataSize, newLength);
+        addRecordToPage(newPage, recordBytes, newRid, pageDataSize, newLength);
         writePage(newRid.pageNum, newPage, fileHandle, append);
 
         // Write the new RID in old place and shift other records left
-        Record ridData = getRidPlaceholder(newRid);
+        char ridData[RID_PLACEHOLDER_SIZE];
+        getRidPlaceholder(newRid, ridData);
         updateRid(rid, ridData, fileHandle);
         return 0;
     }
@@ -193,21 +214,15 @@ namespace PeterDB {
     RC RecordBasedFileManager::readAttribute(FileHandle &fileHandle, const std::vector<Attribute> &recordDescriptor,
                                              const RID &rid, const std::string &attributeName, void *data) {
         RID trueId = rid;
-        Page page;
-        findRecord(trueId, fileHandle, page);
-        if (!page.checkValid()) // Deleted
+        PageView page;
+        if (locateRecord(fileHandle, trueId, page) == -1) // Deleted
             return -1;
 
-        Record record;
-        page.getRecord(trueId.slotNum, record);
-        if (record.absent())
-            return -1;
-
-        return readAttribute(record, recordDescriptor, rid, attributeName, data);
+        return readAttribute(page.getRecord(trueId.slotNum), recordDescriptor, attributeName, data);
     }
 
-    RC RecordBasedFileManager::readAttribute(Record &record, const std::vector<Attribute> &recordDescriptor,
-                                             const RID &rid, const std::string &attributeName, void *data) {
+    RC RecordBasedFileManager::readAttribute(const RecordView &record, const std::vector<Attribute> &recordDescriptor,
+                                             const std::string &attributeName, void *data) {
         // Get the index of the attribute from descriptor
         int attributeIndex = -1;
         for (int i = 0; i < recordDescriptor.size(); ++i){
@@ -234,10 +249,7 @@ namespace PeterDB {
             memcpy((char *) data + 1, &attributeLength, sizeof(attributeLength));
             copiedLength += sizeof(attributeLength);
         }
-        char *attributeData = (char*) malloc(attributeLength);
-        record.readAttribute(attributeIndex, attributeData);
-        memcpy((char*)data + copiedLength, attributeData, attributeLength);
-        free(attributeData);
+        memcpy((char*)data + copiedLength, record.getAttribute(attributeIndex), attributeLength);
         return 0;
     }
 
@@ -248,28 +260,43 @@ namespace PeterDB {
         rbfm_ScanIterator = RBFM_ScanIterator(recordDescriptor, conditionAttribute, compOp, const_cast<void *>(value),
                                               attributeNames, fileHandle);
         rbfm_ScanIterator.setFile(std::move(fileHandle.file));
+        rbfm_ScanIterator.fileHandle.adviseSequential(true);
         return 0;
     }
 
-    RC RecordBasedFileManager::readPage(PageNum pageNum, Page &ogPage, FileHandle &file) {
-        char* pageData = (char*) malloc(PAGE_SIZE);
-        if (file.readPage(pageNum, pageData) == -1)
+    RC RecordBasedFileManager::readPage(PageNum pageNum, Page &page, FileHandle &file) {
+        // Fills the page in place straight from the pinned frame, its buffers are reused
+        const char* pageData = file.pinPage(pageNum);
+        if (nullptr == pageData)
             return -1;
 
         // Read slot directory
         short recordCount, freeSpace;
-        memcpy(&recordCount, pageData + PAGE_SIZE - sizeof(short), sizeof(short));
-        memcpy(&freeSpace, pageData + PAGE_SIZE - sizeof(short) * 2, sizeof(short));
+        memcpy(&recordCount, pageData + PAGE_DATA_SIZE - sizeof(short), sizeof(short));
+        memcpy(&freeSpace, pageData + PAGE_DATA_SIZE - sizeof(short) * 2, sizeof(short));
         long slotsSize = static_cast<int>(sizeof(Slot)) * recordCount;
 
-        Page page (recordCount, freeSpace);
-        memcpy(page.directory.slots.data(), pageData + PAGE_SIZE - sizeof(short) * 2 - slotsSize, slotsSize);
+        page.directory.recordCount = recordCount;
+        page.directory.freeSpace = freeSpace;
+        page.directory.slots.resize(recordCount);
+        memcpy(page.directory.slots.data(), pageData + PAGE_DATA_SIZE - sizeof(short) * 2 - slotsSize, slotsSize);
 
         // Read records
-        u_short recordsSize = PAGE_SIZE - sizeof(short) * 2 - slotsSize - page.directory.freeSpace;
+        u_short recordsSize = PAGE_DATA_SIZE - sizeof(short) * 2 - slotsSize - page.directory.freeSpace;
         memcpy(page.records, pageData, recordsSize);
-        free(pageData);
-        ogPage = page;
+        return file.unpinPage(pageNum, false);
+    }
+
+    RC RecordBasedFileManager::locateRecord(FileHandle &fileHandle, RID &rid, PageView &page) {
+        if (page.pin(fileHandle, rid.pageNum) == -1 || page.recordDeleted(rid.slotNum))
+            return -1;
+        RecordView record = page.getRecord(rid.slotNum);
+        while (record.absent()) {
+            rid = record.getNewRid();
+            if (page.pin(fileHandle, rid.pageNum) == -1 || page.recordDeleted(rid.slotNum))
+                return -1;
+            record = page.getRecord(rid.slotNum);
+        }
         return 0;
     }
 
@@ -279,14 +306,13 @@ namespace PeterDB {
         for (short i = 0; i < page.directory.recordCount; ++i)
             recordsSize += page.directory.getRecordLength(i);
 
-        char* pageData = (char*) malloc(PAGE_SIZE);
+        char pageData[PAGE_SIZE];
         memcpy(pageData, page.records, recordsSize);
-        short freeBytes = PAGE_SIZE - recordsSize - sizeof(short) * 2 - slotsSize;
-        memcpy(pageData + PAGE_SIZE - sizeof(short) * 2 - slotsSize, page.directory.slots.data(), slotsSize);
-        memcpy(pageData + PAGE_SIZE - sizeof(short) * 2, &freeBytes, sizeof(short));
-        memcpy(pageData + PAGE_SIZE - sizeof(short), &page.directory.recordCount, sizeof(short));
+        short freeBytes = PAGE_DATA_SIZE - recordsSize - sizeof(short) * 2 - slotsSize;
+        memcpy(pageData + PAGE_DATA_SIZE - sizeof(short) * 2 - slotsSize, page.directory.slots.data(), slotsSize);
+        memcpy(pageData + PAGE_DATA_SIZE - sizeof(short) * 2, &freeBytes, sizeof(short));
+        memcpy(pageData + PAGE_DATA_SIZE - sizeof(short), &page.directory.recordCount, sizeof(short));
         RC writeSuccess = toAppend ? file.appendPage(pageData) : file.writePage(pageNum, pageData);
-        free(pageData);
         file.setPageSpace(pageNum, freeBytes);
 
         return writeSuccess;
@@ -298,16 +324,15 @@ namespace PeterDB {
         if (page.checkRecordDeleted(rid.slotNum))
             return;
 
-        Record record;
-        page.getRecord(rid.slotNum, record);
+        RecordView record = page.getRecord(rid.slotNum);
         while (record.absent()) {
             rid = record.getNewRid();
             readPage(rid.pageNum, page, fileHandle);
             if (page.checkRecordDeleted(rid.slotNum))
                 return;
-            page.getRecord(rid.slotNum, record);
+            record = page.getRecord(rid.slotNum);
         }
-        ogPage = page;
+        ogPage = std::move(page);
     }
 
     void RecordBasedFileManager::deepDelete(RID rid, FileHandle& fileHandle) {
@@ -315,8 +340,7 @@ namespace PeterDB {
         readPage(rid.pageNum, page, fileHandle);
         if (page.checkRecordDeleted(rid.slotNum))
             return;
-        Record record;
-        page.getRecord(rid.slotNum, record);
+        RecordView record = page.getRecord(rid.slotNum);
         if (record.absent())
             deepDelete(record.getNewRid(), fileHandle);
 
@@ -324,34 +348,42 @@ namespace PeterDB {
         writePage(rid.pageNum, page, fileHandle, false);
     }
 
-    Page RecordBasedFileManager::findFreePage(short bytesNeeded, FileHandle& fileHandle, unsigned &pageDataSize,
-                                              unsigned &pageNum, unsigned short &slotNum, bool &append) {
+    RC RecordBasedFileManager::findFreePage(short bytesNeeded, FileHandle& fileHandle, Page &page, unsigned &pageDataSize,
+                                            unsigned &pageNum, unsigned short &slotNum, bool &append) {
         pageNum = fileHandle.getNumberOfPages();
         slotNum = 0;
         pageDataSize = 0;
         int allottedPage = fileHandle.findFreePage(bytesNeeded);
         append = allottedPage == -1;
-        Page page;
-        if (!append) {
-            readPage(allottedPage, page, fileHandle);
-            pageNum = (unsigned short) allottedPage;
-            slotNum = page.getFreeSlot();
-            for (short i = 0; i < page.directory.recordCount; ++i)
-                pageDataSize += page.directory.getRecordLength(i);
+        if (append) {
+            page.reset();
+            return 0;
         }
-        return page;
+        if (readPage(allottedPage, page, fileHandle) == -1)
+            return -1;
+        pageNum = (unsigned) allottedPage;
+        slotNum = page.getFreeSlot();
+        for (short i = 0; i < page.directory.recordCount; ++i)
+            pageDataSize += page.directory.getRecordLength(i);
+        return 0;
     }
 
-    void RecordBasedFileManager::addRecordToPage(Page &page, Record &record, RID rid, unsigned pageDataSize, short recordLength) {
+    void RecordBasedFileManager::addRecordToPage(Page &page, const char *recordBytes, RID rid, unsigned pageDataSize,
+                                                 short recordLength) {
         rid.slotNum < page.directory.slots.size() ? page.directory.setSlot(rid.slotNum, recordLength) :
             page.directory.addSlot(rid.slotNum, pageDataSize, recordLength);
-        page.addRecord(rid.slotNum, record, recordLength);
+        page.addRecord(rid.slotNum, recordBytes, recordLength);
     }
 
-    Record RecordBasedFileManager::prepareRecord(RID rid, const std::vector<Attribute> &recordDescriptor,
-                                                 const void* data, int recordLength, vector<short> &offsets, int* fieldInfo) {
+    void RecordBasedFileManager::serializeRecord(const std::vector<Attribute> &recordDescriptor, const void *data,
+                                                 short recordLength, const short *offsets, const int *fieldInfo,
+                                                 char *recordBytes) {
+        // [attribute count][end offset per attribute][values], padded with zeroes up to recordLength
+        short attributeCount = recordDescriptor.size();
         short nullBytes = ceil(((float)recordDescriptor.size()) / 8); // Null map
-        char* fieldData = (char*)malloc(recordLength);
+        memcpy(recordBytes, &attributeCount, sizeof(short));
+        memcpy(recordBytes + sizeof(short), offsets, sizeof(short) * attributeCount);
+        char* fieldData = recordBytes + sizeof(short) * (attributeCount + 1);
         int currentOffset = nullBytes;
         int copiedOffset = 0;
         for(int i = 0; i < recordDescriptor.size(); i++) {
@@ -364,9 +396,7 @@ namespace PeterDB {
             currentOffset += fieldInfo[columnPosition];
             copiedOffset += fieldInfo[columnPosition];
         }
-        Record record (rid, offsets.size(), offsets, fieldData);
-        free(fieldData);
-        return record;
+        memset(fieldData + copiedOffset, 0, recordBytes + recordLength - (fieldData + copiedOffset));
     }
 
     int RecordBasedFileManager::copyAttribute(const void *data, void* destination, int& startOffset, int length) {
@@ -408,7 +438,7 @@ namespace PeterDB {
     }
 
      void RecordBasedFileManager::getRecordProperties(const std::vector<Attribute> &recordDescriptor, const void *data,
-                                                          short &recordLength, vector<short> &offsets, int *fieldLengths) {
+                                                          short &recordLength, short *offsets, int *fieldLengths) {
         short nullBytes = ceil(((float)recordDescriptor.size()) / 8);
         recordLength = sizeof(short) + sizeof(short) * recordDescriptor.size(); // space for fieldCount 'n' and n offsets
         int currentOffset = nullBytes;
@@ -437,32 +467,26 @@ namespace PeterDB {
             recordLength = MIN_RECORD_SIZE;
     }
 
-    Record RecordBasedFileManager::getRidPlaceholder(RID rid) {
-        Record record;
-        record.attributeCount = -1;
-        record.offsets = vector<short>();
-        record.offsets.push_back(sizeof(short) * 3 + sizeof(rid.pageNum));
-        record.offsets.push_back(sizeof(short) * 3 + sizeof(rid.pageNum) + sizeof(rid.slotNum));
-        record.values = (char *) malloc(sizeof(RID));
-        memcpy(record.values, &rid.pageNum, sizeof(rid.pageNum));
-        memcpy(record.values + sizeof(rid.pageNum), &rid.slotNum, sizeof(rid.slotNum));
-        return record;
+    void RecordBasedFileManager::getRidPlaceholder(RID rid, char *placeholder) {
+        // A record with attribute count -1 whose two "attributes" are the page and slot it moved to
+        short header[3] = { -1, sizeof(short) * 3 + sizeof(rid.pageNum),
+                            sizeof(short) * 3 + sizeof(rid.pageNum) + sizeof(rid.slotNum) };
+        memcpy(placeholder, header, sizeof(header));
+        memcpy(placeholder + sizeof(header), &rid.pageNum, sizeof(rid.pageNum));
+        memcpy(placeholder + sizeof(header) + sizeof(rid.pageNum), &rid.slotNum, sizeof(rid.slotNum));
     }
 
-    void RecordBasedFileManager::updateRid(RID rid, Record &newRidData, FileHandle &fileHandle) {
+    void RecordBasedFileManager::updateRid(RID rid, const char *placeholder, FileHandle &fileHandle) {
         Page initialPage;
         readPage(rid.pageNum, initialPage, fileHandle);
-        Record record;
-        initialPage.getRecord(rid.slotNum, record);
-        short newSize = sizeof(short) * 3 + sizeof(rid.pageNum) + sizeof(rid.slotNum);
+        RecordView record = initialPage.getRecord(rid.slotNum);
         if (record.absent()) {
             RID newId = record.getNewRid();
             Page nextPage;
             readPage(newId.pageNum, nextPage, fileHandle);
-            nextPage.getRecord(newId.slotNum, record);
             nextPage.deleteRecord(newId.slotNum);
         }
-        initialPage.updateRecord(rid.slotNum, newRidData, newSize);
+        initialPage.updateRecord(rid.slotNum, placeholder, RID_PLACEHOLDER_SIZE);
         writePage(rid.pageNum, initialPage, fileHandle, false);
     }
 } // namespace PeterDB
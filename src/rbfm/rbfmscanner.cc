@@ -1,8 +1,10 @@
 #include "src/include/rbfm.h"
+#include <src/utils/compare_utils.h>
 #include <utility>
 #include <vector>
 #include <string>
 #include <algorithm>
+#include <cstring>
 #include <unordered_map>
 
 namespace PeterDB {
@@ -17,6 +19,8 @@ namespace PeterDB {
         this->pageNum = 0;
         this->slotNum = -1;
         this->fileHandle = fileHandle;
+        planProjection();
+        planCondition();
         // Call setFile to move the fstream
         // this->fileHandle.setFile(std::move(fileHandle.file));
     }
@@ -25,150 +29,115 @@ namespace PeterDB {
         this->fileHandle.setFile(std::move(file));
     }
 
-//    RBFM_ScanIterator & RBFM_ScanIterator::operator= (const RBFM_ScanIterator &other) {
-//        this->recordDescriptor = other.recordDescriptor;
-//        this->conditionAttribute = other.conditionAttribute;
-//        this->compOp = other.compOp;
-//        this->value = other.value;
-//        this->attributeNames = other.attributeNames;
-//        this->pageNum = other.pageNum;
-//        this->slotNum = other.slotNum;
-//        this->fileHandle = other.fileHandle;
-//        return *this;
-//    }
+    RBFM_ScanIterator & RBFM_ScanIterator::operator= (RBFM_ScanIterator &&other) {
+        // A pin belongs to the handle it was taken through, both iterators start over on an unpinned page
+        this->page.unpin();
+        other.page.unpin();
+        this->recordDescriptor = std::move(other.recordDescriptor);
+        this->conditionAttribute = std::move(other.conditionAttribute);
+        this->compOp = other.compOp;
+        this->value = other.value;
+        this->attributeNames = std::move(other.attributeNames);
+        this->projection = std::move(other.projection);
+        this->projectedNullBytes = other.projectedNullBytes;
+        this->conditionIndex = other.conditionIndex;
+        this->comparator = other.comparator;
+        this->conditionValue = other.conditionValue;
+        this->conditionLength = other.conditionLength;
+        this->pageNum = other.pageNum;
+        this->slotNum = other.slotNum;
+        this->fileHandle = other.fileHandle;
+        return *this;
+    }
 
     RC RBFM_ScanIterator::getNextRecord(RID &rid, void *data) {
-        Page page;
-        page.directory.recordCount = 0;
-        if (fileHandle.getNumberOfPages() < 1 || RecordBasedFileManager::readPage(pageNum, page, fileHandle) == -1)
-            return RBFM_EOF;
-        if (!incrementRid(page.directory.recordCount))
-            return RBFM_EOF;
-
-        rid = { pageNum, static_cast<unsigned short>(slotNum) };
-        if (page.checkRecordDeleted(slotNum))
-            return getNextRecord(rid, data);
-        Record record;
-        page.getRecord(slotNum, record);
-        if (record.absent())
-            return getNextRecord(rid, data);
-
-        if (!conditionMet(record))
-            return getNextRecord(rid, data);
-
-        int recordNulls = ceil((float)recordDescriptor.size() / 8);
-        int recordLength = 0;
-        for (auto & attr : recordDescriptor) {
-            recordLength += attr.length;
-        }
-
-        char* recordData = (char*) malloc(recordLength + recordNulls);
-        RecordBasedFileManager::instance().readRecord(fileHandle, recordDescriptor, rid, recordData);
+        // The page stays pinned between calls, each of its slots is looked at once before moving to the next page
+        while (true) {
+            if ((!page.pinned() || page.getPageNum() != pageNum) &&
+                (pageNum >= fileHandle.getNumberOfPages() || page.pin(fileHandle, pageNum) == -1)) {
+                page.unpin();
+                return RBFM_EOF;
+            }
 
-        // Null bitmap
-        int nullBytes = ceil((float)attributeNames.size() / 8);
-        int readOffset = ceil((float)recordDescriptor.size() / 8),
-            writeOffset = nullBytes;
-        int columnIndex = -1, currentIndex = -1;
-        char nullBitMap [nullBytes];
-        std::memset(nullBitMap, 0, nullBytes);
+            short recordCount = page.getRecordCount();
+            while (++slotNum < recordCount) {
+                if (page.recordDeleted(slotNum))
+                    continue;
+                RecordView record = page.getRecord(slotNum);
+                if (record.absent() || !conditionMet(record))
+                    continue;   // Moved records are returned from the page they moved to
+                rid = { pageNum, static_cast<unsigned short>(slotNum) };
+                project(record, data);
+                return 0;
+            }
 
-        // Project columns
-        for (auto &attr : recordDescriptor) {
-            columnIndex++;
-            int fieldLength = 4;
-            if (TypeVarChar == attr.type) {
-                memcpy(&fieldLength, recordData + readOffset, sizeof(fieldLength));
-                readOffset += sizeof(fieldLength);
+            if (pageNum + 1 >= fileHandle.getNumberOfPages()) {
+                page.unpin();
+                return RBFM_EOF;
             }
+            pageNum++;
+            slotNum = -1;
+        }
+    }
 
-            if (std::find(attributeNames.begin(), attributeNames.end(), attr.name) == attributeNames.end()) {
-                readOffset += fieldLength;
+    void RBFM_ScanIterator::planProjection() {
+        // Columns come out in descriptor order, so the per-record work is copying the listed fields
+        projection.clear();
+        projectedNullBytes = ceil((float)attributeNames.size() / 8);
+        for (int columnIndex = 0; columnIndex < recordDescriptor.size(); ++columnIndex) {
+            const Attribute &attr = recordDescriptor[columnIndex];
+            if (std::find(attributeNames.begin(), attributeNames.end(), attr.name) == attributeNames.end())
                 continue; // column not needed
-            }
-            currentIndex++;
-            if (record.offsets[currentIndex] == -1)
-                nullBitMap[currentIndex / 8] = nullBitMap[currentIndex / 8] | (1 << (7 - currentIndex % 8));
+            int currentIndex = projection.size();
+            projection.push_back({ columnIndex, TypeVarChar == attr.type, currentIndex / 8,
+                                   (char) (1 << (7 - currentIndex % 8)) });
+        }
+    }
 
-            if (TypeVarChar == attr.type) {
+    void RBFM_ScanIterator::project(const RecordView &record, void *data) {
+        std::memset(data, 0, projectedNullBytes);
+        int writeOffset = projectedNullBytes;
+        for (const ProjectedColumn &column : projection) {
+            if (record.isNull(column.column)) {
+                ((char*)data)[column.nullByte] |= column.nullMask;
+                continue;
+            }
+            int fieldLength = record.getAttributeLength(column.column);
+            if (column.varChar) {
                 memcpy((char*)data + writeOffset, &fieldLength, sizeof(fieldLength));
                 writeOffset += sizeof(fieldLength);
             }
-
-            memcpy((char*)data + writeOffset, recordData + readOffset, fieldLength);
+            memcpy((char*)data + writeOffset, record.getAttribute(column.column), fieldLength);
             writeOffset += fieldLength;
-            readOffset += fieldLength;
         }
-        memcpy(data, nullBitMap, nullBytes);
-        free(recordData);
-
-        return 0;
     }
 
-    bool RBFM_ScanIterator::incrementRid(int recordCount) {
-        if (recordCount >= slotNum + 2) {
-            // If current page has more records, increment slot until we get one present in this page (un-deleted and un-moved)
-            slotNum++;
-            return true;
-        }
-        if (fileHandle.getNumberOfPages() >= pageNum + 2) {
-            // If all records of page are done, increment page and go to slot 0
-            pageNum++;
-            slotNum = 0;
-            return true;
+    void RBFM_ScanIterator::planCondition() {
+        // The attribute is looked up and the comparison picked once, rows only load and compare
+        conditionIndex = -1;
+        comparator = CompareUtils::compile(TypeInt, NO_OP);
+        conditionValue = nullptr;
+        conditionLength = 0;
+        for (int i = 0; i < recordDescriptor.size(); ++i) {
+            if (conditionAttribute != recordDescriptor[i].name)
+                continue;
+            conditionIndex = i;
+            comparator = CompareUtils::compile(recordDescriptor[i].type, compOp);
+            if (nullptr != value)
+                conditionValue = CompareUtils::rawValue(recordDescriptor[i].type, value, conditionLength);
+            break;
         }
-        return false;
     }
 
-    bool RBFM_ScanIterator::conditionMet(Record &record) {
+    bool RBFM_ScanIterator::conditionMet(const RecordView &record) {
         if (conditionAttribute.empty())
             return true;
-
-        int length = 0;
-        AttrType type = TypeInt;
-        for (auto & i : recordDescriptor) {
-            if (conditionAttribute == i.name) {
-                length = i.length;
-                type = i.type;
-                break;
-            }
-        }
-        char* data = (char*) malloc(length + 1);
-        int readSuccess = RecordBasedFileManager::instance().readAttribute(record, recordDescriptor, { pageNum, static_cast<unsigned short>(slotNum) }, conditionAttribute, data);
-        if (readSuccess != 0) {
-            free(data);
+        if (conditionIndex == -1)
             return false; // if attribute isn't present, default is that the record doesn't match
-        }
-
-        bool result = false;
-
-        switch(compOp) {
-            case EQ_OP:
-                result = checkEqual(type, data, value);
-                break;
-            case LT_OP:
-                result = checkLessThan(type, data, value);
-                break;
-            case LE_OP:
-                result = checkEqual(type, data, value) || checkLessThan(type, data, value);
-                break;
-            case GT_OP:
-                result = checkGreaterThan(type, data, value);
-                break;
-            case GE_OP:
-                result = checkGreaterThan(type, data, value) || checkEqual(type, data, value);
-                break;
-            case NE_OP:
-                result = !checkEqual(type, data, value);
-                break;
-            case NO_OP:
-                result = true;
-                break;
-            default:
-                break;
-        }
-        free(data);
-        return result;
+        if (record.isNull(conditionIndex))
+            return NO_OP == compOp; // NULL compares false to everything
+        return comparator(record.getAttribute(conditionIndex), record.getAttributeLength(conditionIndex),
+                          conditionValue, conditionLength);
     }
 
     RC RBFM_ScanIterator::close() {
@@ -176,79 +145,9 @@ namespace PeterDB {
         recordDescriptor.clear();
         conditionAttribute.clear();
         attributeNames.clear();
+        page.unpin();
+        fileHandle.adviseSequential(false);
         fileHandle.close();
         return 0;
     }
-
-    bool RBFM_ScanIterator::checkEqual(AttrType type, const void *value1, const void *value2) {
-        int startOffset = 1;
-        if (((char *) value1)[0] & (1 << 7))
-            return false;
-        if (TypeVarChar == type) {
-            string s1 = RecordBasedFileManager::parseTypeVarchar(value1, startOffset);
-            startOffset = 0;
-            string s2 = RecordBasedFileManager::parseTypeVarchar(value2, startOffset);
-            return s1 == s2;
-        }
-
-        if (TypeInt == type) {
-            int n1 = RecordBasedFileManager::parseTypeInt(value1, startOffset, 4);
-            startOffset = 0;
-            int n2 = RecordBasedFileManager::parseTypeInt(value2, startOffset, 4);
-            return n1 == n2;
-        }
-
-        float f1 = RecordBasedFileManager::parseTypeReal(value1, startOffset, 4);
-        startOffset = 0;
-        float f2 = RecordBasedFileManager::parseTypeReal(value2, startOffset, 4);
-        return f1 == f2;
-    }
-
-    bool RBFM_ScanIterator::checkLessThan(AttrType type, const void *value1, const void *value2) {
-        int startOffset = 1;
-        if (((char *) value1)[0] & (1 << 7))
-            return false;
-        if (TypeVarChar == type) {
-            string s1 = RecordBasedFileManager::parseTypeVarchar(value1, startOffset);
-            startOffset = 0;
-            string s2 = RecordBasedFileManager::parseTypeVarchar(value2, startOffset);
-            return s1 < s2;
-        }
-
-        if (TypeInt == type) {
-            int n1 = RecordBasedFileManager::parseTypeInt(value1, startOffset, 4);
-            startOffset = 0;
-            int n2 = RecordBasedFileManager::parseTypeInt(value2, startOffset, 4);
-            return n1 < n2;
-        }
-
-        float f1 = RecordBasedFileManager::parseTypeReal(value1, startOffset, 4);
-        startOffset = 0;
-        float f2 = RecordBasedFileManager::parseTypeReal(value2, startOffset, 4);
-        return f1 < f2;
-    }
-
-    bool RBFM_ScanIterator::checkGreaterThan(AttrType type, const void *value1, const void *value2) {
-        int startOffset = 1;
-        if (((char *) value1)[0] & (1 << 7))
-            return false;
-        if (TypeVarChar == type) {
-            string s1 = RecordBasedFileManager::parseTypeVarchar(value1, startOffset);
-            startOffset = 0;
-            string s2 = RecordBasedFileManager::parseTypeVarchar(value2, startOffset);
-            return s1 > s2;
-        }
-
-        if (TypeInt == type) {
-            int n1 = RecordBasedFileManager::parseTypeInt(value1, startOffset, 4);
-            startOffset = 0;
-            int n2 = RecordBasedFileManager::parseTypeInt(value2, startOffset, 4);
-            return n1 > n2;
-        }
-
-        float f1 = RecordBasedFileManager::parseTypeReal(value1, startOffset, 4);
-        startOffset = 0;
-        float f2 = RecordBasedFileManager::parseTypeReal(value2, startOffset, 4);
-        return f1 > f2;
-    }
-}
\ No newline at end of file
+}
@@ -0,0 +1,58 @@
+#include "src/include/rbfm.h"
+#include <cstring>
+
+namespace PeterDB {
+    RecordView::RecordView(const char *bytes) {
+        this->bytes = bytes;
+        memcpy(&this->attributeCount, bytes, sizeof(short));
+    }
+
+    short RecordView::getAttributeCount() const {
+        return attributeCount;
+    }
+
+    bool RecordView::absent() const {
+        return attributeCount == -1;
+    }
+
+    RID RecordView::getNewRid() const {
+        if (!absent()) throw std::exception(); // Method not usable if the record is present
+        unsigned pageNum;
+        unsigned short slotNum;
+        const char *values = bytes + sizeof(short) * 3;
+        memcpy(&pageNum, values, sizeof(pageNum));
+        memcpy(&slotNum, values + sizeof(pageNum), sizeof(slotNum));
+        return { pageNum, slotNum };
+    }
+
+    bool RecordView::isNull(int index) const {
+        return getEndOffset(index) == -1;
+    }
+
+    int RecordView::getAttributeLength(int index) const {
+        short endOffset = getEndOffset(index);
+        return endOffset == -1 ? -1 : endOffset - getStartOffset(index);
+    }
+
+    const char *RecordView::getAttribute(int index) const {
+        return bytes + getStartOffset(index);
+    }
+
+    short RecordView::getEndOffset(int index) const {
+        if (index < 0 || index >= attributeCount)
+            return -1;
+        short offset;
+        memcpy(&offset, bytes + sizeof(short) * (index + 1), sizeof(short));
+        return offset;
+    }
+
+    short RecordView::getStartOffset(int index) const {
+        // Values start where the closest non-NULL attribute before this one ends
+        for (int i = index - 1; i >= 0; i--) {
+            short offset = getEndOffset(i);
+            if (offset != -1)
+                return offset;
+        }
+        return sizeof(short) * (attributeCount + 1);
+    }
+}
@@ -1,7 +1,10 @@
 #include "src/include/rm.h"
 #include "src/utils/copy_utils.h"
+#include "src/utils/compare_utils.h"
 #include <vector>
 #include <string>
+#include <utility>
+#include <algorithm>
 #include <src/include/ix.h>
 
 using namespace std;
@@ -12,15 +15,20 @@ namespace PeterDB {
         return _relation_manager;
     }
 
-    RelationManager::RelationManager() = default;
-
-    RelationManager::~RelationManager() = default;
-
-    RelationManager::RelationManager(const RelationManager &) = default;
+    RelationManager::RelationManager() {
+        // Cached files are closed on destruction through these, construct them first so they are destroyed last
+        RecordBasedFileManager::instance();
+        IndexManager::instance();
+        BufferPool::instance();
+    }
 
-    RelationManager &RelationManager::operator=(const RelationManager &) = default;
+    RelationManager::~RelationManager() {
+        closeCachedFiles();
+    }
 
     RC RelationManager::createCatalog() {
+        catalogCache.clear();
+        closeCachedFiles();
         RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
         recordManager.createFile(TABLE_FILE_NAME);
         recordManager.createFile(COLUMN_FILE_NAME);
@@ -69,6 +77,8 @@ namespace PeterDB {
 
     RC RelationManager::deleteCatalog() {
         // Delete tables and columns files
+        catalogCache.clear();
+        closeCachedFiles();
         RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
         recordManager.destroyFile(COLUMN_FILE_NAME);
         recordManager.destroyFile(TABLE_FILE_NAME);
@@ -102,6 +112,7 @@ namespace PeterDB {
         }
         free(data);
         recordManager.closeFile(handle);
+        invalidateCatalog(tableName);
 
         return recordManager.createFile(tableName);
     }
@@ -148,18 +159,21 @@ namespace PeterDB {
         std::vector<Attribute> indexesDescriptor = getIndexesDescriptor();
         handle = FileHandle();
         std::vector<RID> indexRids;
-        std::vector<std::string> indexFiles = getIndexFiles(tableName, indexRids, tableId);
+        std::vector<std::string> indexFiles = getIndexFiles(tableName, indexRids);
         recordManager.openFile(INDEX_FILE_NAME, handle);
         for (int i = 0; i < indexRids.size(); ++i) {
+            closeCachedFile(indexFiles.at(i));
             IndexManager::instance().destroyFile(indexFiles.at(i));
             recordManager.deleteRecord(handle, indexesDescriptor, indexRids.at(i));
         }
         recordManager.closeFile(handle);
+        invalidateCatalog(tableName);
 
         free(columnTableId);
         free(tableFilter);
 
         // Delete file
+        closeCachedFile(tableName);
         return recordManager.destroyFile(tableName);
     }
 
@@ -168,31 +182,10 @@ namespace PeterDB {
     }
 
     RC RelationManager::getAttributes(const std::string &tableName, std::vector<Attribute> &attrs, bool allowSystemTables) {
-        RID tableRid;
-        int tableId = getTableId(tableName, tableRid);
-        if (tableId == -1 || (tableId <= 2 && !allowSystemTables))
+        const CatalogEntry *entry = getCatalogEntry(tableName);
+        if (nullptr == entry || (entry->tableId <= 2 && !allowSystemTables))
             return -1;
-
-        // Fetch attributes from columns
-        FileHandle handle;
-        char *tableFilter = (char *)malloc(sizeof(tableId));
-        makeTableIdFilter(tableId, tableFilter);
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(COLUMN_FILE_NAME, handle);
-        RBFM_ScanIterator scanner;
-        recordManager.scan(handle, getColumnsDescriptor(), "table-id", EQ_OP, tableFilter, getAttributeSchema(), scanner);
-
-        RID rid;
-        char* data = (char*) malloc(COLUMN_RECORD_MAX_SIZE);
-        while (scanner.getNextRecord(rid, data) != RBFM_EOF) {
-            Attribute column = parseColumnAttribute(data);
-            attrs.push_back(column);
-        }
-        scanner.close();
-        recordManager.closeFile(handle);
-        free(tableFilter);
-        free(data);
-
+        attrs.insert(attrs.end(), entry->attributes.begin(), entry->attributes.end());
         return attrs.empty() ? -1 : 0;
     }
 
@@ -201,28 +194,46 @@ namespace PeterDB {
         if (getAttributes(tableName, tupleDescriptor, false) == -1)
             return -1;
 
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(tableName, handle);
-        int insertSuccess = recordManager.insertRecord(handle, tupleDescriptor, data, rid);
-        recordManager.closeFile(handle);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
+        int insertSuccess = RecordBasedFileManager::instance().insertRecord(*handle, tupleDescriptor, data, rid);
+        releaseFile(tableName);
         addToIndex(tableName, rid, data);
 
         return insertSuccess;
     }
 
+    RC RelationManager::insertTuples(const std::string &tableName, const std::vector<const void *> &tuples,
+                                     std::vector<RID> &rids) {
+        vector<Attribute> tupleDescriptor;
+        if (getAttributes(tableName, tupleDescriptor, false) == -1)
+            return -1;
+
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
+        RC insertSuccess = RecordBasedFileManager::instance().insertRecords(*handle, tupleDescriptor, tuples, rids);
+        releaseFile(tableName);
+        if (insertSuccess == -1)
+            return -1;
+        addToIndexes(tableName, tupleDescriptor, tuples, rids);
+
+        return insertSuccess;
+    }
+
     RC RelationManager::deleteTuple(const std::string &tableName, const RID &rid) {
         RID tableRid;
         if (getTableId(tableName, tableRid) <= 2)
             return -1;
 
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(tableName, handle);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
 
         removeFromIndex(tableName, rid);
-        int deleteSuccess = recordManager.deleteRecord(handle, vector<Attribute>(0), rid);
-        recordManager.closeFile(handle);
+        int deleteSuccess = RecordBasedFileManager::instance().deleteRecord(*handle, vector<Attribute>(0), rid);
+        releaseFile(tableName);
 
         return deleteSuccess;
     }
@@ -232,13 +243,13 @@ namespace PeterDB {
         if (getAttributes(tableName, tupleDescriptor, false) == -1)
             return -1;
 
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(tableName, handle);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
         removeFromIndex(tableName, rid);
 
-        int updateSuccess = recordManager.updateRecord(handle, tupleDescriptor, data, rid);
-        recordManager.closeFile(handle);
+        int updateSuccess = RecordBasedFileManager::instance().updateRecord(*handle, tupleDescriptor, data, rid);
+        releaseFile(tableName);
 
         addToIndex(tableName, rid, data);
 
@@ -250,11 +261,11 @@ namespace PeterDB {
         if (getAttributes(tableName, tupleDescriptor, true) == -1)
             return -1;
 
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(tableName, handle);
-        RC readSuccess = recordManager.readRecord(handle, tupleDescriptor, rid, data);
-        recordManager.closeFile(handle);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
+        RC readSuccess = RecordBasedFileManager::instance().readRecord(*handle, tupleDescriptor, rid, data);
+        releaseFile(tableName);
         return readSuccess;
     }
 
@@ -263,11 +274,11 @@ namespace PeterDB {
         if (getAttributes(tableName, tupleDescriptor, false) == -1)
             return -1;
 
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(tableName, handle);
-        int operationSuccess = (recordManager.*operate)(handle, tupleDescriptor, data, rid);
-        recordManager.closeFile(handle);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
+        int operationSuccess = (RecordBasedFileManager::instance().*operate)(*handle, tupleDescriptor, data, rid);
+        releaseFile(tableName);
         return operationSuccess;
     }
 
@@ -281,11 +292,12 @@ namespace PeterDB {
         if (getAttributes(tableName, tupleDescriptor) == -1)
             return -1;
 
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        recordManager.openFile(tableName, handle);
-        int operationSuccess = recordManager.readAttribute(handle, tupleDescriptor, rid, attributeName, data);
-        recordManager.closeFile(handle);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return -1;
+        int operationSuccess = RecordBasedFileManager::instance().readAttribute(*handle, tupleDescriptor, rid,
+                                                                                attributeName, data);
+        releaseFile(tableName);
         return operationSuccess;
     }
 
@@ -299,40 +311,34 @@ namespace PeterDB {
         if (getAttributes(tableName, tableSchema) == -1)
             return -1;
 
-        rm_ScanIterator.tableName = tableName;
-        rm_ScanIterator.conditionAttribute = conditionAttribute;
-        rm_ScanIterator.compOp = compOp;
-        rm_ScanIterator.value = const_cast<void *>(value);
-        rm_ScanIterator.attributeNames = attributeNames;
-        rm_ScanIterator.descriptor = tableSchema;
-        rm_ScanIterator.pageNum = 0;
-        rm_ScanIterator.slotNum = -1;
-        return 0;
+        // A reused iterator lets go of its previous scan, the new one keeps the table open until close()
+        rm_ScanIterator.close();
+        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
+        if (recordManager.openFile(tableName, rm_ScanIterator.handle) == -1)
+            return -1;
+        return recordManager.scan(rm_ScanIterator.handle, tableSchema, conditionAttribute, compOp, value, attributeNames,
+                                  rm_ScanIterator.rbfmScanner);
     }
 
     RM_ScanIterator::RM_ScanIterator() = default;
 
-    RM_ScanIterator::~RM_ScanIterator() = default;
+    RM_ScanIterator::~RM_ScanIterator() {
+        close();
+    }
 
     RC RM_ScanIterator::getNextTuple(RID &rid, void *data)
     {
-        FileHandle handle;
-        RecordBasedFileManager::instance().openFile(tableName, handle);
-        RBFM_ScanIterator rbfmScanner;
-        RecordBasedFileManager::instance().scan(handle, descriptor, conditionAttribute, compOp, value, attributeNames, rbfmScanner);
-        rbfmScanner.pageNum = pageNum;
-        rbfmScanner.slotNum = slotNum;
-        int end = rbfmScanner.getNextRecord(rid, data);
-        rbfmScanner.close();
-        RecordBasedFileManager::instance().closeFile(handle);
-        pageNum = rid.pageNum;
-        slotNum = rid.slotNum;
-        return end == RBFM_EOF ? RM_EOF : end;
+        if (!rbfmScanner.fileHandle.isOpen())
+            return RM_EOF;
+        return rbfmScanner.getNextRecord(rid, data) == RBFM_EOF ? RM_EOF : 0;
     }
 
     RC RM_ScanIterator::close()
     {
-        return 0;
+        if (!rbfmScanner.fileHandle.isOpen())
+            return 0;
+        rbfmScanner.close();
+        return RecordBasedFileManager::instance().closeFile(handle);
     }
 
     // QE IX related
@@ -354,6 +360,7 @@ namespace PeterDB {
         int insertSuccess = recordManager.insertRecord(rbfmHandle, getIndexesDescriptor(), data, rid);
         recordManager.closeFile(rbfmHandle);
         rbfmHandle = FileHandle();
+        invalidateCatalog(tableName);
 
         IndexManager &ixManager = IndexManager::instance();
         ixManager.createFile(filename);
@@ -380,14 +387,18 @@ namespace PeterDB {
         recordManager.openFile(tableName, rbfmHandle);
         recordManager.scan(rbfmHandle, tuplesDescriptor, "", EQ_OP, nullptr,
                            std::vector<std::string>(1, attributeName), rbfmScanner);
-        char recordData [dataSize];
-        while(rbfmScanner.getNextRecord(rid, recordData) != RBFM_EOF) {
-            if (((char *)recordData)[0] & (1 << 7))
-                continue; // ignore null records
-            char indexData [dataSize - 1];
-            std::memcpy(indexData, recordData + 1, dataSize - 1);
-            ixManager.insertEntry(ixHandle, attribute, indexData, rid);
-        }
+        std::vector<char> recordData(dataSize);
+        EntrySource entries = [&rbfmScanner, &recordData](RID &entryRid, void *key) {
+            while (rbfmScanner.getNextRecord(entryRid, recordData.data()) != RBFM_EOF) {
+                if (recordData[0] & (1 << 7))
+                    continue; // ignore null records
+                std::memcpy(key, recordData.data() + 1, recordData.size() - 1);
+                return 0;
+            }
+            return IX_EOF;
+        };
+        if (ixManager.bulkLoad(ixHandle, attribute, entries) == -1)
+            insertSuccess = -1;
 
         rbfmScanner.close();
         ixManager.closeFile(ixHandle);
@@ -410,6 +421,8 @@ namespace PeterDB {
             recordManager.openFile(INDEX_FILE_NAME, handle);
             recordManager.deleteRecord(handle, getIndexesDescriptor(), indexRids.at(i));
             recordManager.closeFile(handle);
+            invalidateCatalog(tableName);
+            closeCachedFile(fileToDelete);
             result = IndexManager::instance().destroyFile(fileToDelete);
             break;
         }
@@ -434,6 +447,37 @@ namespace PeterDB {
                                                         lowKeyInclusive, highKeyInclusive, rm_IndexScanIterator.ixScanner);
     }
 
+    RC RelationManager::getIOStatistics(const std::string &tableName, IOStatistics &statistics) {
+        RID tableRid;
+        if (getTableId(tableName, tableRid) == -1)
+            return -1;
+        vector<RID> indexRids;
+        vector<string> files = getIndexFiles(tableName, indexRids);
+        files.insert(files.begin(), tableName);
+        statistics = IOStatistics();
+        for (const string &file : files)
+            statistics.merge(BufferPool::instance().getStatistics(file));
+        return 0;
+    }
+
+    RC RelationManager::dumpIOStatistics(const std::string &tableName, std::string &json) {
+        RID tableRid;
+        if (getTableId(tableName, tableRid) == -1)
+            return -1;
+        vector<RID> indexRids;
+        vector<string> files = getIndexFiles(tableName, indexRids);
+        files.insert(files.begin(), tableName);
+        IOStatistics total;
+        string perFile;
+        for (const string &file : files) {
+            IOStatistics fileStatistics = BufferPool::instance().getStatistics(file);
+            total.merge(fileStatistics);
+            perFile += (perFile.empty() ? "\"" : ",\"") + file + "\":" + fileStatistics.toJson();
+        }
+        json = "{\"table\":\"" + tableName + "\",\"total\":" + total.toJson() + ",\"files\":{" + perFile + "}}";
+        return 0;
+    }
+
     // Extra credit work
     RC RelationManager::dropAttribute(const std::string &tableName, const std::string &attributeName) {
         return -1;
@@ -441,7 +485,26 @@ namespace PeterDB {
 
     // Extra credit work
     RC RelationManager::addAttribute(const std::string &tableName, const Attribute &attr) {
-        return -1;
+        const CatalogEntry *entry = getCatalogEntry(tableName);
+        if (nullptr == entry || entry->tableId <= 2)
+            return -1;
+        for (const Attribute &attribute : entry->attributes)
+            if (attribute.name == attr.name)
+                return -1;
+
+        // Tuples inserted before keep fewer fields, the new attribute reads as NULL for them
+        FileHandle handle;
+        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
+        if (recordManager.openFile(COLUMN_FILE_NAME, handle) == -1)
+            return -1;
+        char *data = (char *) malloc(COLUMN_RECORD_MAX_SIZE);
+        getColumnRecord(entry->tableId, attr, entry->attributes.size(), 0, data);
+        RID rid;
+        RC inserted = recordManager.insertRecord(handle, getColumnsDescriptor(), data, rid);
+        free(data);
+        recordManager.closeFile(handle);
+        invalidateCatalog(tableName);
+        return inserted;
     }
 
 
@@ -476,19 +539,20 @@ namespace PeterDB {
         schema.emplace_back("column-name");
         schema.emplace_back("column-type");
         schema.emplace_back("column-length");
+        schema.emplace_back("column-position");
         return schema;
     }
 
-    Attribute RelationManager::parseColumnAttribute(char* data) {
+    Attribute RelationManager::parseColumnAttribute(char* data, int &position) {
         int nameLength = 0;
         int copiedLength = 1; // Skip null byte since we should not have nulls in Columns table anyway
         CopyUtils::copyAttribute(data, &nameLength, copiedLength, sizeof(nameLength));
         char name [nameLength];
         CopyUtils::copyAttribute(data, name, copiedLength, nameLength);
-        int type, length, columnFlag;
+        int type, length;
         CopyUtils::copyAttribute(data, &type, copiedLength, sizeof(type));
         CopyUtils::copyAttribute(data, &length, copiedLength, sizeof(length));
-        CopyUtils::copyAttribute(data, &columnFlag, copiedLength, sizeof(columnFlag));
+        CopyUtils::copyAttribute(data, &position, copiedLength, sizeof(position));
 
         Attribute column;
         column.name = string (name);
@@ -559,6 +623,103 @@ namespace PeterDB {
     }
 
     int RelationManager::getTableId(const string &tableName, RID &tableRid) {
+        const CatalogEntry *entry = getCatalogEntry(tableName);
+        if (nullptr == entry)
+            return -1;
+        tableRid = entry->tableRid;
+        return entry->tableId;
+    }
+
+    std::vector<std::string> RelationManager::getIndexFiles(const string &tableName, std::vector<RID> &indexRids) {
+        const CatalogEntry *entry = getCatalogEntry(tableName);
+        if (nullptr == entry)
+            return std::vector<std::string>();
+        indexRids.insert(indexRids.end(), entry->indexRids.begin(), entry->indexRids.end());
+        return entry->indexFiles;
+    }
+
+    const CatalogEntry *RelationManager::getCatalogEntry(const string &tableName) {
+        auto cached = catalogCache.find(tableName);
+        if (cached != catalogCache.end())
+            return &cached->second;
+
+        // First use of the table since the catalog changed: one pass over each catalog file
+        CatalogEntry entry;
+        entry.tableId = scanTableId(tableName, entry.tableRid);
+        if (entry.tableId == -1)
+            return nullptr;
+        scanColumns(entry.tableId, entry.attributes);
+        entry.indexFiles = scanIndexFiles(entry.tableId, entry.indexRids);
+        return &(catalogCache[tableName] = std::move(entry));
+    }
+
+    void RelationManager::invalidateCatalog(const string &tableName) {
+        catalogCache.erase(tableName);
+    }
+
+    FileHandle *RelationManager::acquireFile(const string &tableName) {
+        CachedFile *file = acquireCached(tableName, false);
+        return nullptr == file ? nullptr : &file->handle;
+    }
+
+    IXFileHandle *RelationManager::acquireIndex(const string &fileName) {
+        CachedFile *file = acquireCached(fileName, true);
+        return nullptr == file ? nullptr : &file->ixHandle;
+    }
+
+    CachedFile *RelationManager::acquireCached(const string &fileName, bool index) {
+        auto cached = openFiles.find(fileName);
+        if (cached != openFiles.end()) {
+            recentlyUsed.splice(recentlyUsed.end(), recentlyUsed, cached->second.recentUse);
+            cached->second.users++;
+            return &cached->second;
+        }
+
+        CachedFile &file = openFiles[fileName];
+        RC opened = index ? IndexManager::instance().openFile(fileName, file.ixHandle)
+                          : RecordBasedFileManager::instance().openFile(fileName, file.handle);
+        if (opened == -1) {
+            openFiles.erase(fileName);
+            return nullptr;
+        }
+        file.recentUse = recentlyUsed.insert(recentlyUsed.end(), fileName);
+        file.users++;
+        evictCachedFiles();
+        return &file;
+    }
+
+    void RelationManager::releaseFile(const string &fileName) {
+        auto cached = openFiles.find(fileName);
+        if (cached != openFiles.end() && cached->second.users > 0)
+            cached->second.users--;
+    }
+
+    void RelationManager::closeCachedFile(const string &fileName) {
+        auto cached = openFiles.find(fileName);
+        if (cached == openFiles.end())
+            return;
+        // Only one of the two is open, closing the other does nothing
+        RecordBasedFileManager::instance().closeFile(cached->second.handle);
+        IndexManager::instance().closeFile(cached->second.ixHandle);
+        recentlyUsed.erase(cached->second.recentUse);
+        openFiles.erase(cached);
+    }
+
+    void RelationManager::closeCachedFiles() {
+        while (!recentlyUsed.empty())
+            closeCachedFile(recentlyUsed.front());
+    }
+
+    void RelationManager::evictCachedFiles() {
+        auto oldest = recentlyUsed.begin();
+        while (openFiles.size() > HANDLE_CACHE_SIZE && oldest != recentlyUsed.end()) {
+            const string &fileName = *oldest++;
+            if (openFiles.at(fileName).users == 0)
+                closeCachedFile(fileName);
+        }
+    }
+
+    int RelationManager::scanTableId(const string &tableName, RID &tableRid) {
         FileHandle handle;
         vector<Attribute> tablesDescriptor = getTablesDescriptor();
         RBFM_ScanIterator rbfmScanner;
@@ -585,13 +746,46 @@ namespace PeterDB {
         return tableId;
     }
 
-    std::vector<std::string> RelationManager::getIndexFiles(const string &tableName, std::vector<RID> &indexRids, int tableId) {
+    RC RelationManager::scanColumns(int tableId, std::vector<Attribute> &attrs) {
+        // Fetch attributes from columns
+        FileHandle handle;
+        char *tableFilter = (char *)malloc(sizeof(tableId));
+        makeTableIdFilter(tableId, tableFilter);
+        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
+        recordManager.openFile(COLUMN_FILE_NAME, handle);
+        RBFM_ScanIterator scanner;
+        recordManager.scan(handle, getColumnsDescriptor(), "table-id", EQ_OP, tableFilter, getAttributeSchema(), scanner);
+
+        RID rid;
+        char* data = (char*) malloc(COLUMN_RECORD_MAX_SIZE);
+        vector<std::pair<int, Attribute>> columns;
+        int position;
+        while (scanner.getNextRecord(rid, data) != RBFM_EOF) {
+            Attribute column = parseColumnAttribute(data, position);
+            columns.emplace_back(position, column);
+        }
+        scanner.close();
+        recordManager.closeFile(handle);
+        free(tableFilter);
+        free(data);
+
+        // A column added later can land in a slot freed before the table's other columns
+        std::stable_sort(columns.begin(), columns.end(),
+                         [](const std::pair<int, Attribute> &a, const std::pair<int, Attribute> &b) {
+            return a.first < b.first;
+        });
+        for (const std::pair<int, Attribute> &column : columns)
+            attrs.push_back(column.second);
+
+        return attrs.empty() ? -1 : 0;
+    }
+
+    std::vector<std::string> RelationManager::scanIndexFiles(int tableId, std::vector<RID> &indexRids) {
         std::vector<std::string> filenames;
         FileHandle handle;
         vector<Attribute> descriptor = getIndexesDescriptor();
         RBFM_ScanIterator rbfmScanner;
-        RID tableRid;
-        int tableFilter = tableId > 2 ? tableId : getTableId(tableName, tableRid);
+        int tableFilter = tableId;
         RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
         recordManager.openFile(INDEX_FILE_NAME, handle);
         recordManager.scan(handle, descriptor, "table-id", EQ_OP, &tableFilter,
@@ -646,13 +840,18 @@ namespace PeterDB {
     }
 
     void RelationManager::removeFromIndex(const std::string &tableName, const RID &rid) {
-        FileHandle handle;
-        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
-        std::vector<Attribute> tupleDescriptor;
-        getAttributes(tableName, tupleDescriptor, false);
         IndexManager &ixManager = IndexManager::instance();
         vector<RID> indexRids;
         std::vector<std::string> indexFiles = getIndexFiles(tableName, indexRids);
+        if (indexFiles.empty())
+            return;
+
+        RecordBasedFileManager &recordManager = RecordBasedFileManager::instance();
+        std::vector<Attribute> tupleDescriptor;
+        getAttributes(tableName, tupleDescriptor, false);
+        FileHandle *handle = acquireFile(tableName);
+        if (nullptr == handle)
+            return;
         // Remove from index if present
         for (int i = 0; i < tupleDescriptor.size(); ++i) {
             Attribute attribute = tupleDescriptor.at(i);
@@ -667,19 +866,21 @@ namespace PeterDB {
                     keyReadSize += sizeof(int);
                 }
                 char columnValue [keyReadSize];
-                recordManager.readAttribute(handle, tupleDescriptor, rid, attribute.name, columnValue);
-                if ((columnValue)[0] & (1 << 7))
-                    continue;
+                if (recordManager.readAttribute(*handle, tupleDescriptor, rid, attribute.name, columnValue) == -1
+                    || columnValue[0] != 0)
+                    continue;   // gone, or NULL and so never indexed
 
                 // Get attribute value
                 char key [keyReadSize - 1];
                 std::memcpy(key, columnValue + 1, keyReadSize - 1);
-                IXFileHandle ixHandle;
-                ixManager.openFile(index, ixHandle);
-                ixManager.deleteEntry(ixHandle, attribute, key, rid);
-                ixManager.closeFile(ixHandle);
+                IXFileHandle *ixHandle = acquireIndex(index);
+                if (nullptr == ixHandle)
+                    continue;
+                ixManager.deleteEntry(*ixHandle, attribute, key, rid);
+                releaseFile(index);
             }
         }
+        releaseFile(tableName);
     }
 
     void RelationManager::addToIndex(const string &tableName, const RID &rid, const void *data) {
@@ -717,13 +918,68 @@ namespace PeterDB {
                     std::memcpy(key, &fieldLength, sizeof(fieldLength));
                     copiedLength += sizeof(fieldLength);
                 }
-                IXFileHandle ixHandle;
                 std::memcpy(key + copiedLength, (char *)data + seenLength, fieldLength);
-                ixManager.openFile(index, ixHandle);
-                ixManager.insertEntry(ixHandle, attribute, key, rid);
-                ixManager.closeFile(ixHandle);
+                IXFileHandle *ixHandle = acquireIndex(index);
+                if (nullptr == ixHandle)
+                    continue;
+                ixManager.insertEntry(*ixHandle, attribute, key, rid);
+                releaseFile(index);
+            }
+        }
+    }
+
+    void RelationManager::addToIndexes(const string &tableName, const vector<Attribute> &tupleDescriptor,
+                                       const vector<const void *> &tuples, const vector<RID> &rids) {
+        IndexManager &ixManager = IndexManager::instance();
+        vector<RID> indexRids;
+        std::vector<std::string> indexFiles = getIndexFiles(tableName, indexRids);
+        for (const std::string &index : indexFiles) {
+            int column = 0;
+            while (column < tupleDescriptor.size() && getIndexFileName(tableName, tupleDescriptor[column].name) != index)
+                column++;
+            if (column == tupleDescriptor.size())
+                continue;
+            const Attribute &attribute = tupleDescriptor[column];
+
+            // Keys in tuple format are already in index key format, point at them instead of copying
+            std::vector<std::pair<const char *, RID>> entries;
+            entries.reserve(tuples.size());
+            for (int i = 0; i < tuples.size(); ++i) {
+                const char *key = fieldValue(tupleDescriptor, tuples[i], column);
+                if (nullptr != key)
+                    entries.emplace_back(key, rids[i]);
+            }
+            // In key order consecutive inserts walk down to the same or the next leaf
+            std::stable_sort(entries.begin(), entries.end(),
+                             [&attribute](const std::pair<const char *, RID> &lhs, const std::pair<const char *, RID> &rhs) {
+                                 return CompareUtils::compare(attribute.type, lhs.first, rhs.first) < 0;
+                             });
+
+            IXFileHandle *ixHandle = acquireIndex(index);
+            if (nullptr == ixHandle)
+                continue;
+            for (const std::pair<const char *, RID> &entry : entries)
+                ixManager.insertEntry(*ixHandle, attribute, entry.first, entry.second);
+            releaseFile(index);
+        }
+    }
+
+    const char *RelationManager::fieldValue(const vector<Attribute> &tupleDescriptor, const void *data, int column) {
+        const char *bytes = (const char *) data;
+        if (bytes[column / 8] & (1 << (7 - column % 8)))
+            return nullptr;
+        int offset = ceil(((float) tupleDescriptor.size()) / 8);
+        for (int i = 0; i < column; ++i) {
+            if (bytes[i / 8] & (1 << (7 - i % 8)))
+                continue;
+            int fieldLength = tupleDescriptor[i].length;
+            if (TypeVarChar == tupleDescriptor[i].type) {
+                std::memcpy(&fieldLength, bytes + offset, sizeof(int));
+                fieldLength += sizeof(int);
             }
+            offset += fieldLength;
         }
+        return bytes + offset;
     }
 
     std::string RelationManager::getIndexFileName(const string &tableName, const string &columnName) {
@@ -5,91 +5,138 @@
 #ifndef PETERDB_COMPARE_UTILS_H
 #define PETERDB_COMPARE_UTILS_H
 #include <cstring>
+#include <algorithm>
 #include "parse_utils.h"
 #include <src/include/rbfm.h>
 
 using namespace std;
 
 namespace PeterDB {
+    // Three-way order of two raw values: negative, zero or positive like memcmp
+    template<AttrType type> struct RawOrder;
+
+    template<> struct RawOrder<TypeInt> {
+        static int compare(const char *lhs, int, const char *rhs, int) {
+            int n1, n2;
+            std::memcpy(&n1, lhs, sizeof(int));
+            std::memcpy(&n2, rhs, sizeof(int));
+            return (n1 > n2) - (n1 < n2);
+        }
+    };
+
+    template<> struct RawOrder<TypeReal> {
+        static int compare(const char *lhs, int, const char *rhs, int) {
+            float f1, f2;
+            std::memcpy(&f1, lhs, sizeof(float));
+            std::memcpy(&f2, rhs, sizeof(float));
+            return (f1 > f2) - (f1 < f2);
+        }
+    };
+
+    template<> struct RawOrder<TypeVarChar> {
+        static int compare(const char *lhs, int lhsLength, const char *rhs, int rhsLength) {
+            // Same order as std::string: bytes compare unsigned, a prefix sorts first
+            int order = std::memcmp(lhs, rhs, std::min(lhsLength, rhsLength));
+            return order != 0 ? order : (lhsLength > rhsLength) - (lhsLength < rhsLength);
+        }
+    };
+
+    template<CompOp op> struct OrderHolds;
+    template<> struct OrderHolds<EQ_OP> { static bool check(int order) { return order == 0; } };
+    template<> struct OrderHolds<LT_OP> { static bool check(int order) { return order < 0; } };
+    template<> struct OrderHolds<LE_OP> { static bool check(int order) { return order <= 0; } };
+    template<> struct OrderHolds<GT_OP> { static bool check(int order) { return order > 0; } };
+    template<> struct OrderHolds<GE_OP> { static bool check(int order) { return order >= 0; } };
+    template<> struct OrderHolds<NE_OP> { static bool check(int order) { return order != 0; } };
+
+    template<AttrType type, CompOp op>
+    bool compareRaw(const char *lhs, int lhsLength, const char *rhs, int rhsLength) {
+        return OrderHolds<op>::check(RawOrder<type>::compare(lhs, lhsLength, rhs, rhsLength));
+    }
+
     class CompareUtils {
     public:
-        static bool check(AttrType type, CompOp op, const void *lhs, const void *rhs) {
-            switch (op) {
-                case EQ_OP:
-                    return checkEqual(type, lhs, rhs);
-                case LT_OP:
-                    return checkLessThan(type, lhs, rhs);
-                case LE_OP:
-                    return checkLessThan(type, lhs, rhs) || checkEqual(type, lhs, rhs);
-                case GT_OP:
-                    return checkGreaterThan(type, lhs, rhs);
-                case GE_OP:
-                    return checkGreaterThan(type, lhs, rhs) || checkEqual(type, lhs, rhs);
-                case NE_OP:
-                    return !checkEqual(type, lhs, rhs);
-                case NO_OP:
-                    return true;
+        // Resolves the comparison once, calling the result is a couple of loads (or a memcmp) and one compare
+        static RawComparator compile(AttrType type, CompOp op) {
+            switch (type) {
+                case TypeInt:
+                    return compile<TypeInt>(op);
+                case TypeReal:
+                    return compile<TypeReal>(op);
+                case TypeVarChar:
+                    return compile<TypeVarChar>(op);
             }
+            return matchAll;
         }
 
-        static bool checkEqual(AttrType type, const void *lhs, const void *rhs) {
-            if (TypeVarChar == type) {
-                string s1 = ParseUtils::parseVarchar(const_cast<void *>(lhs));
-                string s2 = ParseUtils::parseVarchar(const_cast<void *>(rhs));
-                return s1 == s2;
+        // Splits a value in the usual format (varchar with its 4 byte length first) into raw bytes and length
+        static const char *rawValue(AttrType type, const void *value, int &length) {
+            if (TypeVarChar != type) {
+                length = sizeof(int);
+                return (const char *) value;
             }
+            std::memcpy(&length, value, sizeof(int));
+            return (const char *) value + sizeof(int);
+        }
 
-            if (TypeInt == type) {
-                int n1, n2;
-                std::memcpy(&n1, lhs, sizeof(int));
-                std::memcpy(&n2, rhs, sizeof(int));
-                return n1 == n2;
+        static int compare(AttrType type, const void *lhs, const void *rhs) {
+            int lhsLength, rhsLength;
+            const char *lhsBytes = rawValue(type, lhs, lhsLength);
+            const char *rhsBytes = rawValue(type, rhs, rhsLength);
+            switch (type) {
+                case TypeInt:
+                    return RawOrder<TypeInt>::compare(lhsBytes, lhsLength, rhsBytes, rhsLength);
+                case TypeReal:
+                    return RawOrder<TypeReal>::compare(lhsBytes, lhsLength, rhsBytes, rhsLength);
+                case TypeVarChar:
+                    return RawOrder<TypeVarChar>::compare(lhsBytes, lhsLength, rhsBytes, rhsLength);
             }
-
-            float f1, f2;
-            std::memcpy(&f1, lhs, sizeof(float));
-            std::memcpy(&f2, rhs, sizeof(float));
-            return f1 == f2;
+            return 0;
         }
 
-        static bool checkLessThan(AttrType type, const void *lhs, const void *rhs) {
-            if (TypeVarChar == type) {
-                string s1 = ParseUtils::parseVarchar(const_cast<void *>(lhs));
-                string s2 = ParseUtils::parseVarchar(const_cast<void *>(rhs));
-                return s1 < s2;
-            }
+        static bool check(AttrType type, CompOp op, const void *lhs, const void *rhs) {
+            int lhsLength, rhsLength;
+            const char *lhsBytes = rawValue(type, lhs, lhsLength);
+            const char *rhsBytes = rawValue(type, rhs, rhsLength);
+            return compile(type, op)(lhsBytes, lhsLength, rhsBytes, rhsLength);
+        }
 
-            if (TypeInt == type) {
-                int n1, n2;
-                std::memcpy(&n1, lhs, sizeof(int));
-                std::memcpy(&n2, rhs, sizeof(int));
-                return n1 < n2;
-            }
+        static bool checkEqual(AttrType type, const void *lhs, const void *rhs) {
+            return compare(type, lhs, rhs) == 0;
+        }
 
-            float f1, f2;
-            std::memcpy(&f1, lhs, sizeof(float));
-            std::memcpy(&f2, rhs, sizeof(float));
-            return f1 < f2;
+        static bool checkLessThan(AttrType type, const void *lhs, const void *rhs) {
+            return compare(type, lhs, rhs) < 0;
         }
 
         static bool checkGreaterThan(AttrType type, const void *lhs, const void *rhs) {
-            if (TypeVarChar == type) {
-                string s1 = ParseUtils::parseVarchar(const_cast<void *>(lhs));
-                string s2 = ParseUtils::parseVarchar(const_cast<void *>(rhs));
-                return s1 > s2;
-            }
+            return compare(type, lhs, rhs) > 0;
+        }
 
-            if (TypeInt == type) {
-                int n1, n2;
-                std::memcpy(&n1, lhs, sizeof(int));
-                std::memcpy(&n2, rhs, sizeof(int));
-                return n1 > n2;
+    private:
+        template<AttrType type>
+        static RawComparator compile(CompOp op) {
+            switch (op) {
+                case EQ_OP:
+                    return compareRaw<type, EQ_OP>;
+                case LT_OP:
+                    return compareRaw<type, LT_OP>;
+                case LE_OP:
+                    return compareRaw<type, LE_OP>;
+                case GT_OP:
+                    return compareRaw<type, GT_OP>;
+                case GE_OP:
+                    return compareRaw<type, GE_OP>;
+                case NE_OP:
+                    return compareRaw<type, NE_OP>;
+                case NO_OP:
+                    break;
             }
+            return matchAll;
+        }
 
-            float f1, f2;
-            std::memcpy(&f1, lhs, sizeof(float));
-            std::memcpy(&f2, rhs, sizeof(float));
-            return f1 > f2;
+        static bool matchAll(const char *, int, const char *, int) {
+            return true;
         }
     };
 }
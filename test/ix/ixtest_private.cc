@@ -0,0 +1,616 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+
+#include "src/include/ix.h"
+#include "test/utils/ix_test_utils.h"
+
+namespace PeterDBTesting {
+    class IX_Private_Test : public IX_Test {
+    protected:
+        // Replaces the index file with an empty one, for tests that build several indexes in turn
+        void recreateIndex() {
+            ASSERT_EQ(ix.closeFile(ixFileHandle), success) << "indexManager::closeFile() should succeed.";
+            ASSERT_EQ(ix.destroyFile(indexFileName), success) << "indexManager::destroyFile() should succeed.";
+            ASSERT_EQ(ix.createFile(indexFileName), success) << "indexManager::createFile() should succeed.";
+            ixFileHandle = PeterDB::IXFileHandle();
+            ASSERT_EQ(ix.openFile(indexFileName, ixFileHandle), success) << "indexManager::openFile() should succeed.";
+        }
+
+        // Thread t inserts the keys k with k % threadCount == t, then deletes the odd ones of them, scanning its own
+        // range after every few changes and checking that it sees exactly what it has inserted and not deleted yet
+        void runMixedWorkload(unsigned threadCount, int keysPerThread, std::atomic<int> &errors) {
+            std::vector<std::thread> workers;
+            for (unsigned t = 0; t < threadCount; t++) {
+                workers.emplace_back([this, t, threadCount, keysPerThread, &errors] {
+                    PeterDB::RID entryRid;
+                    for (int i = 0; i < keysPerThread; i++) {
+                        int key = i * (int) threadCount + (int) t;
+                        entryRid.pageNum = key;
+                        entryRid.slotNum = key % SHRT_MAX;
+                        if (ix.insertEntry(ixFileHandle, ageAttr, &key, entryRid) != success)
+                            errors++;
+                        if (i % 100 == 99 && countOwnKeys(t, threadCount, key) != i + 1)
+                            errors++;
+                    }
+                    for (int i = 1; i < keysPerThread; i += 2) {
+                        int key = i * (int) threadCount + (int) t;
+                        entryRid.pageNum = key;
+                        entryRid.slotNum = key % SHRT_MAX;
+                        if (ix.deleteEntry(ixFileHandle, ageAttr, &key, entryRid) != success)
+                            errors++;
+                    }
+                });
+            }
+            for (std::thread &worker : workers)
+                worker.join();
+        }
+
+        int countOwnKeys(unsigned t, unsigned threadCount, int highKey) {
+            PeterDB::IX_ScanIterator iterator;
+            int lowKey = (int) t;
+            if (ix.scan(ixFileHandle, ageAttr, &lowKey, &highKey, true, true, iterator) != success)
+                return -1;
+            PeterDB::RID entryRid;
+            int key, count = 0;
+            while (iterator.getNextEntry(entryRid, &key) != IX_EOF)
+                if (key % (int) threadCount == (int) t)
+                    count++;
+            iterator.close();
+            return count;
+        }
+    };
+
+    TEST_F(IX_Private_Test, concurrent_insert_delete_scan) {
+        // Functions Tested:
+        // 1. insertEntry() - from several threads through one handle, with leaf and root splits
+        // 2. scan() - from the same threads while the others insert
+        // 3. deleteEntry() - from several threads
+        // 4. scan() - sees every entry left exactly once and in order
+
+        unsigned threadCount = 8;
+        int keysPerThread = 2000;
+        std::atomic<int> errors(0);
+        runMixedWorkload(threadCount, keysPerThread, errors);
+        ASSERT_EQ(errors, 0) << "Every insert, delete and scan should succeed and see the entries of its thread.";
+
+        int expected = 0;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, NULL, NULL, true, true, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        int key;
+        while (ix_ScanIterator.getNextEntry(rid, &key) != IX_EOF) {
+            ASSERT_EQ(key, expected) << "Keys should come back in order, once each.";
+            ASSERT_EQ(rid.pageNum, key) << "returned pageNum does not match inserted.";
+            // The next key left is in the next even round of inserts
+            expected = (key / (int) threadCount) % 2 == 0 && key % (int) threadCount != (int) threadCount - 1
+                       ? key + 1 : (key / (int) threadCount + 2) * (int) threadCount;
+        }
+        ASSERT_EQ(expected, keysPerThread * (int) threadCount) << "Every entry not deleted should be found.";
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+    }
+
+    TEST_F(IX_Private_Test, concurrent_workload_scaling) {
+        // Functions Tested:
+        // 1. insertEntry(), deleteEntry(), scan() - the mixed workload from 1 thread up to the core count, into a fresh
+        //    index each time. Prints the throughput, the entries must come out right at every thread count.
+
+        unsigned maxThreads = std::max(2u, std::thread::hardware_concurrency());
+        int entries = 16000;
+        for (unsigned threadCount = 1; threadCount <= maxThreads; threadCount *= 2) {
+            recreateIndex();
+
+            std::atomic<int> errors(0);
+            int keysPerThread = entries / (int) threadCount;
+            auto started = std::chrono::steady_clock::now();
+            runMixedWorkload(threadCount, keysPerThread, errors);
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            ASSERT_EQ(errors, 0) << "Every insert, delete and scan should succeed and see the entries of its thread.";
+            LOG(INFO) << threadCount << " thread(s): "
+                      << (int) (threadCount * (keysPerThread + keysPerThread / 2) / seconds)
+                      << " inserts and deletes per second" << std::endl;
+        }
+    }
+
+    TEST_F(IX_Private_Test, point_lookups_per_key_type) {
+        // Functions Tested:
+        // 1. insertEntry() - int, real and varchar keys in scrambled order
+        // 2. scan() - one equality lookup per key, each finds its entry. Prints the lookups per second of each type.
+
+        int entries = 20000;
+        std::vector<PeterDB::Attribute> attributes = { ageAttr, heightAttr, empNameAttr };
+        for (const PeterDB::Attribute &attribute : attributes) {
+            recreateIndex();
+
+            char key[PAGE_SIZE];
+            auto prepareKey = [&attribute, &key](int value) {
+                if (PeterDB::TypeInt == attribute.type) {
+                    memcpy(key, &value, sizeof(value));
+                } else if (PeterDB::TypeReal == attribute.type) {
+                    float real = value * 0.5f;
+                    memcpy(key, &real, sizeof(real));
+                } else {
+                    std::string name = "employee_" + std::to_string(value);
+                    unsigned length = name.size();
+                    memcpy(key, &length, sizeof(length));
+                    memcpy(key + sizeof(length), name.data(), length);
+                }
+            };
+            for (int i = 0; i < entries; i++) {
+                int value = (int) (i * 7919L % entries);
+                prepareKey(value);
+                rid.pageNum = value;
+                rid.slotNum = value % SHRT_MAX;
+                ASSERT_EQ(ix.insertEntry(ixFileHandle, attribute, key, rid), success)
+                                            << "indexManager::insertEntry() should succeed.";
+            }
+
+            char returnedKey[PAGE_SIZE];
+            auto started = std::chrono::steady_clock::now();
+            for (int i = 0; i < entries; i++) {
+                int value = (int) (i * 104729L % entries);
+                prepareKey(value);
+                ASSERT_EQ(ix.scan(ixFileHandle, attribute, key, key, true, true, ix_ScanIterator), success)
+                                            << "indexManager::scan() should succeed.";
+                ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, returnedKey), success) << "The key should be found.";
+                ASSERT_EQ(rid.pageNum, value) << "returned pageNum does not match inserted.";
+                ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, returnedKey), IX_EOF) << "The key should be found once.";
+                ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+            }
+            double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+            LOG(INFO) << attribute.name << ": " << (int) (entries / seconds) << " lookups per second" << std::endl;
+        }
+    }
+
+    TEST_F(IX_Private_Test, varchar_keys_sharing_prefixes) {
+        // Functions Tested:
+        // 1. insertEntry() - URL keys sharing a long prefix, in scrambled order, plus keys that cut the prefix short
+        // 2. the leaves keep the shared prefix once, the index takes fewer pages than the keys do in full
+        // 3. deleteEntry() - every other key
+        // 4. scan() - all and a range, the full keys come back in order
+
+        int entries = 5000 * (PAGE_SIZE / 4096);     // the same number of leaves at any page size
+        std::string prefix = "https://example.com/catalog/item/";
+        std::vector<std::string> names;
+        for (int i = 0; i < entries; i++) {
+            std::string number = std::to_string(100000 + i);
+            names.push_back(i % 1000 == 999 ? prefix.substr(0, i / 1000 * 5) : prefix + number);
+        }
+        auto prepareKey = [&names](int i, char *key) {
+            unsigned length = names[i].size();
+            memcpy(key, &length, sizeof(length));
+            memcpy(key + sizeof(length), names[i].data(), length);
+        };
+
+        char key[PAGE_SIZE];
+        size_t keyBytes = 0;
+        for (int i = 0; i < entries; i++) {
+            int value = (int) (i * 7919L % entries);
+            prepareKey(value, key);
+            keyBytes += names[value].size() + sizeof(PeterDB::RID::pageNum) + sizeof(PeterDB::RID::slotNum);
+            rid.pageNum = value;
+            rid.slotNum = value % SHRT_MAX;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, empNameAttr, key, rid), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+        ASSERT_LT(ixFileHandle.getPageCount() * PAGE_SIZE, keyBytes)
+                                    << "The index should take less room than its keys in full.";
+
+        for (int i = 0; i < entries; i += 2) {
+            prepareKey(i, key);
+            rid.pageNum = i;
+            rid.slotNum = i % SHRT_MAX;
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, empNameAttr, key, rid), success)
+                                        << "indexManager::deleteEntry() should succeed.";
+        }
+
+        std::vector<std::pair<std::string, int>> expected;
+        for (int i = 1; i < entries; i += 2)
+            expected.emplace_back(names[i], i);
+        std::sort(expected.begin(), expected.end());
+        char lowKey[PAGE_SIZE], highKey[PAGE_SIZE];
+        prepareKey(1001, lowKey);
+        prepareKey(3001, highKey);
+        std::vector<std::pair<std::string, int>> inRange;
+        for (const std::pair<std::string, int> &entry : expected)
+            if (entry.first >= names[1001] && entry.first < names[3001])
+                inRange.push_back(entry);
+
+        for (bool ranged : { false, true }) {
+            const std::vector<std::pair<std::string, int>> &wanted = ranged ? inRange : expected;
+            ASSERT_EQ(ix.scan(ixFileHandle, empNameAttr, ranged ? lowKey : NULL, ranged ? highKey : NULL, true, false,
+                              ix_ScanIterator), success) << "indexManager::scan() should succeed.";
+            int found = 0;
+            while (ix_ScanIterator.getNextEntry(rid, key) != IX_EOF) {
+                ASSERT_LT(found, wanted.size()) << "The scan should end after the last entry left.";
+                unsigned length;
+                memcpy(&length, key, sizeof(length));
+                ASSERT_EQ(std::string(key + sizeof(length), length), wanted[found].first)
+                                            << "Keys should come back in full and in order.";
+                ASSERT_EQ(rid.pageNum, wanted[found].second) << "returned pageNum does not match inserted.";
+                found++;
+            }
+            ASSERT_EQ(found, wanted.size()) << "Every entry left should be found.";
+            ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        }
+    }
+
+    TEST_F(IX_Private_Test, bulk_load_merges_runs_at_fill_factor) {
+        // Functions Tested:
+        // 1. bulkLoad() - scrambled entries with a small run size, so they are sorted in several runs and merged
+        // 2. printBTree() - leaves filled to half of what a full load puts in them, but the last one
+        // 3. scan() - every entry comes back once, in key order
+
+        int entries = 20000;
+        size_t runSize = 16 * 1024;     // about a dozen runs of 10 byte entries
+        auto loadLeaves = [&](float fillFactor, std::vector<unsigned> &leafSizes) {
+            recreateIndex();
+
+            int next = 0;
+            PeterDB::EntrySource source = [&next, entries](PeterDB::RID &entryRid, void *key) {
+                if (next == entries)
+                    return IX_EOF;
+                int value = (int) (next++ * 7919L % entries);
+                memcpy(key, &value, sizeof(value));
+                entryRid.pageNum = value;
+                entryRid.slotNum = value % 50;
+                return 0;
+            };
+            ASSERT_EQ(ix.bulkLoad(ixFileHandle, ageAttr, source, fillFactor, runSize), success)
+                                        << "indexManager::bulkLoad() should succeed.";
+            ASSERT_FALSE(PeterDB::FileHandle::exists(indexFileName + ".run0")) << "The runs should be removed.";
+
+            std::stringstream stream;
+            ASSERT_EQ(ix.printBTree(ixFileHandle, ageAttr, stream), success)
+                                        << "indexManager::printBTree() should succeed.";
+            nlohmann::ordered_json j;
+            stream >> j;
+            std::vector<TreeNode> nodes = { buildTree(j) };
+            while (!nodes.empty()) {
+                TreeNode node = nodes.front();
+                nodes.erase(nodes.begin());
+                if (node.childrenCount() == 0)
+                    leafSizes.push_back(node.keyCount());
+                nodes.insert(nodes.end(), node.children.begin(), node.children.end());
+            }
+        };
+
+        std::vector<unsigned> fullLeaves, halfLeaves;
+        loadLeaves(1.0f, fullLeaves);
+        loadLeaves(0.5f, halfLeaves);
+        ASSERT_GT(fullLeaves.size(), 2) << "The full load should take several leaves.";
+        unsigned fullSize = *std::max_element(fullLeaves.begin(), fullLeaves.end());
+        for (size_t i = 0; i + 1 < halfLeaves.size(); i++) {
+            EXPECT_GE(halfLeaves[i], fullSize * 0.4) << "A leaf should be filled to about half.";
+            EXPECT_LE(halfLeaves[i], fullSize * 0.6) << "A leaf should be filled to about half.";
+        }
+
+        int low = 0, returnedKey, found = 0;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &low, nullptr, true, true, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        while (ix_ScanIterator.getNextEntry(rid, &returnedKey) != IX_EOF) {
+            ASSERT_EQ(returnedKey, found) << "Keys should come back in order, each once.";
+            ASSERT_EQ(rid.pageNum, found) << "returned pageNum does not match loaded.";
+            found++;
+        }
+        ASSERT_EQ(found, entries) << "Every loaded entry should be found.";
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+    }
+
+    TEST_F(IX_Private_Test, lookups_and_scan_at_page_size) {
+        // Functions Tested:
+        // 1. insertEntry() - scrambled int keys
+        // 2. scan() - one equality lookup per key, then one scan over the whole index
+        // Prints the pages, lookups and scanned entries per second at this build's PAGE_SIZE. test/page_size_benchmark.sh
+        // runs it in a build per page size to compare them.
+
+        int entries = 200000;
+        for (int i = 0; i < entries; i++) {
+            int key = (int) (i * 7919L % entries);
+            rid.pageNum = key;
+            rid.slotNum = key % SHRT_MAX;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+
+        int key, returnedKey;
+        auto started = std::chrono::steady_clock::now();
+        for (int i = 0; i < entries; i++) {
+            key = (int) (i * 104729L % entries);
+            ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &key, &key, true, true, ix_ScanIterator), success)
+                                        << "indexManager::scan() should succeed.";
+            ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, &returnedKey), success) << "The key should be found.";
+            ASSERT_EQ(rid.pageNum, key) << "returned pageNum does not match inserted.";
+            ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        }
+        double lookupSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+
+        int found = 0;
+        started = std::chrono::steady_clock::now();
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, nullptr, nullptr, true, true, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        while (ix_ScanIterator.getNextEntry(rid, &returnedKey) != IX_EOF)
+            found++;
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        double scanSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - started).count();
+        ASSERT_EQ(found, entries) << "Every inserted entry should be found.";
+
+        LOG(INFO) << "PAGE_SIZE " << PAGE_SIZE << ": " << ixFileHandle.getPageCount() << " pages, "
+                  << (int) (entries / lookupSeconds) << " lookups per second, "
+                  << (int) (entries / scanSeconds) << " scanned entries per second" << std::endl;
+    }
+
+    TEST_F(IX_Private_Test, reject_other_format_version) {
+        // Functions Tested:
+        // 1. the header records the page size and the node format the file was written with
+        // 2. openFile() - fails once the recorded format is changed on disk
+
+        std::string otherFileName = "ix_private_test_format_version";
+        ASSERT_EQ(ix.createFile(otherFileName), success) << "indexManager::createFile() should succeed.";
+        int header[5] = { 0, 0, 0, 0, 0 };
+        std::fstream file(otherFileName, std::ios::in | std::ios::out | std::ios::binary);
+        file.read(reinterpret_cast<char *>(header), sizeof(header));
+        ASSERT_EQ(header[3], PAGE_SIZE) << "The header should record the page size.";
+        ASSERT_EQ(header[4], IX_FORMAT_VERSION) << "The header should record the format version.";
+
+        header[4] = IX_FORMAT_VERSION + 1;
+        file.seekp(0);
+        file.write(reinterpret_cast<char *>(header), sizeof(header));
+        file.close();
+        PeterDB::IXFileHandle otherHandle;
+        ASSERT_EQ(ix.openFile(otherFileName, otherHandle), -1)
+                                    << "indexManager::openFile() should fail for another format version.";
+        ASSERT_EQ(ix.destroyFile(otherFileName), success) << "indexManager::destroyFile() should succeed.";
+    }
+
+    TEST_F(IX_Private_Test, duplicate_keys_share_posting_lists) {
+        // Functions Tested:
+        // 1. insertEntry() - a few keys, thousands of RIDs each in scrambled order, enough to go to posting pages
+        // 2. each key is kept once, the index takes far less room than one entry per RID would
+        // 3. deleteEntry() - every other RID, and one the index does not have
+        // 4. scan() - one equality lookup per key, its RIDs come back in order
+
+        int entries = 20000 * (PAGE_SIZE / 4096), keyCount = 4;     // the same number of pages at any page size
+        auto ridOf = [entries](int i) {
+            PeterDB::RID entryRid;
+            entryRid.pageNum = (unsigned) (i * 7919L % entries);
+            entryRid.slotNum = (unsigned short) (i % 50);
+            return entryRid;
+        };
+        for (int i = 0; i < entries; i++) {
+            int key = i % keyCount;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, ridOf(i)), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+        size_t entryBytes = entries * (sizeof(int) + sizeof(PeterDB::RID::pageNum) + sizeof(PeterDB::RID::slotNum));
+        ASSERT_LT(ixFileHandle.getPageCount() * PAGE_SIZE, entryBytes / 2)
+                                    << "The index should take less than half the room of an entry per RID.";
+
+        for (int i = 0; i < entries; i += 2) {
+            int key = i % keyCount;
+            ASSERT_EQ(ix.deleteEntry(ixFileHandle, ageAttr, &key, ridOf(i)), success)
+                                        << "indexManager::deleteEntry() should succeed.";
+        }
+        int key = 1;
+        rid.pageNum = entries;
+        rid.slotNum = 0;
+        ASSERT_NE(ix.deleteEntry(ixFileHandle, ageAttr, &key, rid), success)
+                                    << "indexManager::deleteEntry() should fail for a RID not in the index.";
+
+        for (key = 0; key < keyCount; key++) {
+            std::vector<std::pair<unsigned, unsigned short>> expected;
+            for (int i = 1; i < entries; i += 2)
+                if (i % keyCount == key)
+                    expected.emplace_back(ridOf(i).pageNum, ridOf(i).slotNum);
+            std::sort(expected.begin(), expected.end());
+
+            ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &key, &key, true, true, ix_ScanIterator), success)
+                                        << "indexManager::scan() should succeed.";
+            int returnedKey, found = 0;
+            while (ix_ScanIterator.getNextEntry(rid, &returnedKey) != IX_EOF) {
+                ASSERT_LT(found, expected.size()) << "The scan should end after the last RID of the key.";
+                ASSERT_EQ(returnedKey, key) << "key does not match.";
+                ASSERT_EQ(std::make_pair(rid.pageNum, rid.slotNum), expected[found])
+                                            << "RIDs should come back in order, the deleted ones gone.";
+                found++;
+            }
+            ASSERT_EQ(found, expected.size()) << "Every RID left should be found.";
+            ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        }
+    }
+
+    TEST_F(IX_Private_Test, interleaved_scans_share_node_cache) {
+        // Functions Tested:
+        // 1. insertEntry() - scrambled int keys
+        // 2. scan() - one scan over a range alone, then two scans over it advanced in turns
+        // 3. each scan keeps its own leaf, the nodes come from the cache and the buffer pool without a miss
+
+        int entries = 20000, lowKey = 5000, highKey = 15000;
+        for (int i = 0; i < entries; i++) {
+            int key = (int) (i * 7919L % entries);
+            rid.pageNum = key;
+            rid.slotNum = key % SHRT_MAX;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+
+        unsigned hits, misses, hitsAfter, missesAfter;
+        ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hits, misses), success)
+                                    << "IXFileHandle::collectCacheCounterValues() should succeed.";
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &lowKey, &highKey, true, false, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        int key, expected = lowKey;
+        while (ix_ScanIterator.getNextEntry(rid, &key) != IX_EOF)
+            ASSERT_EQ(key, expected++) << "key does not match.";
+        ASSERT_EQ(expected, highKey) << "Every key in the range should be found.";
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hitsAfter, missesAfter), success)
+                                    << "IXFileHandle::collectCacheCounterValues() should succeed.";
+        unsigned oneScan = hitsAfter - hits;
+        ASSERT_GT(oneScan, 0) << "The scan should read its nodes from the caches.";
+        ASSERT_EQ(missesAfter, misses) << "The inserts left every page in the buffer pool.";
+
+        PeterDB::IX_ScanIterator other;
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &lowKey, &highKey, true, false, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, &lowKey, &highKey, true, false, other), success)
+                                    << "indexManager::scan() should succeed.";
+        int otherKey, otherExpected = lowKey;
+        expected = lowKey;
+        while (expected < highKey || otherExpected < highKey) {
+            // The first scan takes two steps for each one of the other, so they are on different leaves most of the time
+            for (int step = 0; step < 2 && expected < highKey; step++) {
+                ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, &key), success) << "The first scan should go on.";
+                ASSERT_EQ(key, expected++) << "key does not match.";
+            }
+            if (otherExpected < highKey) {
+                ASSERT_EQ(other.getNextEntry(rid, &otherKey), success) << "The other scan should go on.";
+                ASSERT_EQ(otherKey, otherExpected++) << "key does not match.";
+            }
+        }
+        ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, &key), IX_EOF) << "The first scan should end with the range.";
+        ASSERT_EQ(other.getNextEntry(rid, &otherKey), IX_EOF) << "The other scan should end with the range.";
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+        ASSERT_EQ(other.close(), success) << "IX_ScanIterator::close() should succeed.";
+
+        hits = hitsAfter;
+        ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hitsAfter, missesAfter), success)
+                                    << "IXFileHandle::collectCacheCounterValues() should succeed.";
+        ASSERT_EQ(hitsAfter - hits, 2 * oneScan) << "Each scan should read its nodes once, as it does alone.";
+        ASSERT_EQ(missesAfter, misses) << "The scans should not miss the caches.";
+    }
+
+    TEST_F(IX_Private_Test, probe_during_open_scan) {
+        // Functions Tested:
+        // 1. insertEntry() - varchar keys, so the leaves keep a prefix
+        // 2. scan() - a full scan stopped halfway
+        // 3. scan() - equality probes on keys before, at and after the scan's position, each reads one path of nodes
+        // 4. the full scan goes on where it stopped and ends with the last key
+
+        int entries = 5000;
+        auto keyOf = [](int i, char *key) {
+            std::string value = "probe_key_" + std::to_string(100000 + i);
+            int length = (int) value.length();
+            memcpy(key, &length, sizeof(int));
+            memcpy(key + sizeof(int), value.data(), length);
+        };
+        char key[PAGE_SIZE], returnedKey[PAGE_SIZE];
+        for (int i = 0; i < entries; i++) {
+            int scrambled = (int) (i * 7919L % entries);
+            keyOf(scrambled, key);
+            rid.pageNum = scrambled;
+            rid.slotNum = scrambled % SHRT_MAX;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, empNameAttr, key, rid), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+
+        ASSERT_EQ(ix.scan(ixFileHandle, empNameAttr, nullptr, nullptr, true, true, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        int found = 0;
+        for (; found < entries / 2; found++) {
+            ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, returnedKey), success) << "The scan should go on.";
+            ASSERT_EQ(rid.pageNum, found) << "returned pageNum does not match inserted.";
+        }
+
+        unsigned reads, writes, appends, readsAfter, hits, misses, hitsAfter, missesAfter, probeReads = 0;
+        for (int i : {0, entries / 4, entries / 2, entries - 1}) {
+            ASSERT_EQ(ixFileHandle.collectCounterValues(reads, writes, appends), success)
+                                        << "IXFileHandle::collectCounterValues() should succeed.";
+            ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hits, misses), success)
+                                        << "IXFileHandle::collectCacheCounterValues() should succeed.";
+            PeterDB::IX_ScanIterator probe;
+            keyOf(i, key);
+            ASSERT_EQ(ix.scan(ixFileHandle, empNameAttr, key, key, true, true, probe), success)
+                                        << "indexManager::scan() should succeed.";
+            ASSERT_EQ(probe.getNextEntry(rid, returnedKey), success) << "The key " << i << " should be found.";
+            ASSERT_EQ(rid.pageNum, i) << "returned pageNum does not match inserted.";
+            ASSERT_EQ(memcmp(returnedKey, key, sizeof(int) + *(int *) key), 0) << "key does not match.";
+            ASSERT_EQ(probe.getNextEntry(rid, returnedKey), IX_EOF) << "The key should be found once.";
+            ASSERT_EQ(probe.close(), success) << "IX_ScanIterator::close() should succeed.";
+
+            ASSERT_EQ(ixFileHandle.collectCounterValues(readsAfter, writes, appends), success)
+                                        << "IXFileHandle::collectCounterValues() should succeed.";
+            ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hitsAfter, missesAfter), success)
+                                        << "IXFileHandle::collectCacheCounterValues() should succeed.";
+            ASSERT_EQ(missesAfter, misses) << "A probe should not miss the caches.";
+            ASSERT_EQ(hitsAfter - hits, readsAfter - reads) << "Every node the probe reads should be a hit.";
+            if (probeReads == 0)
+                probeReads = readsAfter - reads;
+            ASSERT_EQ(readsAfter - reads, probeReads) << "Every probe should read one path from the root.";
+        }
+
+        for (; found < entries; found++) {
+            ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, returnedKey), success) << "The scan should go on.";
+            ASSERT_EQ(rid.pageNum, found) << "returned pageNum does not match inserted.";
+        }
+        ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, returnedKey), IX_EOF) << "The scan should end with the last key.";
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+    }
+
+    TEST_F(IX_Private_Test, scan_while_other_handle_splits_leaves) {
+        // Functions Tested:
+        // 1. insertEntry() - the even keys, in order
+        // 2. scan() - through the fixture's handle, stopped a quarter of the way
+        // 3. insertEntry() - the odd keys through a second handle of the file, splitting the leaves ahead of the scan
+        //    and the one it is on
+        // 4. the scan goes on and returns every even key once, in order, without a miss in the shared caches
+
+        int entries = 20000;
+        for (int key = 0; key < entries; key += 2) {
+            rid.pageNum = key;
+            rid.slotNum = key % SHRT_MAX;
+            ASSERT_EQ(ix.insertEntry(ixFileHandle, ageAttr, &key, rid), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+        unsigned pagesBefore = ixFileHandle.getPageCount();
+
+        ASSERT_EQ(ix.scan(ixFileHandle, ageAttr, nullptr, nullptr, true, true, ix_ScanIterator), success)
+                                    << "indexManager::scan() should succeed.";
+        int key, previous = -1, evenKeys = 0;
+        for (; evenKeys < entries / 8; evenKeys++) {
+            ASSERT_EQ(ix_ScanIterator.getNextEntry(rid, &key), success) << "The scan should go on.";
+            ASSERT_EQ(key, 2 * evenKeys) << "key does not match.";
+            previous = key;
+        }
+        unsigned hits, misses, hitsAfter, missesAfter, reads, writes, appends, readsAfter;
+        ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hits, misses), success)
+                                    << "IXFileHandle::collectCacheCounterValues() should succeed.";
+        ASSERT_EQ(ixFileHandle.collectCounterValues(reads, writes, appends), success)
+                                    << "IXFileHandle::collectCounterValues() should succeed.";
+
+        PeterDB::IXFileHandle otherHandle;
+        ASSERT_EQ(ix.openFile(indexFileName, otherHandle), success) << "indexManager::openFile() should succeed.";
+        for (int odd = 1; odd < entries; odd += 2) {
+            rid.pageNum = odd;
+            rid.slotNum = odd % SHRT_MAX;
+            ASSERT_EQ(ix.insertEntry(otherHandle, ageAttr, &odd, rid), success)
+                                        << "indexManager::insertEntry() should succeed.";
+        }
+        ASSERT_GT(ixFileHandle.getPageCount(), pagesBefore)
+                                    << "Both handles should see the pages the splits appended.";
+        ASSERT_EQ(ixFileHandle.getPageCount(), otherHandle.getPageCount()) << "The handles should agree on the pages.";
+
+        while (ix_ScanIterator.getNextEntry(rid, &key) != IX_EOF) {
+            ASSERT_GT(key, previous) << "Keys should come back in order, each once.";
+            ASSERT_EQ(rid.pageNum, key) << "returned pageNum does not match inserted.";
+            previous = key;
+            if (key % 2 == 0) {
+                ASSERT_EQ(key, 2 * evenKeys) << "No key there before the splits should be skipped.";
+                evenKeys++;
+            }
+        }
+        ASSERT_EQ(evenKeys, entries / 2) << "Every key there before the splits should be found.";
+        ASSERT_EQ(ix_ScanIterator.close(), success) << "IX_ScanIterator::close() should succeed.";
+
+        ASSERT_EQ(ixFileHandle.collectCacheCounterValues(hitsAfter, missesAfter), success)
+                                    << "IXFileHandle::collectCacheCounterValues() should succeed.";
+        ASSERT_EQ(ixFileHandle.collectCounterValues(readsAfter, writes, appends), success)
+                                    << "IXFileHandle::collectCounterValues() should succeed.";
+        ASSERT_GT(readsAfter, reads) << "The scan should read the rest of the leaves.";
+        ASSERT_EQ(hitsAfter - hits + missesAfter - misses, readsAfter - reads)
+                                    << "Every node read should be a cache hit or miss.";
+        ASSERT_EQ(missesAfter, misses) << "The other handle's writes should be in the shared buffer pool.";
+        ASSERT_EQ(ix.closeFile(otherHandle), success) << "indexManager::closeFile() should succeed.";
+    }
+
+}
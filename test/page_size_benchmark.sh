@@ -0,0 +1,12 @@
+#!/bin/sh
+# Compares page sizes: builds the tests once per PAGE_SIZE, in a build directory each, and prints what
+# IX_Private_Test.lookups_and_scan_at_page_size measures in every one of them. Run it from the repo root.
+#
+# Usage: test/page_size_benchmark.sh [build directory prefix]
+set -e
+prefix=${1:-cmake-build-page}
+for size in 4096 8192 16384 32768; do
+    cmake -S . -B "$prefix-$size" -DPAGE_SIZE=$size -DCMAKE_BUILD_TYPE=Release > /dev/null
+    cmake --build "$prefix-$size" --target ixtest_private > /dev/null
+    "$prefix-$size/ixtest_private" --gtest_filter='IX_Private_Test.lookups_and_scan_at_page_size' 2>&1 | grep "PAGE_SIZE"
+done
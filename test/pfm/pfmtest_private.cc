@@ -129,4 +129,407 @@ namespace PeterDBTesting {
         ASSERT_GT(getFileSize(fileName), 0) << "File Size should not be zero at this moment.";
     }
 
+    TEST_F (PFM_Private_Test, check_buffer_pool_policies) {
+        // Test case procedure:
+        // 1. Shrink the buffer pool so that pages get evicted, for each replacement policy
+        // 2. Append pages and read them back through the pool
+        // 3. Check the content and the hit/miss counters
+
+        PeterDB::BufferPool &bufferPool = PeterDB::BufferPool::instance();
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        int numPages = 12;
+        PeterDB::ReplacementPolicyType policies[3] = {PeterDB::LRU_POLICY, PeterDB::CLOCK_POLICY,
+                                                      PeterDB::LRU_K_POLICY};
+
+        for (PeterDB::ReplacementPolicyType policy : policies) {
+            ASSERT_EQ(bufferPool.configure(4, policy), success) << "Configuring the buffer pool should succeed.";
+            unsigned pagesBefore = fileHandle.getNumberOfPages();
+            for (int i = 0; i < numPages; i++) {
+                generateData(inBuffer, PAGE_SIZE, 11 + i, 31 - i);
+                ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+            }
+
+            unsigned hitCount = 0, missCount = 0, hitCountAfter = 0, missCountAfter = 0;
+            ASSERT_EQ(fileHandle.collectCacheCounterValues(hitCount, missCount), success)
+                                        << "Collecting cache counters should succeed.";
+            for (int round = 0; round < 2; round++) {
+                for (int i = 0; i < numPages; i++) {
+                    generateData(inBuffer, PAGE_SIZE, 11 + i, 31 - i);
+                    ASSERT_EQ(fileHandle.readPage(pagesBefore + i, outBuffer), success)
+                                                << "Reading a page should succeed.";
+                    ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0)
+                                                << "Checking the integrity of the page should succeed.";
+                }
+            }
+            ASSERT_EQ(fileHandle.collectCacheCounterValues(hitCountAfter, missCountAfter), success)
+                                        << "Collecting cache counters should succeed.";
+            ASSERT_EQ(hitCountAfter - hitCount + missCountAfter - missCount, 2 * numPages)
+                                        << "Every read should be either a hit or a miss.";
+            ASSERT_GT(missCountAfter - missCount, 0) << "A pool smaller than the file should miss.";
+        }
+
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Restoring the buffer pool should succeed.";
+    }
+
+    TEST_F (PFM_Private_Test, check_free_space_map) {
+        // Test case procedure:
+        // 1. Append enough pages to need several free space map pages
+        // 2. Set the free space of a few pages
+        // 3. Check the lookups, before and after reopening the file
+
+        inBuffer = malloc(PAGE_SIZE);
+        unsigned numPages = 3 * FSM_FANOUT + 7;
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 17 + i % 50, 41);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+            ASSERT_EQ(fileHandle.setPageSpace(i, 16), success) << "Setting the page space should succeed.";
+        }
+        ASSERT_TRUE(getFileSize(fileName) % PAGE_SIZE == 0) << "File should be based on PAGE_SIZE.";
+        ASSERT_EQ(fileHandle.findFreePage(100), -1) << "No page should have 100 free bytes.";
+
+        ASSERT_EQ(fileHandle.setPageSpace(5, 500), success) << "Setting the page space should succeed.";
+        ASSERT_EQ(fileHandle.setPageSpace(2 * FSM_FANOUT + 3, 300), success) << "Setting the page space should succeed.";
+        ASSERT_EQ(fileHandle.findFreePage(400), 5) << "Only the first page set should have 400 free bytes.";
+        ASSERT_EQ(fileHandle.findFreePage(200), 2 * FSM_FANOUT + 3) << "The last page with enough space should win.";
+
+        reopenFile();
+
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "The page count should survive reopening.";
+        ASSERT_EQ(fileHandle.findFreePage(200), 2 * FSM_FANOUT + 3) << "The free space map should survive reopening.";
+        ASSERT_EQ(fileHandle.setPageSpace(2 * FSM_FANOUT + 3, 16), success) << "Setting the page space should succeed.";
+        ASSERT_EQ(fileHandle.findFreePage(200), 5) << "Lowering a page's space should update the map.";
+    }
+
+    TEST_F (PFM_Private_Test, check_shared_file_state) {
+        // Test case procedure:
+        // 1. Open a second handle on the same file
+        // 2. Append and set page space through one handle
+        // 3. Check the other handle sees it without rereading the header
+
+        PeterDB::FileHandle otherHandle;
+        ASSERT_EQ(pfm.openFile(fileName, otherHandle), success) << "Opening the file again should succeed.";
+        inBuffer = malloc(PAGE_SIZE);
+        int numPages = 5;
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 29 + i, 13);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+            ASSERT_EQ(fileHandle.setPageSpace(i, 32), success) << "Setting the page space should succeed.";
+        }
+        ASSERT_EQ(fileHandle.setPageSpace(2, 700), success) << "Setting the page space should succeed.";
+        ASSERT_EQ(otherHandle.getNumberOfPages(), numPages) << "Both handles should share the page count.";
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned readPageCount1 = 0, writePageCount1 = 0, appendPageCount1 = 0;
+        ASSERT_EQ(otherHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success)
+                                    << "Collecting counters should succeed.";
+        ASSERT_EQ(otherHandle.findFreePage(600), 2) << "Both handles should share the free space map.";
+        ASSERT_EQ(otherHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1), success)
+                                    << "Collecting counters should succeed.";
+        ASSERT_EQ(writePageCount1, writePageCount) << "Looking up free space should not write the header.";
+        ASSERT_LE(readPageCount1 - readPageCount, 3) << "Looking up free space should read one map page per level.";
+
+        ASSERT_EQ(pfm.closeFile(otherHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "Closing one handle should not affect the other.";
+    }
+
+    TEST_F (PFM_Private_Test, check_mmap_mode) {
+        // Test case procedure:
+        // 1. Reopen the file with memory-mapped I/O
+        // 2. Append, write, read and pin pages through the mapping
+        // 3. Reopen with buffered I/O and check the content and the file size
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, PeterDB::MMAP_IO), success)
+                                    << "Opening the file with mmap should succeed.";
+        PeterDB::FileHandle bufferedHandle;
+        ASSERT_NE(pfm.openFile(fileName, bufferedHandle), success)
+                                    << "Opening a mapped file in another mode should fail.";
+
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        unsigned numPages = MMAP_GROWTH_PAGES + 10;
+        for (unsigned i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 19 + i % 40, 23);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+            ASSERT_EQ(fileHandle.setPageSpace(i, 16), success) << "Setting the page space should succeed.";
+        }
+        generateData(inBuffer, PAGE_SIZE, 61, 7);
+        ASSERT_EQ(fileHandle.writePage(3, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(fileHandle.readPage(3, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+        char *pinned = fileHandle.pinPage(3);
+        ASSERT_NE(pinned, nullptr) << "Pinning a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, pinned, PAGE_SIZE), 0) << "A pinned page should be read in place.";
+        ASSERT_EQ(fileHandle.unpinPage(3, false), success) << "Unpinning a page should succeed.";
+        ASSERT_EQ(fileHandle.setPageSpace(5, 900), success) << "Setting the page space should succeed.";
+
+        reopenFile();
+
+        ASSERT_EQ(fileHandle.getNumberOfPages(), numPages) << "The page count should survive reopening.";
+        ASSERT_EQ((size_t) getFileSize(fileName), (size_t) PeterDB::FreeSpaceMap::fileEnd(numPages) * PAGE_SIZE)
+                                    << "The growth chunks should be cut off on close.";
+        ASSERT_EQ(fileHandle.readPage(3, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+        generateData(inBuffer, PAGE_SIZE, 19 + (numPages - 1) % 40, 23);
+        ASSERT_EQ(fileHandle.readPage(numPages - 1, outBuffer), success) << "Reading a page should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+        ASSERT_EQ(fileHandle.findFreePage(800), 5) << "The free space map should survive reopening.";
+    }
+
+    TEST_F (PFM_Private_Test, check_batched_reads) {
+        // Test case procedure:
+        // 1. Append pages through a buffer pool too small to hold them
+        // 2. Read them back in one batch, some from the pool and the rest from the I/O threads
+        // 3. Check the content, the counters and that pages past the end are refused
+
+        PeterDB::BufferPool &bufferPool = PeterDB::BufferPool::instance();
+        ASSERT_EQ(bufferPool.configure(4, PeterDB::LRU_POLICY), success) << "Configuring the buffer pool should succeed.";
+        int numPages = 40;
+        inBuffer = malloc(PAGE_SIZE);
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 37 + i, 11 + i);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        std::vector<PeterDB::PageNum> pageNums;
+        for (int i = numPages - 1; i >= 0; i -= 2)
+            pageNums.push_back(i);
+        outBuffer = malloc(PAGE_SIZE * pageNums.size());
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0;
+        unsigned readPageCount1 = 0, writePageCount1 = 0, appendPageCount1 = 0;
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount), success)
+                                    << "Collecting counters should succeed.";
+        PeterDB::PageBatch batch;
+        ASSERT_EQ(fileHandle.readPagesAsync(pageNums, outBuffer, batch), success) << "Submitting reads should succeed.";
+        ASSERT_EQ(batch.wait(), success) << "The reads should complete.";
+        ASSERT_TRUE(batch.done()) << "The batch should be done after waiting.";
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1), success)
+                                    << "Collecting counters should succeed.";
+        ASSERT_EQ(readPageCount1 - readPageCount, pageNums.size()) << "Every page in the batch counts as a read.";
+        for (unsigned i = 0; i < pageNums.size(); i++) {
+            generateData(inBuffer, PAGE_SIZE, 37 + pageNums[i], 11 + pageNums[i]);
+            ASSERT_EQ(memcmp(inBuffer, (char *) outBuffer + i * PAGE_SIZE, PAGE_SIZE), 0)
+                                        << "Checking the integrity of the page should succeed.";
+        }
+
+        pageNums.push_back(numPages);
+        ASSERT_NE(fileHandle.readPages(pageNums, outBuffer), success) << "Reading past the last page should fail.";
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Restoring the buffer pool should succeed.";
+    }
+
+    TEST_F (PFM_Private_Test, check_write_behind) {
+        // Test case procedure:
+        // 1. Reopen the file in write-behind mode
+        // 2. Append and overwrite pages, check they are flushed in far fewer physical writes
+        // 3. Sync, reopen with buffered I/O and check the content
+
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle, PeterDB::WRITE_BEHIND_IO), success)
+                                    << "Opening the file in write-behind mode should succeed.";
+
+        unsigned readPageCount = 0, writePageCount = 0, appendPageCount = 0, flushCount = 0;
+        unsigned readPageCount1 = 0, writePageCount1 = 0, appendPageCount1 = 0, flushCount1 = 0;
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount, flushCount), success)
+                                    << "Collecting counters should succeed.";
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        int numPages = 3 * GROUP_COMMIT_PAGES;
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 43 + i, 5 + i);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.sync(), success) << "Syncing the file should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount1, writePageCount1, appendPageCount1, flushCount1),
+                  success) << "Collecting counters should succeed.";
+        ASSERT_GE(appendPageCount1 - appendPageCount, (unsigned) numPages) << "Every append should be counted.";
+        ASSERT_GT(flushCount1, flushCount) << "Syncing should have written the pages.";
+        ASSERT_LT(flushCount1 - flushCount, (unsigned) numPages / 16) << "Appended pages should be flushed in runs.";
+
+        for (int i = 0; i < numPages; i += 3) {
+            generateData(inBuffer, PAGE_SIZE, 7 + i, 59 - i);
+            ASSERT_EQ(fileHandle.writePage(i, inBuffer), success) << "Writing a page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.sync(), success) << "Syncing the file should succeed.";
+        ASSERT_EQ(fileHandle.collectCounterValues(readPageCount, writePageCount, appendPageCount, flushCount), success)
+                                    << "Collecting counters should succeed.";
+        ASSERT_GE(writePageCount - writePageCount1, (unsigned) numPages / 3) << "Every write counts as a logical write.";
+        ASSERT_GT(flushCount, flushCount1) << "Syncing should have written the pages.";
+
+        reopenFile();
+
+        for (int i = 0; i < numPages; i++) {
+            i % 3 == 0 ? generateData(inBuffer, PAGE_SIZE, 7 + i, 59 - i) : generateData(inBuffer, PAGE_SIZE, 43 + i, 5 + i);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+        }
+    }
+
+    TEST_F (PFM_Private_Test, check_read_ahead) {
+        // Test case procedure:
+        // 1. Append pages and empty the buffer pool
+        // 2. Read them in order, check most reads hit pages loaded ahead
+        // 3. Read them in a scattered order, check nothing is loaded ahead
+
+        PeterDB::BufferPool &bufferPool = PeterDB::BufferPool::instance();
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        int numPages = 120;
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 31 + i, 17 + i);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Emptying the buffer pool should succeed.";
+        unsigned hitCount = 0, missCount = 0, hitCountAfter = 0, missCountAfter = 0;
+        unsigned prefetched = bufferPool.prefetchCounter;
+        ASSERT_EQ(fileHandle.collectCacheCounterValues(hitCount, missCount), success)
+                                    << "Collecting cache counters should succeed.";
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 31 + i, 17 + i);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_SIZE), 0) << "Checking the integrity of the page should succeed.";
+        }
+        ASSERT_EQ(fileHandle.collectCacheCounterValues(hitCountAfter, missCountAfter), success)
+                                    << "Collecting cache counters should succeed.";
+        ASSERT_LE(missCountAfter - missCount, READ_AHEAD_TRIGGER) << "Only the reads before read-ahead starts should miss.";
+        ASSERT_GT(bufferPool.prefetchCounter, prefetched) << "Pages should have been loaded ahead.";
+
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Emptying the buffer pool should succeed.";
+        prefetched = bufferPool.prefetchCounter;
+        for (int i = 0; i < numPages; i += 7) {
+            ASSERT_EQ(fileHandle.readPage((i * 37) % numPages, outBuffer), success) << "Reading a page should succeed.";
+        }
+        ASSERT_EQ(bufferPool.prefetchCounter, prefetched) << "Scattered reads should not load pages ahead.";
+    }
+
+    TEST_F (PFM_Private_Test, check_page_checksums) {
+        // Test case procedure:
+        // 1. Turn checksums on, append pages and empty the buffer pool
+        // 2. Read them back, check the data part of every page is intact
+        // 3. Corrupt a page on disk, check reading it fails and is counted
+        // 4. Turn verification off, check the page can be read again
+
+        PeterDB::BufferPool &bufferPool = PeterDB::BufferPool::instance();
+        bufferPool.enableChecksums(fileName);
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        int numPages = 10;
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 23 + i, 41 + i);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Emptying the buffer pool should succeed.";
+        unsigned failures = bufferPool.checksumFailureCounter;
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 23 + i, 41 + i);
+            ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, PAGE_DATA_SIZE), 0)
+                                        << "Checking the integrity of the page should succeed.";
+            ASSERT_TRUE(PeterDB::PageChecksum::verify((char *) outBuffer)) << "The page should carry its checksum.";
+        }
+        ASSERT_EQ(bufferPool.checksumFailureCounter, failures) << "Intact pages should not fail verification.";
+
+        int corruptPage = 6;
+        generateData(inBuffer, PAGE_SIZE, 23 + corruptPage, 41 + corruptPage);
+        std::fstream file(fileName, std::ios::in | std::ios::out | std::ios::binary);
+        file.seekp((long) PeterDB::FreeSpaceMap::dataPageLocation(corruptPage) * PAGE_SIZE + 100);
+        file.put((char) (((char *) inBuffer)[100] ^ 0x5a));
+        file.close();
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Emptying the buffer pool should succeed.";
+        ASSERT_EQ(fileHandle.readPage(corruptPage, outBuffer), -1) << "Reading a corrupted page should fail.";
+        ASSERT_GT(bufferPool.checksumFailureCounter, failures) << "The failure should be counted.";
+        ASSERT_EQ(fileHandle.readPage(corruptPage - 1, outBuffer), success) << "Reading an intact page should succeed.";
+
+        bufferPool.setChecksumMode(PeterDB::CHECKSUM_OFF);
+        ASSERT_EQ(fileHandle.readPage(corruptPage, outBuffer), success)
+                                    << "Reading without verification should succeed.";
+        bufferPool.setChecksumMode(PeterDB::CHECKSUM_ON_LOAD);
+    }
+
+    TEST_F (PFM_Private_Test, check_page_size_header) {
+        // Test case procedure:
+        // 1. Check the header records the page size the file was created with
+        // 2. Change the recorded page size on disk
+        // 3. Check the file can no longer be opened
+
+        std::string otherFileName = "pfm_private_test_page_size";
+        ASSERT_EQ(pfm.createFile(otherFileName), success) << "Creating the file should succeed.";
+        unsigned header[5] = { 0, 0, 0, 0, 0 };
+        std::fstream file(otherFileName, std::ios::in | std::ios::out | std::ios::binary);
+        file.read(reinterpret_cast<char *>(header), sizeof(header));
+        ASSERT_EQ(header[4], PAGE_SIZE) << "The header should record the page size.";
+
+        header[4] = PAGE_SIZE * 2;
+        file.seekp(0);
+        file.write(reinterpret_cast<char *>(header), sizeof(header));
+        file.close();
+        PeterDB::FileHandle otherHandle;
+        ASSERT_EQ(pfm.openFile(otherFileName, otherHandle), -1) << "Opening a file with another page size should fail.";
+        ASSERT_FALSE(otherHandle.isOpen()) << "The handle should stay closed.";
+        ASSERT_EQ(pfm.destroyFile(otherFileName), success) << "Destroying the file should succeed.";
+    }
+
+    TEST_F (PFM_Private_Test, check_io_statistics) {
+        // Test case procedure:
+        // 1. Append pages, check the bytes written and write latencies are recorded
+        // 2. Empty the buffer pool and read the pages twice, check bytes read, hits and misses
+        // 3. Sync a write-behind handle, check the sync is counted
+        // 4. Check the statistics can be dumped as JSON
+
+        PeterDB::BufferPool &bufferPool = PeterDB::BufferPool::instance();
+        PeterDB::IOStatistics before = bufferPool.getStatistics(fileName);
+        inBuffer = malloc(PAGE_SIZE);
+        outBuffer = malloc(PAGE_SIZE);
+        int numPages = 8;
+        for (int i = 0; i < numPages; i++) {
+            generateData(inBuffer, PAGE_SIZE, 61 + i, 19 + i);
+            ASSERT_EQ(fileHandle.appendPage(inBuffer), success) << "Appending a page should succeed.";
+        }
+        PeterDB::IOStatistics written = bufferPool.getStatistics(fileName);
+        ASSERT_GE(written.bytesWritten - before.bytesWritten, (unsigned long long) numPages * PAGE_SIZE)
+                                    << "Every appended page should be counted as written.";
+        ASSERT_GE(written.writeLatency.getCount() - before.writeLatency.getCount(), (unsigned long long) numPages)
+                                    << "Every write should have a latency sample.";
+
+        ASSERT_EQ(bufferPool.configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "Emptying the buffer pool should succeed.";
+        for (int round = 0; round < 2; round++) {
+            for (int i = numPages - 1; i >= 0; i--) {
+                ASSERT_EQ(fileHandle.readPage(i, outBuffer), success) << "Reading a page should succeed.";
+            }
+        }
+        PeterDB::IOStatistics read = bufferPool.getStatistics(fileName);
+        ASSERT_EQ(read.bytesRead - written.bytesRead, (unsigned long long) numPages * PAGE_SIZE)
+                                    << "Only the first round of reads should reach the file.";
+        ASSERT_EQ(read.cacheMisses - written.cacheMisses, (unsigned long long) numPages)
+                                    << "The first round of reads should miss.";
+        ASSERT_GE(read.cacheHits - written.cacheHits, (unsigned long long) numPages)
+                                    << "The second round of reads should hit.";
+        ASSERT_LE(read.readLatency.percentile(0.5), read.readLatency.getMax())
+                                    << "Percentiles should not exceed the maximum.";
+
+        PeterDB::FileHandle writeBehindHandle;
+        ASSERT_EQ(pfm.closeFile(fileHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.openFile(fileName, writeBehindHandle, PeterDB::WRITE_BEHIND_IO), success)
+                                    << "Opening the file in write-behind mode should succeed.";
+        ASSERT_EQ(writeBehindHandle.writePage(0, inBuffer), success) << "Writing a page should succeed.";
+        ASSERT_EQ(writeBehindHandle.sync(), success) << "Syncing the file should succeed.";
+        PeterDB::IOStatistics synced = bufferPool.getStatistics(fileName);
+        ASSERT_GT(synced.syncLatency.getCount(), read.syncLatency.getCount()) << "The sync should be counted.";
+        ASSERT_EQ(pfm.closeFile(writeBehindHandle), success) << "Closing the file should succeed.";
+        ASSERT_EQ(pfm.openFile(fileName, fileHandle), success) << "Opening the file again should succeed.";
+
+        std::string json = synced.toJson();
+        ASSERT_NE(json.find("\"bytesRead\":"), std::string::npos) << "The JSON should hold the bytes read.";
+        ASSERT_NE(json.find("\"p99Nanos\":"), std::string::npos) << "The JSON should hold latency percentiles.";
+    }
+
 }
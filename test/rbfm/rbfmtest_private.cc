@@ -1,5 +1,22 @@
 #include "src/include/rbfm.h"
 #include "test/utils/rbfm_test_utils.h"
+#include <atomic>
+
+#ifdef __GLIBC__
+// Counts heap allocations made while countingAllocations is set, operator new ends up here as well
+extern "C" void *__libc_malloc(size_t size);
+
+namespace {
+    std::atomic<bool> countingAllocations(false);
+    std::atomic<unsigned long> allocationCount(0);
+}
+
+extern "C" void *malloc(size_t size) {
+    if (countingAllocations)
+        ++allocationCount;
+    return __libc_malloc(size);
+}
+#endif
 
 namespace PeterDBTesting {
     TEST_F(RBFM_Private_Test, varchar_compact_size) {
@@ -634,5 +651,293 @@ namespace PeterDBTesting {
 
     }
 
-}
+    TEST_F(RBFM_Private_Test, read_through_page_view) {
+        // Functions Tested:
+        // 1. insertRecord() - with selected NULLs, across several pages
+        // 2. Read every record in place through a PageView, check NULLs and values
+        // 3. readRecord() and readAttribute() - check they match and leave no page pinned
+
+        PeterDB::RID rid;
+        unsigned recordSize = 0;
+        inBuffer = malloc(2000);
+        outBuffer = malloc(2000);
+        memset(inBuffer, 0, 2000);
+        memset(outBuffer, 0, 2000);
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createLargeRecordDescriptor3(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        nullsIndicator[0] = 157; // 10011101
+        nullsIndicator[1] = 130; // 10000010
+        nullsIndicator[2] = 75;  // 01001011
 
+        std::vector<PeterDB::RID> rids;
+        int numRecords = 100;
+        prepareLargeRecord3(recordDescriptor.size(), nullsIndicator, 8, inBuffer, &recordSize);
+        for (int i = 0; i < numRecords; i++) {
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            rids.push_back(rid);
+        }
+        ASSERT_GT(fileHandle.getNumberOfPages(), 1) << "The records should span several pages.";
+
+        for (int i = 0; i < numRecords; i++) {
+            PeterDB::PageView page;
+            ASSERT_EQ(page.pin(fileHandle, rids[i].pageNum), success) << "Pinning the page should succeed.";
+            ASSERT_FALSE(page.recordDeleted(rids[i].slotNum)) << "The record should be on its page.";
+            PeterDB::RecordView record = page.getRecord(rids[i].slotNum);
+            ASSERT_EQ(record.getAttributeCount(), (short) recordDescriptor.size()) << "Attribute counts should match.";
+            for (int j = 0; j < recordDescriptor.size(); j++) {
+                bool null = nullsIndicator[j / 8] & (1 << (7 - j % 8));
+                ASSERT_EQ(record.isNull(j), null) << "NULL attributes should be read in place.";
+            }
+            ASSERT_EQ(memcmp(record.getAttribute(1), (char *) inBuffer + 3, sizeof(int)), 0)
+                                        << "Values should be read in place.";
+            page.unpin();
+
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(inBuffer, outBuffer, recordSize), 0) << "Reading a record should match what was inserted.";
+            ASSERT_EQ(rbfm.readAttribute(fileHandle, recordDescriptor, rids[i], "attr1", outBuffer), success)
+                                        << "Reading an attribute should succeed.";
+            ASSERT_EQ(memcmp((char *) outBuffer + 1, (char *) inBuffer + 3, sizeof(int)), 0)
+                                        << "Reading an attribute should match what was inserted.";
+        }
+
+        ASSERT_EQ(PeterDB::BufferPool::instance().configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "No page should be left pinned.";
+    }
+
+    TEST_F(RBFM_Private_Test, scan_past_deleted_records) {
+        // Functions Tested:
+        // 1. insertRecord() - across several pages
+        // 2. deleteRecord() - most of the records
+        // 3. scan() - with a condition, skipping long runs of deleted and non-matching records
+        // 4. close() - leaves no page pinned
+
+        PeterDB::RID rid;
+        size_t recordSize = 0;
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+        memset(inBuffer, 0, 100);
+        memset(outBuffer, 0, 100);
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+
+        int numRecords = 2000;
+        std::vector<PeterDB::RID> rids;
+        for (int i = 0; i < numRecords; i++) {
+            prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", i, 177.8, 6200, inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+            rids.push_back(rid);
+        }
+        for (int i = 0; i < numRecords; i++) {
+            if (i % 500 != 0)
+                ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                            << "Deleting a record should succeed.";
+        }
+
+        PeterDB::FileHandle scanHandle;
+        ASSERT_EQ(rbfm.openFile(fileName, scanHandle), success) << "Opening the file should succeed.";
+        PeterDB::RBFM_ScanIterator scanner;
+        int ageVal = 1000;
+        std::vector<std::string> attributeNames = {"EmpName", "Age"};
+        ASSERT_EQ(rbfm.scan(scanHandle, recordDescriptor, "Age", PeterDB::GE_OP, &ageVal, attributeNames, scanner),
+                  success) << "Starting a scan should succeed.";
+
+        std::vector<int> ages;
+        while (scanner.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+            ASSERT_EQ(((char *) outBuffer)[0], 0) << "No projected attribute should be NULL.";
+            int nameLength;
+            memcpy(&nameLength, (char *) outBuffer + 1, sizeof(int));
+            ASSERT_EQ(nameLength, 8) << "The name should be projected first.";
+            ASSERT_EQ(memcmp((char *) outBuffer + 5, "Anteater", 8), 0) << "The name should be projected as inserted.";
+            int age;
+            memcpy(&age, (char *) outBuffer + 13, sizeof(int));
+            ages.push_back(age);
+        }
+        ASSERT_EQ(ages, std::vector<int>({1000, 1500})) << "Only the remaining matching records should be returned.";
+        ASSERT_EQ(scanner.getNextRecord(rid, outBuffer), RBFM_EOF) << "A finished scan should stay finished.";
+        ASSERT_EQ(scanner.close(), success) << "Closing the scan should succeed.";
+        ASSERT_EQ(rbfm.closeFile(scanHandle), success) << "Closing the file should succeed.";
+
+        ASSERT_EQ(PeterDB::BufferPool::instance().configure(BUFFER_POOL_SIZE, PeterDB::LRU_POLICY), success)
+                                    << "No page should be left pinned.";
+    }
+
+    TEST_F(RBFM_Private_Test, scan_with_varchar_condition) {
+        // Functions Tested:
+        // 1. insertRecord() - names sharing prefixes, one of them NULL
+        // 2. scan() - varchar conditions order like strings, a shorter prefix first
+        // 3. scan() - NULL never satisfies a condition
+
+        PeterDB::RID rid;
+        size_t recordSize = 0;
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+        memset(inBuffer, 0, 100);
+        memset(outBuffer, 0, 100);
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        std::vector<std::string> names = {"Ant", "Anteater", "Antelope", "Bee", ""};
+        for (int i = 0; i < names.size(); i++) {
+            prepareRecord(recordDescriptor.size(), nullsIndicator, names[i].length(), names[i], i, 177.8, 6200,
+                          inBuffer, recordSize);
+            ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                        << "Inserting a record should succeed.";
+        }
+        nullsIndicator[0] = 128; // 10000000, EmpName is NULL
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 0, "", (int) names.size(), 177.8, 6200, inBuffer,
+                      recordSize);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+
+        std::string prefix = "Ante";
+        char value[100];
+        int prefixLength = prefix.length();
+        memcpy(value, &prefixLength, sizeof(int));
+        memcpy(value + sizeof(int), prefix.c_str(), prefixLength);
+
+        std::vector<std::pair<PeterDB::CompOp, std::vector<int>>> expectations = {
+                {PeterDB::GE_OP, {1, 2, 3}},
+                {PeterDB::LT_OP, {0, 4}},
+                {PeterDB::NE_OP, {0, 1, 2, 3, 4}},
+                {PeterDB::NO_OP, {0, 1, 2, 3, 4, 5}},
+        };
+        std::vector<std::string> attributeNames = {"Age"};
+        for (auto &expectation : expectations) {
+            PeterDB::FileHandle scanHandle;
+            ASSERT_EQ(rbfm.openFile(fileName, scanHandle), success) << "Opening the file should succeed.";
+            PeterDB::RBFM_ScanIterator scanner;
+            ASSERT_EQ(rbfm.scan(scanHandle, recordDescriptor, "EmpName", expectation.first, value, attributeNames,
+                                scanner), success) << "Starting a scan should succeed.";
+            std::vector<int> ages;
+            while (scanner.getNextRecord(rid, outBuffer) != RBFM_EOF) {
+                int age;
+                memcpy(&age, (char *) outBuffer + 1, sizeof(int));
+                ages.push_back(age);
+            }
+            ASSERT_EQ(ages, expectation.second) << "The scan should return the matching records.";
+            ASSERT_EQ(scanner.close(), success) << "Closing the scan should succeed.";
+            ASSERT_EQ(rbfm.closeFile(scanHandle), success) << "Closing the file should succeed.";
+        }
+    }
+
+    TEST_F(RBFM_Private_Test, insert_records_in_batch) {
+        // Functions Tested:
+        // 1. insertRecords() - a batch spanning several pages
+        // 2. readRecord() - every record of the batch
+        // 3. insertRecords() - a second batch filling the free space left by deletes
+
+        PeterDB::RID rid;
+        size_t recordSize = 0;
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        outBuffer = malloc(100);
+
+        int numRecords = 2000;
+        std::vector<std::vector<char>> records(numRecords, std::vector<char>(100, 0));
+        std::vector<size_t> recordSizes(numRecords);
+        std::vector<const void *> batch;
+        for (int i = 0; i < numRecords; i++) {
+            prepareRecord(recordDescriptor.size(), nullsIndicator, 1 + i % 30, std::string(1 + i % 30, 'a' + i % 26),
+                          i, 177.8, 6200, records[i].data(), recordSize);
+            recordSizes[i] = recordSize;
+            batch.push_back(records[i].data());
+        }
+
+        std::vector<PeterDB::RID> rids;
+        ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, batch, rids), success)
+                                    << "Inserting a batch of records should succeed.";
+        ASSERT_EQ(rids.size(), numRecords) << "Every record should get a RID.";
+        unsigned pageCount = fileHandle.getNumberOfPages();
+        ASSERT_GT(pageCount, 1) << "The batch should span several pages.";
+        ASSERT_LT(pageCount, numRecords / 10) << "The pages of the batch should be full.";
+        for (int i = 0; i < numRecords; i++) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(batch[i], outBuffer, recordSizes[i]), 0) << "Reading a record should match what was inserted.";
+        }
+
+        // Free one page worth of records, the same records again should fit without appending a page
+        int deleted = 0;
+        for (int i = 0; i < numRecords; i++) {
+            if (rids[i].pageNum != rids[0].pageNum)
+                continue;
+            ASSERT_EQ(rbfm.deleteRecord(fileHandle, recordDescriptor, rids[i]), success)
+                                        << "Deleting a record should succeed.";
+            deleted++;
+        }
+        std::vector<const void *> refill(batch.begin(), batch.begin() + deleted);
+        std::vector<PeterDB::RID> refillRids;
+        ASSERT_EQ(rbfm.insertRecords(fileHandle, recordDescriptor, refill, refillRids), success)
+                                    << "Inserting a batch of records should succeed.";
+        ASSERT_EQ(fileHandle.getNumberOfPages(), pageCount) << "The freed space should be reused.";
+        for (int i = 0; i < refill.size(); i++) {
+            ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, refillRids[i], outBuffer), success)
+                                        << "Reading a record should succeed.";
+            ASSERT_EQ(memcmp(refill[i], outBuffer, recordSizes[i]), 0) << "Reading a record should match what was inserted.";
+        }
+    }
+
+#ifdef __GLIBC__
+    TEST_F(RBFM_Private_Test, no_allocations_in_steady_state) {
+        // Functions Tested:
+        // 1. insertRecord() - into a page already in the buffer pool, no heap allocation
+        // 2. readRecord() - of records on cached pages, no heap allocation
+        // 3. readAttribute() - of records on cached pages, no heap allocation
+
+        PeterDB::RID rid;
+        size_t recordSize = 0;
+        inBuffer = malloc(100);
+        outBuffer = malloc(100);
+        memset(inBuffer, 0, 100);
+        memset(outBuffer, 0, 100);
+
+        std::vector<PeterDB::Attribute> recordDescriptor;
+        createRecordDescriptor(recordDescriptor);
+        nullsIndicator = initializeNullFieldsIndicator(recordDescriptor);
+        prepareRecord(recordDescriptor.size(), nullsIndicator, 8, "Anteater", 25, 177.8, 6200, inBuffer, recordSize);
+
+        // The first insert appends the page and warms up the buffer pool
+        int numRecords = 50;
+        std::vector<PeterDB::RID> rids;
+        rids.reserve(numRecords + 1);
+        ASSERT_EQ(rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid), success)
+                                    << "Inserting a record should succeed.";
+        rids.push_back(rid);
+
+        allocationCount = 0;
+        countingAllocations = true;
+        for (int i = 0; i < numRecords; i++) {
+            rbfm.insertRecord(fileHandle, recordDescriptor, inBuffer, rid);
+            rids.push_back(rid);
+        }
+        countingAllocations = false;
+        unsigned long insertAllocations = allocationCount;
+        ASSERT_EQ(fileHandle.getNumberOfPages(), 1) << "The records should share one page.";
+
+        allocationCount = 0;
+        countingAllocations = true;
+        for (const PeterDB::RID &recordId : rids) {
+            rbfm.readRecord(fileHandle, recordDescriptor, recordId, outBuffer);
+            rbfm.readAttribute(fileHandle, recordDescriptor, recordId, "Age", outBuffer);
+        }
+        countingAllocations = false;
+        unsigned long readAllocations = allocationCount;
+
+        ASSERT_EQ(insertAllocations, 0) << "Inserting into a cached page should not allocate.";
+        ASSERT_EQ(readAllocations, 0) << "Reading records on cached pages should not allocate.";
+        ASSERT_EQ(rbfm.readRecord(fileHandle, recordDescriptor, rids.back(), outBuffer), success)
+                                    << "Reading a record should succeed.";
+        ASSERT_EQ(memcmp(inBuffer, outBuffer, recordSize), 0) << "Reading a record should match what was inserted.";
+    }
+#endif
+
+}
@@ -0,0 +1,316 @@
+#include "test/utils/rm_test_util.h"
+
+namespace PeterDBTesting {
+    class RM_Private_Test : public RM_Catalog_Test {
+    protected:
+        std::string tableName = "rm_private_test_table";
+        PeterDB::RID rid;
+        std::vector<PeterDB::Attribute> attrs;
+        char inBuffer[200] = {}, outBuffer[200] = {};
+
+    public:
+        void SetUp() override {
+            // Try to delete the System Catalog.
+            // If this is the first time, it will generate an error. It's OK and we will ignore that.
+            rm.deleteCatalog();
+            remove(tableName.c_str());
+            ASSERT_EQ(rm.createCatalog(), success) << "Creating the Catalog should succeed.";
+            createEmployeeTable(tableName);
+        }
+
+        void TearDown() override {
+            // Tests that delete the table themselves make this fail, which is fine
+            rm.deleteTable(tableName);
+            ASSERT_EQ(rm.deleteCatalog(), success) << "Deleting the Catalog should succeed.";
+        }
+
+        void createEmployeeTable(const std::string &name) {
+            remove(name.c_str());
+            ASSERT_EQ(rm.createTable(name, parseDDL(
+                    "CREATE TABLE " + name + " (emp_name VARCHAR(50), age INT, height REAL, salary REAL)")), success)
+                                        << "Create table " << name << " should succeed.";
+        }
+
+        // Inserts an employee whose name and salary follow from age
+        void insertEmployee(const std::string &name, unsigned age, PeterDB::RID &employeeRid) {
+            unsigned char nullsIndicator = 0;
+            std::string employeeName = "Employee " + std::to_string(age);
+            size_t tupleSize = 0;
+            prepareTuple(4, &nullsIndicator, employeeName.length(), employeeName, age, 170.5, (float) age * 100,
+                         inBuffer, tupleSize);
+            ASSERT_EQ(rm.insertTuple(name, inBuffer, employeeRid), success)
+                                        << "RelationManager::insertTuple() should succeed.";
+        }
+
+        // Entries of the whole index on name.attributeName
+        int countIndexEntries(const std::string &name, const std::string &attributeName) {
+            PeterDB::RM_IndexScanIterator rmisi;
+            EXPECT_EQ(rm.indexScan(name, attributeName, nullptr, nullptr, true, true, rmisi), success)
+                                        << "RelationManager::indexScan() should succeed.";
+            int count = 0;
+            PeterDB::RID entryRid;
+            while (rmisi.getNextEntry(entryRid, outBuffer) != RM_EOF)
+                count++;
+            EXPECT_EQ(rmisi.close(), success) << "RM_IndexScanIterator::close() should succeed.";
+            return count;
+        }
+
+        int countTuples(const std::string &name) {
+            PeterDB::RM_ScanIterator rmsi;
+            EXPECT_EQ(rm.scan(name, "", PeterDB::NO_OP, nullptr, {"age"}, rmsi), success)
+                                        << "RelationManager::scan() should succeed.";
+            int count = 0;
+            PeterDB::RID tupleRid;
+            while (rmsi.getNextTuple(tupleRid, outBuffer) != RM_EOF)
+                count++;
+            EXPECT_EQ(rmsi.close(), success) << "RM_ScanIterator::close() should succeed.";
+            return count;
+        }
+    };
+
+    TEST_F(RM_Private_Test, recreate_table_with_other_schema) {
+        // Functions Tested:
+        // 1. insertTuple() - caches the table's catalog entry and keeps its file open
+        // 2. deleteTable(), then createTable() under the same name with other attributes
+        // 3. getAttributes() and readTuple() - use the new attributes, not the cached ones
+
+        insertEmployee(tableName, 30, rid);
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        ASSERT_EQ(attrs.size(), 4) << "The table should have its first attributes.";
+
+        ASSERT_EQ(rm.deleteTable(tableName), success) << "Delete table " << tableName << " should succeed.";
+        ASSERT_EQ(rm.createTable(tableName, parseDDL("CREATE TABLE " + tableName + " (id INT, label VARCHAR(20))")),
+                  success) << "Create table " << tableName << " should succeed.";
+
+        attrs.clear();
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        ASSERT_EQ(attrs.size(), 2) << "The table should have its new attributes.";
+        ASSERT_EQ(attrs[0].name, "id") << "Attribute is not correct.";
+        ASSERT_EQ(attrs[1].name, "label") << "Attribute is not correct.";
+        ASSERT_EQ(attrs[1].type, PeterDB::TypeVarChar) << "Attribute is not correct.";
+
+        int id = 7, labelLength = 5;
+        inBuffer[0] = 0;
+        memcpy(inBuffer + 1, &id, sizeof(int));
+        memcpy(inBuffer + 1 + sizeof(int), &labelLength, sizeof(int));
+        memcpy(inBuffer + 1 + 2 * sizeof(int), "seven", labelLength);
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success)
+                                    << "RelationManager::insertTuple() should succeed.";
+        ASSERT_EQ(rm.readTuple(tableName, rid, outBuffer), success) << "RelationManager::readTuple() should succeed.";
+        std::stringstream stream;
+        ASSERT_EQ(rm.printTuple(attrs, outBuffer, stream), success) << "RelationManager::printTuple() should succeed.";
+        checkPrintRecord("id: 7, label: seven", stream.str());
+        ASSERT_EQ(countTuples(tableName), 1) << "Only the tuple of the new table should be there.";
+    }
+
+    TEST_F(RM_Private_Test, insert_after_destroy_index) {
+        // Functions Tested:
+        // 1. createIndex(), insertTuple() - the index is cached with the table and kept open
+        // 2. destroyIndex() - the index file is gone
+        // 3. insertTuple() - succeeds without the index, a new index on the attribute has every tuple
+
+        std::string indexFileName = tableName + "_age.idx";
+        ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "RelationManager::createIndex() should succeed.";
+        insertEmployee(tableName, 30, rid);
+        ASSERT_EQ(countIndexEntries(tableName, "age"), 1) << "The index should have the inserted tuple.";
+
+        ASSERT_EQ(rm.destroyIndex(tableName, "age"), success) << "RelationManager::destroyIndex() should succeed.";
+        ASSERT_FALSE(fileExists(indexFileName)) << "The index file should not exist now.";
+        insertEmployee(tableName, 31, rid);
+        ASSERT_FALSE(fileExists(indexFileName)) << "Inserting should not bring the index back.";
+        PeterDB::RM_IndexScanIterator rmisi;
+        ASSERT_NE(rm.indexScan(tableName, "age", nullptr, nullptr, true, true, rmisi), success)
+                                    << "RelationManager::indexScan() should fail without the index.";
+        rmisi.close();
+
+        ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "RelationManager::createIndex() should succeed.";
+        insertEmployee(tableName, 32, rid);
+        ASSERT_EQ(countIndexEntries(tableName, "age"), 3) << "The new index should have every tuple.";
+        ASSERT_EQ(countTuples(tableName), 3) << "Every tuple should be in the table.";
+    }
+
+    TEST_F(RM_Private_Test, add_attribute_visible_afterwards) {
+        // Functions Tested:
+        // 1. getAttributes() - caches the table's catalog entry
+        // 2. addAttribute() - getAttributes() has the new attribute right after
+        // 3. insertTuple(), readAttribute() - tuples take the new attribute
+
+        ASSERT_EQ(rm.getAttributes(tableName, attrs), success) << "RelationManager::getAttributes() should succeed.";
+        insertEmployee(tableName, 30, rid);
+        PeterDB::Attribute attr{"ssn", PeterDB::TypeInt, 4};
+        ASSERT_EQ(rm.addAttribute(tableName, attr), success) << "RelationManager::addAttribute() should succeed.";
+
+        std::vector<PeterDB::Attribute> attrsAfterAdd;
+        ASSERT_EQ(rm.getAttributes(tableName, attrsAfterAdd), success)
+                                    << "RelationManager::getAttributes() should succeed.";
+        ASSERT_EQ(attrsAfterAdd.size(), attrs.size() + 1) << "The added attribute should be there.";
+        ASSERT_EQ(attrsAfterAdd.back().name, "ssn") << "Attribute is not correct.";
+        ASSERT_EQ(attrsAfterAdd.back().type, PeterDB::TypeInt) << "Attribute is not correct.";
+
+        unsigned char nullsIndicator = 0;
+        std::string name = "Peter Anteater";
+        size_t tupleSize = 0;
+        prepareTupleAfterAdd(attrsAfterAdd.size(), &nullsIndicator, name.length(), name, 34, 175.3, 24123.90,
+                             123479765, inBuffer, tupleSize);
+        ASSERT_EQ(rm.insertTuple(tableName, inBuffer, rid), success)
+                                    << "RelationManager::insertTuple() should succeed.";
+        ASSERT_EQ(rm.readAttribute(tableName, rid, "ssn", outBuffer), success)
+                                    << "RelationManager::readAttribute() should succeed.";
+        int ssn;
+        memcpy(&ssn, outBuffer + 1, sizeof(int));
+        ASSERT_EQ(ssn, 123479765) << "The added attribute should be read back.";
+    }
+
+    TEST_F(RM_Private_Test, index_scans_around_cached_index_inserts) {
+        // Functions Tested:
+        // 1. indexScan() - opens its own handle of the index while the cached one stays open
+        // 2. insertTuple() - grows the index through the cached handle while the first scan is open
+        // 3. a second indexScan() opened and closed, then the first one closed
+        // 4. insertTuple() - appends after the pages added before, every entry is in the index
+
+        int entries = 3000, moreEntries = 1000;
+        ASSERT_EQ(rm.createIndex(tableName, "age"), success) << "RelationManager::createIndex() should succeed.";
+        insertEmployee(tableName, 0, rid);
+        PeterDB::RM_IndexScanIterator firstScan;
+        ASSERT_EQ(rm.indexScan(tableName, "age", nullptr, nullptr, true, true, firstScan), success)
+                                    << "RelationManager::indexScan() should succeed.";
+
+        for (int i = 1; i < entries; i++)
+            insertEmployee(tableName, i, rid);
+        ASSERT_EQ(countIndexEntries(tableName, "age"), entries) << "The second scan should find every entry.";
+        ASSERT_EQ(firstScan.close(), success) << "RM_IndexScanIterator::close() should succeed.";
+
+        for (int i = entries; i < entries + moreEntries; i++)
+            insertEmployee(tableName, i, rid);
+        ASSERT_EQ(countIndexEntries(tableName, "age"), entries + moreEntries) << "Every entry should be in the index.";
+        for (int age : {0, entries / 2, entries + moreEntries - 1}) {
+            PeterDB::RM_IndexScanIterator rmisi;
+            ASSERT_EQ(rm.indexScan(tableName, "age", &age, &age, true, true, rmisi), success)
+                                        << "RelationManager::indexScan() should succeed.";
+            int key;
+            ASSERT_EQ(rmisi.getNextEntry(rid, &key), success) << "The key " << age << " should be found.";
+            ASSERT_EQ(key, age) << "The returned key does not match.";
+            ASSERT_EQ(rmisi.getNextEntry(rid, &key), RM_EOF) << "The key should be found once.";
+            ASSERT_EQ(rmisi.close(), success) << "RM_IndexScanIterator::close() should succeed.";
+        }
+    }
+
+    TEST_F(RM_Private_Test, handle_cache_beyond_capacity) {
+        // Functions Tested:
+        // 1. createTable(), createIndex() - more tables, each with an index, than HANDLE_CACHE_SIZE files kept open
+        // 2. insertTuple() - round robin over the tables, cached handles are closed and opened again as they go
+        // 3. scan(), indexScan() - stay open on some tables while inserting, then every table and index has every tuple
+
+        int tableCount = HANDLE_CACHE_SIZE + 4, rounds = 60, openScans = 4, tuplesWhenOpened = 0;
+        std::vector<std::string> tables;
+        for (int i = 0; i < tableCount; i++) {
+            tables.push_back(tableName + "_" + std::to_string(i));
+            createEmployeeTable(tables.back());
+            ASSERT_EQ(rm.createIndex(tables.back(), "age"), success)
+                                        << "RelationManager::createIndex() should succeed.";
+        }
+
+        std::vector<PeterDB::RM_ScanIterator> tableScans(openScans);
+        std::vector<PeterDB::RM_IndexScanIterator> indexScans(openScans);
+        for (int round = 0; round < rounds; round++) {
+            for (int i = 0; i < tableCount; i++)
+                insertEmployee(tables[i], round * tableCount + i, rid);
+            if (round % 20 == 10) {
+                tuplesWhenOpened = round + 1;
+                for (int i = 0; i < openScans; i++) {
+                    const std::string &table = tables[(round + i * 5) % tableCount];
+                    ASSERT_EQ(rm.scan(table, "", PeterDB::NO_OP, nullptr, {"age"}, tableScans[i]), success)
+                                                << "RelationManager::scan() should succeed.";
+                    ASSERT_EQ(rm.indexScan(table, "age", nullptr, nullptr, true, true, indexScans[i]), success)
+                                                << "RelationManager::indexScan() should succeed.";
+                }
+            } else if (round % 20 == 15) {
+                for (int i = 0; i < openScans; i++) {
+                    int tuples = 0, indexEntries = 0;
+                    while (tableScans[i].getNextTuple(rid, outBuffer) != RM_EOF)
+                        tuples++;
+                    while (indexScans[i].getNextEntry(rid, outBuffer) != RM_EOF)
+                        indexEntries++;
+                    ASSERT_GE(tuples, tuplesWhenOpened) << "The scan should find the tuples inserted before it.";
+                    ASSERT_GE(indexEntries, tuplesWhenOpened) << "The index scan should find the entries inserted before it.";
+                    ASSERT_EQ(tableScans[i].close(), success) << "RM_ScanIterator::close() should succeed.";
+                    ASSERT_EQ(indexScans[i].close(), success) << "RM_IndexScanIterator::close() should succeed.";
+                }
+            }
+        }
+
+        for (const std::string &table : tables) {
+            ASSERT_EQ(countTuples(table), rounds) << "Every tuple should be in " << table << ".";
+            ASSERT_EQ(countIndexEntries(table, "age"), rounds) << "Every tuple should be in the index of " << table << ".";
+            ASSERT_EQ(rm.deleteTable(table), success) << "Delete table " << table << " should succeed.";
+        }
+    }
+
+    TEST_F(RM_Private_Test, insert_tuples_in_batches) {
+        // Functions Tested:
+        // 1. createIndex() - on an int, a varchar and a real attribute
+        // 2. insertTuples() - scrambled tuples in batches, one RID per tuple
+        // 3. readTuple() - every tuple reads back as inserted
+        // 4. indexScan() - every index has every key, pointing at the tuple's RID
+
+        int entries = 3000, batchSize = 500;
+        for (const std::string &attribute : {"age", "emp_name", "salary"})
+            ASSERT_EQ(rm.createIndex(tableName, attribute), success) << "RelationManager::createIndex() should succeed.";
+
+        std::vector<std::vector<char>> tuples(entries, std::vector<char>(100));
+        std::vector<size_t> tupleSizes(entries);
+        std::vector<PeterDB::RID> rids;
+        unsigned char nullsIndicator = 0;
+        for (int i = 0; i < entries; i++) {
+            unsigned age = i * 7919L % entries;
+            std::string name = "Employee " + std::to_string(age);
+            prepareTuple(4, &nullsIndicator, name.length(), name, age, 170.5, (float) age * 100, tuples[i].data(),
+                         tupleSizes[i]);
+        }
+        for (int start = 0; start < entries; start += batchSize) {
+            std::vector<const void *> batch;
+            for (int i = start; i < start + batchSize; i++)
+                batch.push_back(tuples[i].data());
+            std::vector<PeterDB::RID> batchRids;
+            ASSERT_EQ(rm.insertTuples(tableName, batch, batchRids), success)
+                                        << "RelationManager::insertTuples() should succeed.";
+            ASSERT_EQ(batchRids.size(), batch.size()) << "There should be one RID per tuple.";
+            rids.insert(rids.end(), batchRids.begin(), batchRids.end());
+        }
+
+        for (int i = 0; i < entries; i++) {
+            ASSERT_EQ(rm.readTuple(tableName, rids[i], outBuffer), success)
+                                        << "RelationManager::readTuple() should succeed.";
+            ASSERT_EQ(memcmp(outBuffer, tuples[i].data(), tupleSizes[i]), 0)
+                                        << "The returned tuple is not the same as the inserted.";
+        }
+
+        ASSERT_EQ(countTuples(tableName), entries) << "Every tuple should be in the table.";
+        for (const std::string &attribute : {"age", "emp_name", "salary"})
+            ASSERT_EQ(countIndexEntries(tableName, attribute), entries) << "Every tuple should be in the index.";
+        for (int i = 0; i < entries; i += 97) {
+            unsigned age = i * 7919L % entries;
+            std::string name = "Employee " + std::to_string(age);
+            float salary = (float) age * 100;
+            char nameKey[50];
+            int nameLength = name.length();
+            memcpy(nameKey, &nameLength, sizeof(int));
+            memcpy(nameKey + sizeof(int), name.data(), nameLength);
+            std::vector<std::pair<std::string, const void *>> keys = {{"age", &age}, {"emp_name", nameKey},
+                                                                       {"salary", &salary}};
+            for (const std::pair<std::string, const void *> &key : keys) {
+                PeterDB::RM_IndexScanIterator rmisi;
+                ASSERT_EQ(rm.indexScan(tableName, key.first, key.second, key.second, true, true, rmisi), success)
+                                            << "RelationManager::indexScan() should succeed.";
+                PeterDB::RID entryRid;
+                ASSERT_EQ(rmisi.getNextEntry(entryRid, outBuffer), success)
+                                            << "The " << key.first << " key of tuple " << i << " should be found.";
+                ASSERT_EQ(entryRid.pageNum, rids[i].pageNum) << "The index entry should point at the tuple.";
+                ASSERT_EQ(entryRid.slotNum, rids[i].slotNum) << "The index entry should point at the tuple.";
+                ASSERT_EQ(rmisi.getNextEntry(entryRid, outBuffer), RM_EOF) << "The key should be found once.";
+                ASSERT_EQ(rmisi.close(), success) << "RM_IndexScanIterator::close() should succeed.";
+            }
+        }
+    }
+
+} // namespace PeterDBTesting